@@ -0,0 +1,160 @@
+#include"animated_instance.h"
+
+#include<cmath>
+
+
+AnimatedInstance::AnimatedInstance(const CharacterAsset& asset) :
+	p_asset_(&asset) {
+	if (asset.p_skeleton != nullptr)
+	{
+		pose_state_ = asset.p_skeleton->CreatePoseState();
+	}
+}
+
+
+void AnimatedInstance::PlaySingle(int anim_index) {
+	play_mode_ = EAnimtionPlayMode::eSingle;
+	single_anim_para_.anim_index = anim_index;
+}
+
+void AnimatedInstance::PlayBlend(int anim_index1, int anim_index2, float weight) {
+	play_mode_ = EAnimtionPlayMode::eBlend;
+	blend_anim_para_.anim_index1 = anim_index1;
+	blend_anim_para_.anim_index2 = anim_index2;
+	blend_anim_para_.anim_blend_weight = weight;
+}
+
+void AnimatedInstance::PlayTransition(int anim_index1, int anim_index2, float begin_trans_time_in_sec) {
+	play_mode_ = EAnimtionPlayMode::eTransition;
+	transition_anim_para_.anim_index1 = anim_index1;
+	transition_anim_para_.anim_index2 = anim_index2;
+	transition_anim_para_.begin_trans_time_in_sec = begin_trans_time_in_sec;
+}
+
+void AnimatedInstance::SetTime(float time_in_sec) {
+	time_in_sec_ = time_in_sec;
+}
+
+void AnimatedInstance::SetPlaybackSpeed(float speed) {
+	playback_speed_ = speed;
+}
+
+void AnimatedInstance::Update(float delta_sec, PoseScratch& scratch, JobSystem* job_system) {
+	if (HaveAnimation() == false) return;
+
+	time_in_sec_ += delta_sec * playback_speed_;
+
+	const vector<const Animation*>& animations = p_asset_->animations;
+	switch (play_mode_)
+	{
+	case EAnimtionPlayMode::eSingle:
+	{
+		const Animation& anim = *animations[single_anim_para_.anim_index];
+		// wrap the clock so it doesn't lose precision over a long run
+		time_in_sec_ = std::fmod(time_in_sec_, anim.total_sec_);
+		single_anim_para_.normalized_time = anim.GetNormalizedTime(time_in_sec_);
+		PlaySingleAnimation(single_anim_para_, scratch, job_system);
+		break;
+	}
+	case EAnimtionPlayMode::eBlend:
+	{
+		const Animation& anim1 = *animations[blend_anim_para_.anim_index1];
+		time_in_sec_ = std::fmod(time_in_sec_, anim1.total_sec_);
+		blend_anim_para_.normalized_time = anim1.GetNormalizedTime(time_in_sec_);
+		BlendAnimation1D(blend_anim_para_, scratch, job_system);
+		break;
+	}
+	case EAnimtionPlayMode::eTransition:
+	{
+		const Animation& anim2 = *animations[transition_anim_para_.anim_index2];
+		time_in_sec_ = std::fmod(time_in_sec_, transition_anim_para_.begin_trans_time_in_sec + anim2.total_sec_);
+		transition_anim_para_.time_in_sec = time_in_sec_;
+		PlayAnimationTransition(transition_anim_para_, scratch, job_system);
+		break;
+	}
+	}
+}
+
+
+void AnimatedInstance::PlaySingleAnimation(const PlaySingleAnimParameter& parameter, PoseScratch& scratch, JobSystem* job_system) {
+	p_asset_->p_skeleton->CalcBoneAnimTransform(*p_asset_->animations[parameter.anim_index], parameter.normalized_time,
+		pose_state_, scratch, p_asset_->root_transform, job_system);
+}
+
+void AnimatedInstance::BlendAnimation1D(const BlendAnimParameter& parameter, PoseScratch& scratch, JobSystem* job_system) {
+	p_asset_->p_skeleton->BlendBoneAnimTransform(*p_asset_->animations[parameter.anim_index1], *p_asset_->animations[parameter.anim_index2],
+		parameter.normalized_time, parameter.anim_blend_weight, pose_state_, scratch, p_asset_->root_transform, job_system);
+}
+
+void AnimatedInstance::PlayAnimationTransition(const TransitionAnimParameter& parameter, PoseScratch& scratch, JobSystem* job_system) {
+	p_asset_->p_skeleton->TransitionAnim(*p_asset_->animations[parameter.anim_index1], *p_asset_->animations[parameter.anim_index2],
+		parameter.time_in_sec, parameter.begin_trans_time_in_sec, pose_state_, scratch, p_asset_->root_transform, job_system);
+}
+
+
+bool AnimatedInstance::HaveAnimation() const {
+	return p_asset_->p_skeleton != nullptr && p_asset_->animations.size() > 0;
+}
+
+void AnimatedInstance::SetTransform(const mat4& model_mat) {
+	model_mat_ = model_mat;
+}
+
+const mat4& AnimatedInstance::GetTransform() const {
+	return model_mat_;
+}
+
+const vector<mat4>& AnimatedInstance::GetFinalBoneTransform() const {
+	return pose_state_.final_bone_transform;
+}
+
+void AnimatedInstance::SetPaletteTarget(float* target, EPaletteEncoding encoding) {
+	pose_state_.palette_target = target;
+	pose_state_.palette_encoding = encoding;
+}
+
+
+AnimatedInstanceGroup::AnimatedInstanceGroup(const CharacterAsset& asset) :
+	p_asset_(&asset) {}
+
+AnimatedInstance& AnimatedInstanceGroup::AddInstance() {
+	instances_.emplace_back(*p_asset_);
+	return instances_.back();
+}
+
+int AnimatedInstanceGroup::GetInstanceCount() const {
+	return instances_.size();
+}
+
+AnimatedInstance& AnimatedInstanceGroup::GetInstance(int index) {
+	return instances_[index];
+}
+
+const AnimatedInstance& AnimatedInstanceGroup::GetInstance(int index) const {
+	return instances_[index];
+}
+
+void AnimatedInstanceGroup::UpdateAll(float delta_sec, JobSystem* job_system) {
+	int num_threads = job_system != nullptr ? job_system->GetThreadCount() : 1;
+	if (scratches_.size() < num_threads)
+	{
+		scratches_.resize(num_threads);
+	}
+
+	if (num_threads == 1 || instances_.size() < num_threads)
+	{
+		for (AnimatedInstance& instance : instances_)
+		{
+			instance.Update(delta_sec, scratches_[0], job_system);
+		}
+		return;
+	}
+
+	// instances only share read only data, each pose is written by the one thread that updates it
+	job_system->ParallelFor(instances_.size(), kInstancesPerJob, [&](int begin, int end, int worker_index) {
+		for (int i = begin; i < end; i++)
+		{
+			instances_[i].Update(delta_sec, scratches_[worker_index]);
+		}
+		});
+}
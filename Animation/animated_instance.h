@@ -0,0 +1,87 @@
+#ifndef ANIMATED_INSTANCE_H
+#define ANIMATED_INSTANCE_H
+
+#include <glm/glm.hpp>
+using glm::mat4;
+
+#include <vector>
+using std::vector;
+
+#include "animation.h"
+#include "skeleton.h"
+#include "render_parameter.h"
+
+// read only animation data shared by every instance of one character
+struct CharacterAsset
+{
+	const Skeleton* p_skeleton = nullptr;
+	vector<const Animation*> animations;
+	// transform above the skeleton root
+	mat4 root_transform = mat4(1.0f);
+};
+
+// one animated character, it only references the shared asset and owns its playback and pose
+class AnimatedInstance
+{
+public:
+	explicit AnimatedInstance(const CharacterAsset& asset);
+
+	// clock driven playback, advanced by Update
+	void PlaySingle(int anim_index);
+	void PlayBlend(int anim_index1, int anim_index2, float weight);
+	void PlayTransition(int anim_index1, int anim_index2, float begin_trans_time_in_sec);
+	void SetTime(float time_in_sec);
+	void SetPlaybackSpeed(float speed);
+	void Update(float delta_sec, PoseScratch& scratch, JobSystem* job_system = nullptr);
+
+	// poses from explicit playback parameters, as set by the UI
+	void PlaySingleAnimation(const PlaySingleAnimParameter&, PoseScratch& scratch, JobSystem* job_system = nullptr);
+	void BlendAnimation1D(const BlendAnimParameter&, PoseScratch& scratch, JobSystem* job_system = nullptr);
+	void PlayAnimationTransition(const TransitionAnimParameter&, PoseScratch& scratch, JobSystem* job_system = nullptr);
+
+	bool HaveAnimation() const;
+	void SetTransform(const mat4& model_mat);
+	const mat4& GetTransform() const;
+	const vector<mat4>& GetFinalBoneTransform() const;
+	// later poses are written to target in encoding, GetBoneCount bones, instead of GetFinalBoneTransform, nullptr undoes it
+	void SetPaletteTarget(float* target, EPaletteEncoding encoding = EPaletteEncoding::eMat4);
+
+private:
+	const CharacterAsset* p_asset_;
+
+	EAnimtionPlayMode play_mode_ = EAnimtionPlayMode::eSingle;
+	PlaySingleAnimParameter single_anim_para_;
+	BlendAnimParameter blend_anim_para_;
+	TransitionAnimParameter transition_anim_para_;
+	float time_in_sec_ = 0.0f;
+	float playback_speed_ = 1.0f;
+
+	mat4 model_mat_ = mat4(1.0f);
+	PoseState pose_state_;
+};
+
+// all instances of one character, updated together
+class AnimatedInstanceGroup
+{
+public:
+	explicit AnimatedInstanceGroup(const CharacterAsset& asset);
+
+	// returned reference is valid until the next AddInstance
+	AnimatedInstance& AddInstance();
+	int GetInstanceCount() const;
+	AnimatedInstance& GetInstance(int index);
+	const AnimatedInstance& GetInstance(int index) const;
+
+	// with a job system, instances are spread over its threads, or if there are fewer
+	// instances than threads, bones of big skeletons are; poses don't depend on thread count
+	void UpdateAll(float delta_sec, JobSystem* job_system = nullptr);
+	static constexpr int kInstancesPerJob = 8;
+
+private:
+	const CharacterAsset* p_asset_;
+	vector<AnimatedInstance> instances_;
+	// one per job system thread
+	vector<PoseScratch> scratches_;
+};
+
+#endif
@@ -1,46 +1,643 @@
 #include"animation.h"
+#include"clip_streamer.h"
 #include"utility/anim_math.h"
 
-Animation::Animation(const aiAnimation * anim) :
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+#include<iostream>
+
+// reserves num_bytes at the end of the key buffer and returns its offset,
+// buffer_size and offset are counted in floats and every array starts on a KeyBlock boundary
+static unsigned int AllocateKeyArray(unsigned int num_bytes, unsigned int& buffer_size) {
+	unsigned int offset = buffer_size;
+	buffer_size += (num_bytes + sizeof(KeyBlock) - 1) / sizeof(KeyBlock) * (sizeof(KeyBlock) / sizeof(float));
+	return offset;
+}
+
+// reserves a float time array (if with_times) and a float value array for a track
+static void AllocateTrack(Track& track, unsigned int num_keys, unsigned int floats_per_key, bool with_times, unsigned int& buffer_size) {
+	track.num_keys = num_keys;
+	track.time_offset = with_times ? AllocateKeyArray(num_keys * sizeof(float), buffer_size) : buffer_size;
+	track.value_offset = AllocateKeyArray(num_keys * floats_per_key * sizeof(float), buffer_size);
+}
+
+// same for quantized keys, value array is a float header followed by 16 bits components
+static void AllocatePackedTrack(Track& track, unsigned int num_keys, unsigned int header_floats, unsigned int components_per_key, bool with_times, unsigned int& buffer_size) {
+	track.num_keys = num_keys;
+	track.time_offset = with_times ? AllocateKeyArray(num_keys * sizeof(uint16_t), buffer_size) : buffer_size;
+	track.value_offset = AllocateKeyArray(header_floats * sizeof(float) + num_keys * components_per_key * sizeof(uint16_t), buffer_size);
+}
+
+// smallest three quaternion: index of the largest component (dropped, rebuilt from unit length)
+// in 2 bits, the other three in 15 bits each, they all lie in [-1/sqrt(2), 1/sqrt(2)]
+constexpr float kSmallestThreeRange = 0.70710678f;
+constexpr float kMax15Bits = 32767.0f;
+constexpr float kMax16Bits = 65535.0f;
+
+static void EncodeSmallestThree(const float wxyz[4], uint16_t packed[3]) {
+	int largest = 0;
+	for (int c = 1; c < 4; c++)
+	{
+		if (std::abs(wxyz[c]) > std::abs(wxyz[largest])) largest = c;
+	}
+	// q and -q are the same rotation, make the dropped component positive
+	float sign = wxyz[largest] < 0.0f ? -1.0f : 1.0f;
+
+	int k = 0;
+	for (int c = 0; c < 4; c++)
+	{
+		if (c == largest) continue;
+		float normalized = (sign * wxyz[c] / kSmallestThreeRange) * 0.5f + 0.5f;
+		packed[k++] = static_cast<uint16_t>(std::lround(std::min(std::max(normalized, 0.0f), 1.0f) * kMax15Bits));
+	}
+	packed[0] |= (largest & 1) << 15;
+	packed[1] |= (largest >> 1) << 15;
+}
+
+static quat DecodeSmallestThree(const uint16_t packed[3]) {
+	int largest = (packed[0] >> 15) | ((packed[1] >> 15) << 1);
+	float small[3];
+	float sum_sq = 0.0f;
+	for (int k = 0; k < 3; k++)
+	{
+		small[k] = ((packed[k] & 0x7fff) / kMax15Bits * 2.0f - 1.0f) * kSmallestThreeRange;
+		sum_sq += small[k] * small[k];
+	}
+
+	float wxyz[4];
+	int k = 0;
+	for (int c = 0; c < 4; c++)
+	{
+		wxyz[c] = c == largest ? std::sqrt(std::max(1.0f - sum_sq, 0.0f)) : small[k++];
+	}
+	return quat(wxyz[0], wxyz[1], wxyz[2], wxyz[3]);
+}
+
+static uint16_t QuantizeUnorm16(float value, float range_min, float range_step) {
+	float normalized = range_step > 0.0f ? (value - range_min) / range_step : 0.0f;
+	return static_cast<uint16_t>(std::lround(std::min(std::max(normalized, 0.0f), kMax16Bits)));
+}
+
+Animation::Animation(const aiAnimation * anim, const AnimationImportOption& option) :
 	anim_name_(anim->mName.data),
 	total_frames_(anim->mDuration),
 	frame_per_sec_(anim->mTicksPerSecond),
 	total_sec_(anim->mDuration / anim->mTicksPerSecond)
 {
+	// lay out every track first so that all keys go into a single allocation
+	unsigned int buffer_size = 0;
 	for (int i = 0; i < anim->mNumChannels; i++)
 	{
 		Channel channel;
 		channel.name_ = anim->mChannels[i]->mNodeName.data;
+		AllocateTrack(channel.position_track_, anim->mChannels[i]->mNumPositionKeys, 3, true, buffer_size);
+		AllocateTrack(channel.rotation_track_, anim->mChannels[i]->mNumRotationKeys, 4, true, buffer_size);
+		AllocateTrack(channel.scale_track_, anim->mChannels[i]->mNumScalingKeys, 1, true, buffer_size);
+
+		vec_channels_.emplace_back(channel);
+		channel_name_to_index_[channel.name_] = i;
+	}
+
+	key_buffer_.resize(buffer_size * sizeof(float) / sizeof(KeyBlock));
+	float* key_data = key_buffer_.empty() ? nullptr : key_buffer_[0].data;
+
+	for (int i = 0; i < anim->mNumChannels; i++)
+	{
+		const aiNodeAnim* ai_channel = anim->mChannels[i];
+		const Channel& channel = vec_channels_[i];
 
-		PositionKeyFrame pos_key;
-		for (int j = 0; j < anim->mChannels[i]->mNumPositionKeys; j++)
+		float* times = key_data + channel.position_track_.time_offset;
+		float* values = key_data + channel.position_track_.value_offset;
+		for (int j = 0; j < ai_channel->mNumPositionKeys; j++)
 		{
-			pos_key.position = Convert<vec3>(anim->mChannels[i]->mPositionKeys[j].mValue);
-			pos_key.time = anim->mChannels[i]->mPositionKeys[j].mTime;
-			channel.position_channels_.emplace_back(pos_key);
+			vec3 position = Convert<vec3>(ai_channel->mPositionKeys[j].mValue);
+			times[j] = ai_channel->mPositionKeys[j].mTime;
+			values[j * 3 + 0] = position.x;
+			values[j * 3 + 1] = position.y;
+			values[j * 3 + 2] = position.z;
 		}
 
-		RotationKeyFrame rot_key;
-		for (int j = 0; j < anim->mChannels[i]->mNumRotationKeys; j++)
+		times = key_data + channel.rotation_track_.time_offset;
+		values = key_data + channel.rotation_track_.value_offset;
+		for (int j = 0; j < ai_channel->mNumRotationKeys; j++)
 		{
-			rot_key.quaternion = Convert<quat>(anim->mChannels[i]->mRotationKeys[j].mValue);
-			rot_key.time = anim->mChannels[i]->mPositionKeys[j].mTime;
-			channel.rotation_channels_.emplace_back(rot_key);
+			quat rotation = Convert<quat>(ai_channel->mRotationKeys[j].mValue);
+			times[j] = ai_channel->mRotationKeys[j].mTime;
+			values[j * 4 + 0] = rotation.w;
+			values[j * 4 + 1] = rotation.x;
+			values[j * 4 + 2] = rotation.y;
+			values[j * 4 + 3] = rotation.z;
 		}
 
-		ScaleKeyFrame scale_key;
-		for (int j = 0; j < anim->mChannels[i]->mNumScalingKeys; j++)
+		times = key_data + channel.scale_track_.time_offset;
+		values = key_data + channel.scale_track_.value_offset;
+		for (int j = 0; j < ai_channel->mNumScalingKeys; j++)
 		{
-			scale_key.scale = Convert<float>(anim->mChannels[i]->mScalingKeys[j].mValue);
-			scale_key.time = anim->mChannels[i]->mPositionKeys[j].mTime;
-			channel.scale_channels_.emplace_back(scale_key);
+			times[j] = ai_channel->mScalingKeys[j].mTime;
+			values[j] = Convert<float>(ai_channel->mScalingKeys[j].mValue);
 		}
+	}
 
-		// ToDo: Channel Compress
+	if (option.key_sample_mode == EKeySampleMode::eUniform)
+	{
+		size_t keyframe_size = GetKeyMemorySize();
+		float keys_per_sec = option.resample_rate > 0.0f ? option.resample_rate : frame_per_sec_;
+		ResampleUniform(keys_per_sec);
 
-		vec_channels_.emplace_back(channel);
-		channel_name_to_index_[channel.name_] = i;
+		std::cout << "Animation " << anim_name_ << ": resampled to " << keys_per_sec << " keys/s, key memory "
+			<< keyframe_size / 1024.0f << " KB -> " << GetKeyMemorySize() / 1024.0f << " KB" << std::endl;
+	}
+	else
+	{
+		std::cout << "Animation " << anim_name_ << ": keyframe mode, key memory " << GetKeyMemorySize() / 1024.0f << " KB" << std::endl;
+	}
+}
+
+
+bool AreTracksInKeyBuffer(const AnimationClipData& clip_data) {
+	if ((clip_data.key_format != EKeyFormat::eFloat && clip_data.key_format != EKeyFormat::eQuantized)
+		|| (clip_data.key_sample_mode != EKeySampleMode::eKeyframe && clip_data.key_sample_mode != EKeySampleMode::eUniform))
+	{
+		return false;
+	}
+
+	// same layout as AllocateTrack and AllocatePackedTrack, in bytes, 64 bits so offsets near 4G can't wrap
+	const bool with_times = clip_data.key_sample_mode == EKeySampleMode::eKeyframe;
+	const bool quantized = clip_data.key_format == EKeyFormat::eQuantized;
+	const uint64_t time_bytes = with_times ? (quantized ? sizeof(uint16_t) : sizeof(float)) : 0;
+	const uint64_t buffer_bytes = static_cast<uint64_t>(clip_data.key_buffer.size()) * sizeof(KeyBlock);
+	auto in_buffer = [&](const Track& track, uint64_t header_floats, uint64_t key_bytes) {
+		// uniform sampling interpolates between two keys without checking for fewer
+		if (with_times == false && track.num_keys < 2)
+		{
+			return false;
+		}
+		return static_cast<uint64_t>(track.time_offset) * sizeof(float) + track.num_keys * time_bytes <= buffer_bytes
+			&& static_cast<uint64_t>(track.value_offset) * sizeof(float) + header_floats * sizeof(float) + track.num_keys * key_bytes <= buffer_bytes;
+	};
+	for (const Channel& channel : clip_data.channels)
+	{
+		if (in_buffer(channel.position_track_, quantized ? 6 : 0, quantized ? 3 * sizeof(uint16_t) : 3 * sizeof(float)) == false
+			|| in_buffer(channel.rotation_track_, 0, quantized ? 3 * sizeof(uint16_t) : 4 * sizeof(float)) == false
+			|| in_buffer(channel.scale_track_, quantized ? 2 : 0, quantized ? sizeof(uint16_t) : sizeof(float)) == false)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+Animation::Animation(AnimationClipData clip_data) :
+	anim_name_(clip_data.name),
+	total_frames_(clip_data.total_frames),
+	frame_per_sec_(clip_data.frame_per_sec),
+	total_sec_(clip_data.total_sec),
+	vec_channels_(std::move(clip_data.channels)),
+	key_buffer_(std::move(clip_data.key_buffer)),
+	key_format_(clip_data.key_format),
+	key_time_step_(clip_data.key_time_step),
+	key_sample_mode_(clip_data.key_sample_mode),
+	keys_per_tick_(clip_data.keys_per_tick),
+	num_uniform_keys_(clip_data.num_uniform_keys),
+	first_uniform_key_(clip_data.first_uniform_key)
+{
+	for (int i = 0; i < vec_channels_.size(); i++)
+	{
+		channel_name_to_index_[vec_channels_[i].name_] = i;
+	}
+}
+
+AnimationClipData Animation::GetClipData() const {
+	AnimationClipData clip_data;
+	clip_data.name = anim_name_;
+	clip_data.total_frames = total_frames_;
+	clip_data.frame_per_sec = frame_per_sec_;
+	clip_data.total_sec = total_sec_;
+	clip_data.channels = vec_channels_;
+	clip_data.key_buffer = key_buffer_;
+	clip_data.key_format = key_format_;
+	clip_data.key_time_step = key_time_step_;
+	clip_data.key_sample_mode = key_sample_mode_;
+	clip_data.keys_per_tick = keys_per_tick_;
+	clip_data.num_uniform_keys = num_uniform_keys_;
+	clip_data.first_uniform_key = first_uniform_key_;
+	return clip_data;
+}
+
+AnimationClipData Animation::ExtractBlock(float begin_tick, float end_tick) const {
+	AnimationClipData block;
+	block.name = anim_name_;
+	block.total_frames = total_frames_;
+	block.frame_per_sec = frame_per_sec_;
+	block.total_sec = total_sec_;
+	block.channels = vec_channels_;
+	block.key_format = key_format_;
+	block.key_time_step = key_time_step_;
+	block.key_sample_mode = key_sample_mode_;
+	block.keys_per_tick = keys_per_tick_;
+	block.num_uniform_keys = num_uniform_keys_;
+
+	const bool with_times = key_sample_mode_ == EKeySampleMode::eKeyframe;
+	const bool quantized = key_format_ == EKeyFormat::eQuantized;
+	const unsigned int time_bytes = quantized ? sizeof(uint16_t) : sizeof(float);
+
+	// a block keeps the key segments containing its begin and end and all keys between,
+	// uniform tracks all have the same keys, so one range serves every track
+	int uniform_first = 0;
+	int uniform_count = 0;
+	if (with_times == false)
+	{
+		uniform_first = std::min(std::max(static_cast<int>(begin_tick * keys_per_tick_), 0), num_uniform_keys_ - 2);
+		int uniform_last = std::min(static_cast<int>(end_tick * keys_per_tick_) + 1, num_uniform_keys_ - 1);
+		uniform_count = uniform_last - uniform_first + 1;
+		block.first_uniform_key = first_uniform_key_ + uniform_first;
 	}
+	auto key_range = [&](const Track& track, int& first, int& count) {
+		if (with_times == false)
+		{
+			first = uniform_first;
+			count = uniform_count;
+			return;
+		}
+		first = 0;
+		count = track.num_keys;
+		if (track.num_keys > 1)
+		{
+			int cursor_key = 0;
+			float factor;
+			first = FindTrackKey(track, begin_tick, cursor_key, factor);
+			count = FindTrackKey(track, end_tick, cursor_key, factor) + 2 - first;
+		}
+	};
+
+	// value arrays: float header (quantized ranges) then the keys
+	struct TrackCopy
+	{
+		const Track* src;
+		Track* dst;
+		int first;
+		size_t header_floats;
+		size_t key_bytes;
+	};
+	vector<TrackCopy> copies;
+	unsigned int buffer_size = 0;
+	for (int i = 0; i < vec_channels_.size(); i++)
+	{
+		const Channel& src = vec_channels_[i];
+		Channel& dst = block.channels[i];
+		TrackCopy track_copies[3] = {
+			{ &src.position_track_, &dst.position_track_, 0, quantized ? 6u : 0u, quantized ? 3 * sizeof(uint16_t) : 3 * sizeof(float) },
+			{ &src.rotation_track_, &dst.rotation_track_, 0, 0u, quantized ? 3 * sizeof(uint16_t) : 4 * sizeof(float) },
+			{ &src.scale_track_, &dst.scale_track_, 0, quantized ? 2u : 0u, quantized ? sizeof(uint16_t) : sizeof(float) } };
+		for (TrackCopy& copy : track_copies)
+		{
+			int count;
+			key_range(*copy.src, copy.first, count);
+			copy.dst->num_keys = count;
+			copy.dst->time_offset = with_times ? AllocateKeyArray(count * time_bytes, buffer_size) : buffer_size;
+			copy.dst->value_offset = AllocateKeyArray(copy.header_floats * sizeof(float) + count * copy.key_bytes, buffer_size);
+			copies.push_back(copy);
+		}
+	}
+
+	block.key_buffer.resize(buffer_size * sizeof(float) / sizeof(KeyBlock));
+	float* block_data = block.key_buffer.empty() ? nullptr : block.key_buffer[0].data;
+	for (const TrackCopy& copy : copies)
+	{
+		if (copy.dst->num_keys == 0) continue;
+		if (with_times)
+		{
+			memcpy(block_data + copy.dst->time_offset, reinterpret_cast<const char*>(GetKeyData(copy.src->time_offset)) + copy.first * time_bytes,
+				copy.dst->num_keys * time_bytes);
+		}
+		const float* src_values = GetKeyData(copy.src->value_offset);
+		float* dst_values = block_data + copy.dst->value_offset;
+		memcpy(dst_values, src_values, copy.header_floats * sizeof(float));
+		memcpy(dst_values + copy.header_floats, reinterpret_cast<const char*>(src_values + copy.header_floats) + copy.first * copy.key_bytes,
+			copy.dst->num_keys * copy.key_bytes);
+	}
+	return block;
+}
+
+void Animation::AttachStream(const ClipStream* p_stream) {
+	p_stream_ = p_stream;
+}
+
+bool Animation::IsStreamed() const {
+	return p_stream_ != nullptr;
+}
+
+const Animation& Animation::GetResidentKeys(float normalized_time, AnimationCursor& cursor) const {
+	return p_stream_ != nullptr ? p_stream_->GetKeys(normalized_time, cursor) : *this;
+}
+
+
+void Animation::ResampleUniform(float keys_per_sec) {
+	keys_per_tick_ = keys_per_sec / frame_per_sec_;
+	num_uniform_keys_ = std::max(static_cast<int>(std::ceil(total_frames_ * keys_per_tick_)) + 1, 2);
+
+	// uniform tracks need no time array, key i lies at tick i / keys_per_tick_
+	vector<Channel> uniform_channels = vec_channels_;
+	unsigned int buffer_size = 0;
+	for (Channel& channel : uniform_channels)
+	{
+		AllocateTrack(channel.position_track_, num_uniform_keys_, 3, false, buffer_size);
+		AllocateTrack(channel.rotation_track_, num_uniform_keys_, 4, false, buffer_size);
+		AllocateTrack(channel.scale_track_, num_uniform_keys_, 1, false, buffer_size);
+	}
+
+	vector<KeyBlock> uniform_buffer(buffer_size * sizeof(float) / sizeof(KeyBlock));
+	float* key_data = uniform_buffer.empty() ? nullptr : uniform_buffer[0].data;
+
+	for (int i = 0; i < vec_channels_.size(); i++)
+	{
+		const Channel& channel = vec_channels_[i];
+		float* positions = key_data + uniform_channels[i].position_track_.value_offset;
+		float* rotations = key_data + uniform_channels[i].rotation_track_.value_offset;
+		float* scales = key_data + uniform_channels[i].scale_track_.value_offset;
+
+		ChannelCursor cursor;
+		for (int j = 0; j < num_uniform_keys_; j++)
+		{
+			float tick = std::min(j / keys_per_tick_, static_cast<float>(total_frames_));
+
+			vec3 position = SamplePosition(channel.position_track_, tick, cursor.position_key);
+			positions[j * 3 + 0] = position.x;
+			positions[j * 3 + 1] = position.y;
+			positions[j * 3 + 2] = position.z;
+
+			quat rotation = SampleRotation(channel.rotation_track_, tick, cursor.rotation_key);
+			rotations[j * 4 + 0] = rotation.w;
+			rotations[j * 4 + 1] = rotation.x;
+			rotations[j * 4 + 2] = rotation.y;
+			rotations[j * 4 + 3] = rotation.z;
+
+			scales[j] = SampleScale(channel.scale_track_, tick, cursor.scale_key);
+		}
+	}
+
+	vec_channels_.swap(uniform_channels);
+	key_buffer_.swap(uniform_buffer);
+	key_sample_mode_ = EKeySampleMode::eUniform;
+}
+
+
+// reconstruction errors of a key value from interpolating its neighbouring kept keys v1 and v2
+static float PositionKeyError(const float* v1, const float* v2, const float* value, float factor) {
+	vec3 position = Interpolate(vec3(v1[0], v1[1], v1[2]), vec3(v2[0], v2[1], v2[2]), factor);
+	return glm::distance(position, vec3(value[0], value[1], value[2]));
+}
+static float RotationKeyError(const float* v1, const float* v2, const float* value, float factor) {
+	quat rotation = Interpolate(quat(v1[0], v1[1], v1[2], v1[3]), quat(v2[0], v2[1], v2[2], v2[3]), factor);
+	float cos_half_angle = std::min(std::abs(glm::dot(rotation, quat(value[0], value[1], value[2], value[3]))), 1.0f);
+	return 2.0f * std::acos(cos_half_angle);
+}
+static float ScaleKeyError(const float* v1, const float* v2, const float* value, float factor) {
+	return std::abs(Interpolate(v1[0], v2[0], factor) - value[0]);
+}
+
+// returns indices of the keys a track keeps, greedily extending every kept key as far
+// as all skipped keys stay within tolerance, a constant track keeps only its first key
+template<typename TErrorFunc>
+static vector<int> SelectKeys(const float* times, const float* values, int num_keys, int floats_per_key, float tolerance, TErrorFunc key_error) {
+	vector<int> kept_keys;
+	if (num_keys == 0) return kept_keys;
+
+	kept_keys.push_back(0);
+	bool constant = true;
+	for (int j = 1; j < num_keys && constant; j++)
+	{
+		constant = key_error(values, values, values + j * floats_per_key, 0.0f) <= tolerance;
+	}
+	if (constant) return kept_keys;
+
+	int anchor = 0;
+	for (int end = 2; end < num_keys; end++)
+	{
+		bool fits = true;
+		for (int j = anchor + 1; j < end && fits; j++)
+		{
+			float factor = (times[j] - times[anchor]) / (times[end] - times[anchor]);
+			fits = key_error(values + anchor * floats_per_key, values + end * floats_per_key, values + j * floats_per_key, factor) <= tolerance;
+		}
+		if (fits == false)
+		{
+			anchor = end - 1;
+			kept_keys.push_back(anchor);
+		}
+	}
+	kept_keys.push_back(num_keys - 1);
+	return kept_keys;
+}
+
+KeyCompressionReport Animation::ReduceKeys(const vector<KeyErrorTolerance>& channel_tolerances) {
+	KeyCompressionReport report;
+	report.keys_before = GetKeyCount();
+	report.bytes_before = GetKeyMemorySize();
+
+	if (key_sample_mode_ == EKeySampleMode::eKeyframe && key_format_ == EKeyFormat::eFloat)
+	{
+		const float* key_data = GetKeyData(0);
+		vector<vector<int>> kept_keys(vec_channels_.size() * 3);
+		for (int i = 0; i < vec_channels_.size(); i++)
+		{
+			const Channel& channel = vec_channels_[i];
+			const KeyErrorTolerance& tolerance = channel_tolerances[i];
+			kept_keys[i * 3 + 0] = SelectKeys(key_data + channel.position_track_.time_offset, key_data + channel.position_track_.value_offset,
+				channel.position_track_.num_keys, 3, tolerance.position, PositionKeyError);
+			kept_keys[i * 3 + 1] = SelectKeys(key_data + channel.rotation_track_.time_offset, key_data + channel.rotation_track_.value_offset,
+				channel.rotation_track_.num_keys, 4, tolerance.rotation, RotationKeyError);
+			kept_keys[i * 3 + 2] = SelectKeys(key_data + channel.scale_track_.time_offset, key_data + channel.scale_track_.value_offset,
+				channel.scale_track_.num_keys, 1, tolerance.scale, ScaleKeyError);
+		}
+
+		// copy kept keys into a new, tightly sized buffer
+		vector<Channel> reduced_channels = vec_channels_;
+		unsigned int buffer_size = 0;
+		for (int i = 0; i < reduced_channels.size(); i++)
+		{
+			AllocateTrack(reduced_channels[i].position_track_, kept_keys[i * 3 + 0].size(), 3, true, buffer_size);
+			AllocateTrack(reduced_channels[i].rotation_track_, kept_keys[i * 3 + 1].size(), 4, true, buffer_size);
+			AllocateTrack(reduced_channels[i].scale_track_, kept_keys[i * 3 + 2].size(), 1, true, buffer_size);
+		}
+
+		vector<KeyBlock> reduced_buffer(buffer_size * sizeof(float) / sizeof(KeyBlock));
+		float* reduced_data = reduced_buffer.empty() ? nullptr : reduced_buffer[0].data;
+		auto copy_track = [&](const Track& src, const Track& dst, const vector<int>& keys, int floats_per_key) {
+			for (int k = 0; k < keys.size(); k++)
+			{
+				reduced_data[dst.time_offset + k] = key_data[src.time_offset + keys[k]];
+				std::copy_n(key_data + src.value_offset + keys[k] * floats_per_key, floats_per_key,
+					reduced_data + dst.value_offset + k * floats_per_key);
+			}
+		};
+		for (int i = 0; i < reduced_channels.size(); i++)
+		{
+			copy_track(vec_channels_[i].position_track_, reduced_channels[i].position_track_, kept_keys[i * 3 + 0], 3);
+			copy_track(vec_channels_[i].rotation_track_, reduced_channels[i].rotation_track_, kept_keys[i * 3 + 1], 4);
+			copy_track(vec_channels_[i].scale_track_, reduced_channels[i].scale_track_, kept_keys[i * 3 + 2], 1);
+		}
+
+		vec_channels_.swap(reduced_channels);
+		key_buffer_.swap(reduced_buffer);
+	}
+
+	report.keys_after = GetKeyCount();
+	report.bytes_after = GetKeyMemorySize();
+	return report;
+}
+
+
+KeyCompressionReport Animation::QuantizeKeys() {
+	KeyCompressionReport report;
+	report.keys_before = GetKeyCount();
+	report.bytes_before = GetKeyMemorySize();
+	report.keys_after = report.keys_before;
+	report.bytes_after = report.bytes_before;
+	if (key_format_ == EKeyFormat::eQuantized) return report;
+
+	const bool with_times = key_sample_mode_ == EKeySampleMode::eKeyframe;
+	const float* key_data = GetKeyData(0);
+
+	// whole tick key times (frame indices, like md5anim) are stored exactly,
+	// other clips spread their last key time over the 16 bits range,
+	// total_frames_ is the duration cut to whole ticks, keys after it would clamp
+	float time_step = 1.0f;
+	if (with_times)
+	{
+		float max_time = 0.0f;
+		bool whole_ticks = true;
+		for (const Channel& channel : vec_channels_)
+		{
+			for (const Track* track : { &channel.position_track_, &channel.rotation_track_, &channel.scale_track_ })
+			{
+				for (int j = 0; j < track->num_keys; j++)
+				{
+					float time = key_data[track->time_offset + j];
+					max_time = std::max(max_time, time);
+					whole_ticks = whole_ticks && std::abs(time - std::round(time)) < 1e-4f;
+				}
+			}
+		}
+		if ((whole_ticks == false || max_time > kMax16Bits) && max_time > 0.0f)
+		{
+			time_step = max_time / kMax16Bits;
+		}
+	}
+
+	// position header: range min xyz, range step xyz; scale header: range min, range step
+	vector<Channel> packed_channels = vec_channels_;
+	unsigned int buffer_size = 0;
+	for (Channel& channel : packed_channels)
+	{
+		AllocatePackedTrack(channel.position_track_, channel.position_track_.num_keys, 6, 3, with_times, buffer_size);
+		AllocatePackedTrack(channel.rotation_track_, channel.rotation_track_.num_keys, 0, 3, with_times, buffer_size);
+		AllocatePackedTrack(channel.scale_track_, channel.scale_track_.num_keys, 2, 1, with_times, buffer_size);
+	}
+
+	vector<KeyBlock> packed_buffer(buffer_size * sizeof(float) / sizeof(KeyBlock));
+	float* packed_data = packed_buffer.empty() ? nullptr : packed_buffer[0].data;
+
+	auto pack_times = [&](const Track& src, const Track& dst) {
+		if (with_times == false) return;
+		uint16_t* times = reinterpret_cast<uint16_t*>(packed_data + dst.time_offset);
+		for (int j = 0; j < src.num_keys; j++)
+		{
+			times[j] = QuantizeUnorm16(key_data[src.time_offset + j], 0.0f, time_step);
+		}
+	};
+
+	for (int i = 0; i < vec_channels_.size(); i++)
+	{
+		const Channel& src = vec_channels_[i];
+		const Channel& dst = packed_channels[i];
+
+		pack_times(src.position_track_, dst.position_track_);
+		const float* positions = key_data + src.position_track_.value_offset;
+		float* header = packed_data + dst.position_track_.value_offset;
+		uint16_t* packed = reinterpret_cast<uint16_t*>(header + 6);
+		for (int c = 0; c < 3; c++)
+		{
+			float range_min = positions[c];
+			float range_max = positions[c];
+			for (int j = 1; j < src.position_track_.num_keys; j++)
+			{
+				range_min = std::min(range_min, positions[j * 3 + c]);
+				range_max = std::max(range_max, positions[j * 3 + c]);
+			}
+			header[c] = range_min;
+			header[3 + c] = (range_max - range_min) / kMax16Bits;
+		}
+		for (int j = 0; j < src.position_track_.num_keys; j++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				packed[j * 3 + c] = QuantizeUnorm16(positions[j * 3 + c], header[c], header[3 + c]);
+			}
+		}
+
+		pack_times(src.rotation_track_, dst.rotation_track_);
+		const float* rotations = key_data + src.rotation_track_.value_offset;
+		packed = reinterpret_cast<uint16_t*>(packed_data + dst.rotation_track_.value_offset);
+		for (int j = 0; j < src.rotation_track_.num_keys; j++)
+		{
+			EncodeSmallestThree(rotations + j * 4, packed + j * 3);
+		}
+
+		pack_times(src.scale_track_, dst.scale_track_);
+		const float* scales = key_data + src.scale_track_.value_offset;
+		header = packed_data + dst.scale_track_.value_offset;
+		packed = reinterpret_cast<uint16_t*>(header + 2);
+		if (src.scale_track_.num_keys > 0)
+		{
+			auto range = std::minmax_element(scales, scales + src.scale_track_.num_keys);
+			header[0] = *range.first;
+			header[1] = (*range.second - *range.first) / kMax16Bits;
+		}
+		for (int j = 0; j < src.scale_track_.num_keys; j++)
+		{
+			packed[j] = QuantizeUnorm16(scales[j], header[0], header[1]);
+		}
+	}
+
+	vec_channels_.swap(packed_channels);
+	key_buffer_.swap(packed_buffer);
+	key_format_ = EKeyFormat::eQuantized;
+	key_time_step_ = time_step;
+
+	report.bytes_after = GetKeyMemorySize();
+	return report;
+}
+
+
+int Animation::GetChannelCount() const {
+	return vec_channels_.size();
+}
+
+const string& Animation::GetChannelName(int channel_index) const {
+	return vec_channels_[channel_index].name_;
+}
+
+EKeySampleMode Animation::GetKeySampleMode() const {
+	return key_sample_mode_;
+}
+
+EKeyFormat Animation::GetKeyFormat() const {
+	return key_format_;
+}
+
+size_t Animation::GetKeyCount() const {
+	size_t key_count = 0;
+	for (const Channel& channel : vec_channels_)
+	{
+		key_count += channel.position_track_.num_keys + channel.rotation_track_.num_keys + channel.scale_track_.num_keys;
+	}
+	return key_count;
+}
+
+size_t Animation::GetKeyMemorySize() const {
+	return key_buffer_.size() * sizeof(KeyBlock);
 }
 
 
@@ -51,74 +648,123 @@ float Animation::GetNormalizedTime(float time_in_sec) const {
 
 
 glm::vec3 Animation::GetPosition(const string& channel_name, float time, bool time_normalized) const {
-	float anim_time = GetAnimTime(time, time_normalized);
+	if (p_stream_ != nullptr)
+	{
+		AnimationCursor cursor;
+		return GetResidentKeys(GetAnimTime(time, time_normalized) / total_frames_, cursor).GetPosition(channel_name, time, time_normalized);
+	}
+	int cursor_key = 0;
+	return SamplePosition(GetChannel(channel_name).position_track_, GetAnimTime(time, time_normalized), cursor_key);
+}
+glm::quat Animation::GetRotation(const string& channel_name, float time, bool time_normalized) const {
+	if (p_stream_ != nullptr)
+	{
+		AnimationCursor cursor;
+		return GetResidentKeys(GetAnimTime(time, time_normalized) / total_frames_, cursor).GetRotation(channel_name, time, time_normalized);
+	}
+	int cursor_key = 0;
+	return SampleRotation(GetChannel(channel_name).rotation_track_, GetAnimTime(time, time_normalized), cursor_key);
+}
+float Animation::GetScale(const string& channel_name, float time, bool time_normalized) const {
+	if (p_stream_ != nullptr)
+	{
+		AnimationCursor cursor;
+		return GetResidentKeys(GetAnimTime(time, time_normalized) / total_frames_, cursor).GetScale(channel_name, time, time_normalized);
+	}
+	int cursor_key = 0;
+	return SampleScale(GetChannel(channel_name).scale_track_, GetAnimTime(time, time_normalized), cursor_key);
+}
 
-	unsigned int channel_index = channel_name_to_index_.find(channel_name)->second;
-	const Channel& channel = vec_channels_[channel_index];
-	
-	if (channel.position_channels_.size() > 1)
+
+int Animation::GetChannelIndex(const string& channel_name) const {
+	auto iter = channel_name_to_index_.find(channel_name);
+	return iter != channel_name_to_index_.end() ? iter->second : -1;
+}
+
+const Channel& Animation::GetChannel(const string& channel_name) const {
+	int channel_index = GetChannelIndex(channel_name);
+	if (channel_index < 0)
 	{
-		unsigned int curr_key = FindKey(channel.position_channels_, anim_time);
-		float t1 = channel.position_channels_[curr_key].time;
-		float t2 = channel.position_channels_[curr_key + 1].time;
-		float factor = (anim_time - t1) / (t2 - t1);
-		return Interpolate(channel.position_channels_[curr_key].position,
-			channel.position_channels_[curr_key + 1].position,
-			factor);
+		throw string("Animation ") + anim_name_ + " has no channel " + channel_name;
 	}
-	else if (channel.position_channels_.size() == 1)
+	return vec_channels_[channel_index];
+}
+
+
+AnimationCursor Animation::CreateCursor() const {
+	AnimationCursor cursor;
+	cursor.channel_cursors.resize(vec_channels_.size());
+	return cursor;
+}
+
+glm::vec3 Animation::GetPosition(int channel_index, float time, AnimationCursor& cursor, bool time_normalized) const {
+	if (p_stream_ != nullptr)
 	{
-		return channel.position_channels_[0].position;
+		return GetResidentKeys(GetAnimTime(time, time_normalized) / total_frames_, cursor).GetPosition(channel_index, time, cursor, time_normalized);
 	}
-	else
+	return SamplePosition(vec_channels_[channel_index].position_track_, GetAnimTime(time, time_normalized), 
+		cursor.channel_cursors[channel_index].position_key);
+}
+glm::quat Animation::GetRotation(int channel_index, float time, AnimationCursor& cursor, bool time_normalized) const {
+	if (p_stream_ != nullptr)
 	{
-		return vec3(1.0f);
+		return GetResidentKeys(GetAnimTime(time, time_normalized) / total_frames_, cursor).GetRotation(channel_index, time, cursor, time_normalized);
 	}
+	return SampleRotation(vec_channels_[channel_index].rotation_track_, GetAnimTime(time, time_normalized), 
+		cursor.channel_cursors[channel_index].rotation_key);
+}
+float Animation::GetScale(int channel_index, float time, AnimationCursor& cursor, bool time_normalized) const {
+	if (p_stream_ != nullptr)
+	{
+		return GetResidentKeys(GetAnimTime(time, time_normalized) / total_frames_, cursor).GetScale(channel_index, time, cursor, time_normalized);
+	}
+	return SampleScale(vec_channels_[channel_index].scale_track_, GetAnimTime(time, time_normalized), 
+		cursor.channel_cursors[channel_index].scale_key);
 }
-glm::quat Animation::GetRotation(const string& channel_name, float time, bool time_normalized) const {
-	float anim_time = GetAnimTime(time, time_normalized);
 
-	unsigned int channel_index = channel_name_to_index_.find(channel_name)->second;
-	const Channel& channel = vec_channels_[channel_index];
 
-	if (channel.rotation_channels_.size() > 1)
+glm::vec3 Animation::SamplePosition(const Track& track, float anim_time, int& cursor_key) const {
+	if (track.num_keys > 1)
+	{
+		float factor;
+		int curr_key = FindTrackKey(track, anim_time, cursor_key, factor);
+		return Interpolate(DecodePosition(track, curr_key), DecodePosition(track, curr_key + 1), factor);
+	}
+	else if (track.num_keys == 1)
+	{
+		return DecodePosition(track, 0);
+	}
+	else
 	{
-		unsigned int curr_key = FindKey(channel.rotation_channels_, anim_time);
-		float t1 = channel.rotation_channels_[curr_key].time;
-		float t2 = channel.rotation_channels_[curr_key + 1].time;
-		float factor = (anim_time - t1) / (t2 - t1);
-		return Interpolate(channel.rotation_channels_[curr_key].quaternion,
-			channel.rotation_channels_[curr_key + 1].quaternion,
-			factor);
+		return vec3(1.0f);
+	}
+}
+glm::quat Animation::SampleRotation(const Track& track, float anim_time, int& cursor_key) const {
+	if (track.num_keys > 1)
+	{
+		float factor;
+		int curr_key = FindTrackKey(track, anim_time, cursor_key, factor);
+		return Interpolate(DecodeRotation(track, curr_key), DecodeRotation(track, curr_key + 1), factor);
 	}
-	else if (channel.rotation_channels_.size() == 1)
+	else if (track.num_keys == 1)
 	{
-		return channel.rotation_channels_[0].quaternion;
+		return DecodeRotation(track, 0);
 	}
 	else
 	{
 		return quat();
 	}
 }
-float Animation::GetScale(const string& channel_name, float time, bool time_normalized) const {
-	float anim_time = GetAnimTime(time, time_normalized);
-
-	unsigned int channel_index = channel_name_to_index_.find(channel_name)->second;
-	const Channel& channel = vec_channels_[channel_index];
-
-	if (channel.scale_channels_.size() > 1)
+float Animation::SampleScale(const Track& track, float anim_time, int& cursor_key) const {
+	if (track.num_keys > 1)
 	{
-		unsigned int curr_key = FindKey(channel.scale_channels_, anim_time);
-		float t1 = channel.scale_channels_[curr_key].time;
-		float t2 = channel.scale_channels_[curr_key + 1].time;
-		float factor = (anim_time - t1) / (t2 - t1);
-		return Interpolate(channel.scale_channels_[curr_key].scale,
-			channel.scale_channels_[curr_key + 1].scale,
-			factor);
+		float factor;
+		int curr_key = FindTrackKey(track, anim_time, cursor_key, factor);
+		return Interpolate(DecodeScale(track, curr_key), DecodeScale(track, curr_key + 1), factor);
 	}
-	else if (channel.scale_channels_.size() == 1)
+	else if (track.num_keys == 1)
 	{
-		return channel.scale_channels_[0].scale;
+		return DecodeScale(track, 0);
 	}
 	else
 	{
@@ -126,39 +772,115 @@ float Animation::GetScale(const string& channel_name, float time, bool time_norm
 	}
 }
 
+glm::vec3 Animation::DecodePosition(const Track& track, int key) const {
+	const float* values = GetKeyData(track.value_offset);
+	if (key_format_ == EKeyFormat::eQuantized)
+	{
+		const uint16_t* packed = reinterpret_cast<const uint16_t*>(values + 6) + key * 3;
+		return vec3(values[0] + packed[0] * values[3], values[1] + packed[1] * values[4], values[2] + packed[2] * values[5]);
+	}
+	const float* value = values + key * 3;
+	return vec3(value[0], value[1], value[2]);
+}
+glm::quat Animation::DecodeRotation(const Track& track, int key) const {
+	if (key_format_ == EKeyFormat::eQuantized)
+	{
+		return DecodeSmallestThree(GetPackedKeyData(track.value_offset) + key * 3);
+	}
+	const float* value = GetKeyData(track.value_offset) + key * 4;
+	return quat(value[0], value[1], value[2], value[3]);
+}
+float Animation::DecodeScale(const Track& track, int key) const {
+	const float* values = GetKeyData(track.value_offset);
+	if (key_format_ == EKeyFormat::eQuantized)
+	{
+		return values[0] + reinterpret_cast<const uint16_t*>(values + 2)[key] * values[1];
+	}
+	return values[key];
+}
+
+inline const float* Animation::GetKeyData(unsigned int offset) const {
+	return key_buffer_.empty() ? nullptr : key_buffer_[0].data + offset;
+}
+
+inline const uint16_t* Animation::GetPackedKeyData(unsigned int offset) const {
+	return reinterpret_cast<const uint16_t*>(GetKeyData(offset));
+}
+
 inline float Animation::GetAnimTime(float time, bool time_normalized) const {
 	float anim_time = time_normalized ? time * total_frames_ : time * frame_per_sec_;
 	return fmod(anim_time, total_frames_);
 }
 
-// TODO: eliminate duplicated code without using polymorphism
-int Animation::FindKey(const vector<PositionKeyFrame>& channel, float time) const {
-	for (unsigned int i = 0; i < channel.size() - 1; i++)
+int Animation::FindTrackKey(const Track& track, float anim_time, int& cursor_key, float& factor) const {
+	// uniform keys, no search
+	if (key_sample_mode_ == EKeySampleMode::eUniform)
 	{
-		if (time < channel[i + 1].time)
-		{
-			return i;
-		}
+		// blocks of a streamed clip hold keys first_uniform_key_ on, they interpolate as the whole clip does
+		float key_time = anim_time * keys_per_tick_;
+		int key = std::min(std::max(static_cast<int>(key_time), first_uniform_key_), first_uniform_key_ + static_cast<int>(track.num_keys) - 2);
+		factor = std::min(std::max(key_time - key, 0.0f), 1.0f);
+		return key - first_uniform_key_;
 	}
-	return -1;
+
+	if (key_format_ == EKeyFormat::eQuantized)
+	{
+		return FindKey(GetPackedKeyData(track.time_offset), track.num_keys, anim_time / key_time_step_, cursor_key, factor);
+	}
+	return FindKey(GetKeyData(track.time_offset), track.num_keys, anim_time, cursor_key, factor);
 }
-int Animation::FindKey(const vector<RotationKeyFrame>& channel, float time) const {
-	for (unsigned int i = 0; i < channel.size() - 1; i++)
+
+// playback time is usually monotonic, so the key is first searched by stepping from
+// the cursor, which costs O(1) per frame no matter how long the clip is
+template<typename TKeyTime>
+int Animation::FindKey(const TKeyTime* key_times, int num_keys, float time, int& cursor_key, float& factor) const {
+	const int last_key = num_keys - 2;
+	int key = std::min(std::max(cursor_key, 0), last_key);
+
+	int step = 0;
+	for (; step < kMaxCursorSteps; step++)
 	{
-		if (time < channel[i + 1].time)
+		if (key > 0 && time < key_times[key])
+		{
+			key--;
+		}
+		else if (key < last_key && time >= key_times[key + 1])
+		{
+			key++;
+		}
+		else
 		{
-			return i;
+			break;
 		}
 	}
-	return -1;
-}
-int Animation::FindKey(const vector<ScaleKeyFrame>& channel, float time) const {
-	for (unsigned int i = 0; i < channel.size() - 1; i++)
+
+	// seek or loop wrap-around, cursor is too far away
+	// the key index equals the number of inner keys (1 to num_keys - 2) not later than time,
+	// narrow the range with a branchless binary search, then count the rest linearly
+	if (step == kMaxCursorSteps)
 	{
-		if (time < channel[i + 1].time)
+		const TKeyTime* inner_times = key_times + 1;
+		int offset = 0;
+		int length = last_key;
+		while (length > kLinearSearchKeys)
 		{
-			return i;
+			int half = length / 2;
+			bool in_upper_half = inner_times[offset + half - 1] <= time;
+			offset = in_upper_half ? offset + half : offset;
+			length = in_upper_half ? length - half : half;
 		}
+
+		int count = 0;
+		for (int i = offset; i < offset + length; i++)
+		{
+			count += inner_times[i] <= time;
+		}
+		key = offset + count;
 	}
-	return -1;
-}
\ No newline at end of file
+
+	cursor_key = key;
+	float t1 = key_times[key];
+	float t2 = key_times[key + 1];
+	factor = t2 > t1 ? std::min(std::max((time - t1) / (t2 - t1), 0.0f), 1.0f) : 0.0f;
+	return key;
+}
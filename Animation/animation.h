@@ -8,6 +8,7 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include<cstdint>
 #include<string>
 #include<vector>
 #include<unordered_map>
@@ -15,42 +16,137 @@ using std::vector;
 using std::string;
 using std::unordered_map;
 
-// if using polymorphism, we need use vector<KeyFrame*> to store all key frame,
-// considering the amount of key frame, the additional memory to store pointers
-// may be relatively large, so I did't choose to use polymorphism
-struct KeyFrame
+class ClipStream;
+
+// keys of one track (position, rotation or scale) of a channel, stored structure-of-arrays:
+// times and values are two separate contiguous arrays inside the clip's key buffer,
+// so key search only touches time data
+struct Track
+{
+	unsigned int num_keys = 0;
+	// offsets in floats from the start of the key buffer, both 16 bytes aligned
+	unsigned int time_offset = 0;
+	unsigned int value_offset = 0;
+};
+
+// 16 bytes unit of the key buffer, keeps every track array aligned for SIMD loads
+struct alignas(16) KeyBlock
+{
+	float data[4];
+};
+
+enum class EKeyFormat
+{
+	// 32 bits float times and values
+	eFloat,
+	// 16 bits times in multiples of a clip time step, smallest three quaternions in 48 bits,
+	// positions and scales as 16 bits per component normalized to the range of their track
+	eQuantized
+};
+
+enum class EKeySampleMode
 {
-	float time;
+	// keep the keys of the source file, sampling searches key times
+	eKeyframe,
+	// resample every track to evenly spaced keys at load time,
+	// sampling is index arithmetic, costs more memory for sparse tracks
+	eUniform
+};
+
+// max error a reduced track may introduce when its removed keys are interpolated back
+struct KeyErrorTolerance
+{
+	float position = 0.01f;
+	float rotation = 0.002f; // radians
+	float scale = 0.001f;
+};
+
+struct AnimationImportOption
+{
+	EKeySampleMode key_sample_mode = EKeySampleMode::eKeyframe;
+	// keys per second in uniform mode, 0 means using the clip's frame_per_sec_
+	float resample_rate = 0.0f;
+
+	// keyframe mode only, drop keys interpolation can rebuild within the tolerance,
+	// which bounds the error of bone world positions (tolerance.position) for the whole skeleton
+	bool reduce_keys = false;
+	KeyErrorTolerance key_error_tolerance;
+
+	// store keys as EKeyFormat::eQuantized, after key reduction if both are on
+	bool quantize_keys = false;
 };
 
-struct PositionKeyFrame : KeyFrame
+struct KeyCompressionReport
 {
-	glm::vec3 position;
+	size_t keys_before = 0;
+	size_t keys_after = 0;
+	size_t bytes_before = 0;
+	size_t bytes_after = 0;
 };
 
-struct RotationKeyFrame : KeyFrame
+// remembers the key each track of a channel was sampled at last time,
+// with monotonic playback the next key is found by stepping from there
+struct ChannelCursor
 {
-	glm::quat quaternion;
+	int position_key = 0;
+	int rotation_key = 0;
+	int scale_key = 0;
 };
 
-struct ScaleKeyFrame : KeyFrame
+// per animation instance playback state, one cursor per channel
+struct AnimationCursor
 {
-	float scale; // uniform
+	vector<ChannelCursor> channel_cursors;
+	// streamed clips only, block sampled last time, a miss falls back to it
+	int resident_block = 0;
 };
 
 struct Channel
 {
 	string name_;
-	vector<PositionKeyFrame> position_channels_;
-	vector<RotationKeyFrame> rotation_channels_;
-	vector<ScaleKeyFrame> scale_channels_;
+	Track position_track_; // vec3 per key
+	Track rotation_track_; // quat per key, stored as w, x, y, z
+	Track scale_track_;    // uniform scale per key
 };
 
+// everything an Animation holds, the form baked model files store clips in
+struct AnimationClipData
+{
+	string name;
+	int total_frames = 0;
+	float frame_per_sec = 0.0f;
+	float total_sec = 0.0f;
+	vector<Channel> channels;
+	vector<KeyBlock> key_buffer;
+	EKeyFormat key_format = EKeyFormat::eFloat;
+	float key_time_step = 1.0f;
+	EKeySampleMode key_sample_mode = EKeySampleMode::eKeyframe;
+	float keys_per_tick = 0.0f;
+	int num_uniform_keys = 0;
+	// blocks of uniform clips only, index of the block's first key in the whole clip
+	int first_uniform_key = 0;
+};
+
+// whether the key format and sample mode are known and every track's times and values lie inside key_buffer,
+// for clips read from files, Animation trusts its tracks
+bool AreTracksInKeyBuffer(const AnimationClipData& clip_data);
+
 
 class Animation
 {
 public:
-	Animation(const aiAnimation* anim);
+	Animation(const aiAnimation* anim, const AnimationImportOption& option = AnimationImportOption());
+	// clip read back from a baked model file, keys are used as they are
+	explicit Animation(AnimationClipData clip_data);
+	AnimationClipData GetClipData() const;
+
+	// keys needed to sample [begin_tick, end_tick] exactly as the whole clip, as a clip of their own
+	AnimationClipData ExtractBlock(float begin_tick, float end_tick) const;
+	// from now on keys come from the stream's resident blocks, the clip itself keeps channel names only
+	void AttachStream(const ClipStream* p_stream);
+	bool IsStreamed() const;
+	// the clip itself, or for streamed clips the resident block to sample normalized_time from, never waits for a load
+	const Animation& GetResidentKeys(float normalized_time, AnimationCursor& cursor) const;
 
 	const string anim_name_;
 	const int total_frames_;
@@ -62,13 +158,71 @@ public:
 	glm::vec3 GetPosition(const string& channel_name, float time, bool time_normalized = true) const;
 	glm::quat GetRotation(const string& channel_name, float time, bool time_normalized = true) const;
 	float GetScale(const string& channel_name, float time, bool time_normalized = true) const;
+
+	// returns -1 if the animation has no channel with this name
+	int GetChannelIndex(const string& channel_name) const;
+
+	// sampling by a channel index resolved once by GetChannelIndex, no string lookup,
+	// key search starts from the cursor instead of the whole track
+	AnimationCursor CreateCursor() const;
+	glm::vec3 GetPosition(int channel_index, float time, AnimationCursor& cursor, bool time_normalized = true) const;
+	glm::quat GetRotation(int channel_index, float time, AnimationCursor& cursor, bool time_normalized = true) const;
+	float GetScale(int channel_index, float time, AnimationCursor& cursor, bool time_normalized = true) const;
+
+	// collapses constant tracks and removes keys interpolation of their neighbours rebuilds
+	// within channel_tolerances[channel index], keyframe mode only
+	KeyCompressionReport ReduceKeys(const vector<KeyErrorTolerance>& channel_tolerances);
+	// repacks all keys as EKeyFormat::eQuantized, sampling decodes them on the fly
+	KeyCompressionReport QuantizeKeys();
+
+	int GetChannelCount() const;
+	const string& GetChannelName(int channel_index) const;
+
+	EKeySampleMode GetKeySampleMode() const;
+	EKeyFormat GetKeyFormat() const;
+	size_t GetKeyCount() const;
+	size_t GetKeyMemorySize() const;
 private:
 	vector<Channel> vec_channels_;
 	unordered_map<string, unsigned int> channel_name_to_index_;
 
-	int FindKey(const vector<PositionKeyFrame>& pos_channel, float time) const;
-	int FindKey(const vector<RotationKeyFrame>& rot_channel, float time) const;
-	int FindKey(const vector<ScaleKeyFrame>& scale_channel, float time) const;
+	// times and values of all tracks of this clip, one allocation per clip
+	vector<KeyBlock> key_buffer_;
+	inline const float* GetKeyData(unsigned int offset) const;
+	inline const uint16_t* GetPackedKeyData(unsigned int offset) const;
+
+	// quantized format only, key time = 16 bits time * key_time_step_ (in ticks)
+	EKeyFormat key_format_ = EKeyFormat::eFloat;
+	float key_time_step_ = 1.0f;
+
+	// uniform mode only, every track has num_uniform_keys_ keys, key i is at tick i / keys_per_tick_
+	EKeySampleMode key_sample_mode_ = EKeySampleMode::eKeyframe;
+	float keys_per_tick_ = 0.0f;
+	int num_uniform_keys_ = 0;
+	int first_uniform_key_ = 0;
+	void ResampleUniform(float keys_per_sec);
+
+	const ClipStream* p_stream_ = nullptr;
+
+	// keys farther than this from the cursor are found by binary search (seek, loop wrap-around)
+	static constexpr int kMaxCursorSteps = 4;
+	// binary search stops at a range this small, the rest is a linear count the compiler vectorizes
+	static constexpr int kLinearSearchKeys = 16;
+
+	glm::vec3 SamplePosition(const Track& track, float anim_time, int& cursor_key) const;
+	glm::quat SampleRotation(const Track& track, float anim_time, int& cursor_key) const;
+	float SampleScale(const Track& track, float anim_time, int& cursor_key) const;
+
+	glm::vec3 DecodePosition(const Track& track, int key) const;
+	glm::quat DecodeRotation(const Track& track, int key) const;
+	float DecodeScale(const Track& track, int key) const;
+
+	int FindTrackKey(const Track& track, float anim_time, int& cursor_key, float& factor) const;
+	// returns index i of the key segment [i, i + 1] containing time, with its interpolation factor
+	template<typename TKeyTime>
+	int FindKey(const TKeyTime* key_times, int num_keys, float time, int& cursor_key, float& factor) const;
+
+	const Channel& GetChannel(const string& channel_name) const;
 
 	inline float GetAnimTime(float time, bool time_normalized) const;
 };
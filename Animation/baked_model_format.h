@@ -0,0 +1,142 @@
+#ifndef BAKED_MODEL_FORMAT_H
+#define BAKED_MODEL_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "vertex.h"
+#include "animation.h"
+
+// layout of .animbake files, written by AssetBaker and memory mapped by ModelData
+//
+// file = BakedFileHeader, BakedSection table (one per EBakedSection), then the section payloads
+// every payload starts at a multiple of kBakedSectionAlignment, so arrays are read in place
+// strings are offsets into the eStrings section, each one null terminated
+// all values are little endian, vertices are Vertex as compiled with kBakedModelVersion
+
+constexpr char kBakedModelExtension[] = ".animbake";
+constexpr char kBakedModelMagic[8] = { 'A', 'N', 'I', 'M', 'B', 'A', 'K', 'E' };
+// bump whenever a struct below or Vertex, Track or KeyBlock changes
+constexpr uint32_t kBakedModelVersion = 2;
+constexpr uint32_t kBakedEndianTag = 0x01020304;
+constexpr uint32_t kBakedSectionAlignment = 16;
+
+enum class EBakedSection : uint32_t
+{
+    eStrings,
+    eMeshes,        // BakedMesh
+    eTextureRefs,   // int32_t, texture index per mesh material slot
+    eVertices,      // Vertex
+    eIndices,       // uint32_t, relative to the mesh's first vertex
+    eTextures,      // BakedTexture
+    ePixels,        // decoded pixels of embedded textures
+    eBones,         // BakedBone
+    eClips,         // BakedClip
+    eChannels,      // BakedChannel
+    eKeyBlocks,     // KeyBlock
+    eStreamBlocks,  // BakedStreamBlock
+    eStreamData,    // blocks of streamed clips, see GetStreamBlockKeyOffset
+    eCount
+};
+
+struct BakedSection
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct BakedFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endian_tag;
+    uint32_t vertex_size;
+    uint32_t section_count;
+    uint32_t has_skeleton;
+    uint32_t padding;
+    // column major, same as glm
+    float root_transform[16];
+};
+
+struct BakedMesh
+{
+    uint32_t first_vertex;
+    uint32_t num_vertices;
+    uint32_t first_index;
+    uint32_t num_indices;
+    uint32_t first_texture_ref;
+    uint32_t num_texture_refs;
+};
+
+struct BakedTexture
+{
+    uint32_t type;
+    // relative to the directory of the baked file
+    uint32_t path;
+    // ImageCache key of embedded textures, file textures get theirs from the path at load
+    uint32_t cache_key;
+    // embedded textures only, pixel_size is 0 for texture files
+    int32_t width;
+    int32_t height;
+    int32_t components;
+    uint64_t pixel_offset;
+    uint64_t pixel_size;
+};
+
+struct BakedBone
+{
+    float offset[16];
+    float bind_local_transform[16];
+    int32_t parent_index;
+    uint32_t name;
+};
+
+struct BakedClip
+{
+    uint32_t name;
+    int32_t total_frames;
+    float frame_per_sec;
+    float total_sec;
+    uint32_t key_format;
+    float key_time_step;
+    uint32_t key_sample_mode;
+    float keys_per_tick;
+    int32_t num_uniform_keys;
+    uint32_t first_channel;
+    uint32_t num_channels;
+    // streamed clips only, they have no key blocks of their own
+    float stream_block_ticks;
+    uint64_t first_key_block;
+    uint64_t num_key_blocks;
+    uint64_t first_stream_block;
+    uint64_t num_stream_blocks;
+};
+
+struct BakedChannel
+{
+    uint32_t name;
+    Track position_track;
+    Track rotation_track;
+    Track scale_track;
+};
+
+// a fixed duration piece of a streamed clip, read from the file when playback needs it
+struct BakedStreamBlock
+{
+    float begin_tick;
+    float end_tick;
+    int32_t first_uniform_key;
+    uint32_t padding;
+    // into the eStreamData section
+    uint64_t offset;
+    uint64_t size;
+};
+
+// a stream block is the Track array of its clip's channels (position, rotation, scale of each),
+// then from this offset the KeyBlocks those tracks point into
+inline size_t GetStreamBlockKeyOffset(size_t num_channels) {
+    size_t tracks_size = num_channels * 3 * sizeof(Track);
+    return (tracks_size + kBakedSectionAlignment - 1) / kBakedSectionAlignment * kBakedSectionAlignment;
+}
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef BONE_PALETTE_RING_H
+#define BONE_PALETTE_RING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+
+#include "utility/skinning_palette.h"
+
+// binding point of the BonePalette storage block in lighting.vs
+constexpr GLuint kBonePaletteBinding = 0;
+
+// skinning palettes in one shader storage buffer of kFramesInFlight regions, each with a slice per instance
+// slices hold exactly the skeleton's bones in the palette encoding, so there is no bone cap and no per draw uniform upload
+// the animation update writes its slice of the current region directly, and a fence per region
+// keeps the CPU from overwriting a region the GPU may still read
+class BonePaletteRing
+{
+public:
+    static constexpr int kFramesInFlight = 3;
+
+    // with GL 4.4 or ARB_buffer_storage the buffer stays mapped, otherwise each frame's region is mapped unsynchronized
+    BonePaletteRing(int num_bones, int max_instances, EPaletteEncoding encoding = EPaletteEncoding::eMat4) {
+        num_bones_ = num_bones > 0 ? num_bones : 1;
+        max_instances_ = max_instances > 0 ? max_instances : 1;
+        encoding_ = encoding;
+        bone_size_ = GetPaletteVec4sPerBone(encoding) * sizeof(glm::vec4);
+        persistent_ = GLAD_GL_VERSION_4_4 != 0 || GLAD_GL_ARB_buffer_storage != 0;
+
+        GLint alignment = 0;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        slice_size_ = AlignUp(num_bones_ * bone_size_, alignment > 0 ? alignment : 1);
+        region_size_ = slice_size_ * max_instances_;
+
+        glGenBuffers(1, &buffer_);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_);
+        if (persistent_)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_SHADER_STORAGE_BUFFER, region_size_ * kFramesInFlight, nullptr, flags);
+            p_mapped_ = static_cast<uint8_t*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, region_size_ * kFramesInFlight, flags));
+        }
+        else
+        {
+            glBufferData(GL_SHADER_STORAGE_BUFFER, region_size_ * kFramesInFlight, nullptr, GL_DYNAMIC_DRAW);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        if (persistent_ && p_mapped_ == nullptr)
+        {
+            throw std::string("Bone palette buffer mapping failed");
+        }
+    }
+
+    // deleting the buffer also unmaps it
+    ~BonePaletteRing() {
+        for (GLsync fence : fences_)
+        {
+            if (fence != nullptr)
+            {
+                glDeleteSync(fence);
+            }
+        }
+        glDeleteBuffers(1, &buffer_);
+    }
+    // the buffer and the fences belong to one ring
+    BonePaletteRing(const BonePaletteRing&) = delete;
+    BonePaletteRing& operator=(const BonePaletteRing&) = delete;
+
+    // moves on to the next region, waiting for the GPU if it may still read it
+    void BeginFrame() {
+        region_ = (region_ + 1) % kFramesInFlight;
+        WaitForRegion(region_);
+        if (persistent_ == false)
+        {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_);
+            p_mapped_ = static_cast<uint8_t*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, region_ * region_size_, region_size_,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+    }
+
+    // GetBoneCount bones in GetEncoding for one instance, in the current region, write only
+    float* GetSlice(int instance) const {
+        uint8_t* region = persistent_ ? p_mapped_ + region_ * region_size_ : p_mapped_;
+        return reinterpret_cast<float*>(region + instance * slice_size_);
+    }
+
+    // binds an instance's slice of the current region to kBonePaletteBinding, no more writes to the region after this
+    void BindSlice(int instance) {
+        UnmapRegion();
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kBonePaletteBinding, buffer_,
+            region_ * region_size_ + instance * slice_size_, num_bones_ * bone_size_);
+    }
+
+    // binds the whole current region, for instanced draws that index it by GetSliceOffset
+    void BindRegion() {
+        UnmapRegion();
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kBonePaletteBinding, buffer_, region_ * region_size_, region_size_);
+    }
+
+    // first vec4 of an instance's slice, from the start of a region
+    int GetSliceOffset(int instance) const {
+        return static_cast<int>(instance * slice_size_ / sizeof(glm::vec4));
+    }
+
+    // after the last draw reading the current region
+    void FenceFrame() {
+        if (fences_[region_] != nullptr)
+        {
+            glDeleteSync(fences_[region_]);
+        }
+        fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    int GetBoneCount() const {
+        return num_bones_;
+    }
+
+    EPaletteEncoding GetEncoding() const {
+        return encoding_;
+    }
+
+    int GetMaxInstanceCount() const {
+        return max_instances_;
+    }
+
+    size_t GetBufferSize() const {
+        return region_size_ * kFramesInFlight;
+    }
+
+    // BeginFrames that had to block on the GPU, more than a few mean kFramesInFlight is too small
+    int GetStallCount() const {
+        return num_stalls_;
+    }
+
+private:
+    // 1 ms, the wait is retried until the fence signals
+    static constexpr GLuint64 kFenceWaitNs = 1000000;
+
+    unsigned int buffer_ = 0;
+    int num_bones_;
+    int max_instances_;
+    EPaletteEncoding encoding_;
+    size_t bone_size_;
+    size_t slice_size_;
+    size_t region_size_;
+    bool persistent_;
+    // the whole buffer when persistent, else the current region while it's mapped
+    uint8_t* p_mapped_ = nullptr;
+    int region_ = 0;
+    GLsync fences_[kFramesInFlight] = {};
+    int num_stalls_ = 0;
+
+    static size_t AlignUp(size_t size, size_t alignment) {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    // ends the writes to the current region when it isn't persistently mapped
+    void UnmapRegion() {
+        if (persistent_ == false && p_mapped_ != nullptr)
+        {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_);
+            glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            p_mapped_ = nullptr;
+        }
+    }
+
+    void WaitForRegion(int region) {
+        if (fences_[region] == nullptr)
+        {
+            return;
+        }
+        // a poll first, a region three frames old is usually free
+        GLenum result = glClientWaitSync(fences_[region], 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            num_stalls_++;
+            do
+            {
+                result = glClientWaitSync(fences_[region], GL_SYNC_FLUSH_COMMANDS_BIT, kFenceWaitNs);
+            } while (result == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fences_[region]);
+        fences_[region] = nullptr;
+    }
+};
+
+#endif
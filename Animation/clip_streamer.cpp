@@ -0,0 +1,295 @@
+#include "clip_streamer.h"
+
+#include "baked_model_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+
+const Animation& ClipStream::GetKeys(float normalized_time, AnimationCursor& cursor) const {
+    const long long frame = p_streamer_->frame_.load(std::memory_order_relaxed);
+    const int num_blocks = static_cast<int>(blocks_.size());
+    float anim_tick = normalized_time * p_clip_->total_frames_;
+    int index = GetBlockIndex(anim_tick);
+
+    Block& block = *blocks_[index];
+    Touch(block, frame);
+    const Animation* p_keys = block.p_resident.load(std::memory_order_acquire);
+    if (p_keys != nullptr)
+    {
+        p_streamer_->hits_.fetch_add(1, std::memory_order_relaxed);
+        cursor.resident_block = index;
+    }
+    else
+    {
+        // sampling a block outside its range holds its first or last keys, which is close to
+        // where this character was last frame, much better than a stall or a jump to bind pose
+        p_streamer_->misses_.fetch_add(1, std::memory_order_relaxed);
+        p_streamer_->Request(*this, block);
+
+        int fallback = cursor.resident_block < num_blocks ? cursor.resident_block : 0;
+        p_keys = blocks_[fallback]->p_resident.load(std::memory_order_acquire);
+        if (p_keys == nullptr)
+        {
+            fallback = 0;
+            p_keys = blocks_[0]->p_resident.load(std::memory_order_acquire);
+        }
+        Touch(*blocks_[fallback], frame);
+        cursor.resident_block = fallback;
+    }
+
+    // blocks playback reaches within the prefetch time, clips loop so the first block follows the last
+    float prefetch_ticks = p_streamer_->prefetch_sec_.load(std::memory_order_relaxed) * p_clip_->frame_per_sec_;
+    int num_ahead = std::min(static_cast<int>((anim_tick + prefetch_ticks) / block_ticks_) - static_cast<int>(anim_tick / block_ticks_), num_blocks - 1);
+    for (int i = 1; i <= num_ahead; i++)
+    {
+        Block& next = *blocks_[(index + i) % num_blocks];
+        Touch(next, frame);
+        if (next.p_resident.load(std::memory_order_relaxed) == nullptr)
+        {
+            p_streamer_->Request(*this, next);
+        }
+    }
+    return *p_keys;
+}
+
+int ClipStream::GetBlockIndex(float anim_tick) const {
+    return std::min(std::max(static_cast<int>(anim_tick / block_ticks_), 0), static_cast<int>(blocks_.size()) - 1);
+}
+
+void ClipStream::Touch(Block& block, long long frame) const {
+    // every character playing the clip touches the block, skip the store if one already did this frame
+    if (block.last_used_frame.load(std::memory_order_relaxed) != frame)
+    {
+        block.last_used_frame.store(frame, std::memory_order_relaxed);
+    }
+}
+
+
+ClipStreamer::ClipStreamer(const string& baked_path, size_t budget_bytes, float prefetch_sec) :
+    path_(baked_path), file_(baked_path, std::ios::binary), budget_bytes_(budget_bytes), prefetch_sec_(prefetch_sec) {
+    if (!file_)
+    {
+        throw string("Can't open clip stream: ") + baked_path;
+    }
+    io_thread_ = std::thread(&ClipStreamer::IoLoop, this);
+}
+
+ClipStreamer::~ClipStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stop_ = true;
+    }
+    queue_cv_.notify_all();
+    io_thread_.join();
+}
+
+void ClipStreamer::AddClip(Animation& clip, float block_ticks, const vector<ClipBlockInfo>& blocks) {
+    if (blocks.empty() || block_ticks <= 0.0f)
+    {
+        throw string("Streamed clip ") + clip.anim_name_ + " has no blocks";
+    }
+
+    auto p_stream = std::make_unique<ClipStream>();
+    p_stream->p_streamer_ = this;
+    p_stream->p_clip_ = &clip;
+    p_stream->block_ticks_ = block_ticks;
+    for (const ClipBlockInfo& info : blocks)
+    {
+        p_stream->blocks_.push_back(std::make_unique<Block>());
+        p_stream->blocks_.back()->info = info;
+    }
+
+    // misses fall back to the first block, so it has to be there from the start
+    Block& first_block = *p_stream->blocks_[0];
+    first_block.pinned = true;
+    first_block.requested = true;
+    MakeResident(first_block, ReadBlock(*p_stream, first_block));
+
+    clip.AttachStream(p_stream.get());
+    streams_.push_back(std::move(p_stream));
+}
+
+void ClipStreamer::Update() {
+    frame_.fetch_add(1, std::memory_order_relaxed);
+
+    vector<LoadedBlock> loaded;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        loaded.swap(loaded_);
+    }
+    for (LoadedBlock& loaded_block : loaded)
+    {
+        // LoadAll may have read it meanwhile
+        if (loaded_block.p_block->p_owner == nullptr)
+        {
+            MakeResident(*loaded_block.p_block, std::move(loaded_block.p_keys));
+        }
+    }
+
+    if (resident_bytes_ <= budget_bytes_)
+    {
+        return;
+    }
+
+    // least recently sampled first, blocks sampled this frame go last
+    std::sort(resident_.begin(), resident_.end(), [](const Block* a, const Block* b) {
+        return a->last_used_frame.load(std::memory_order_relaxed) < b->last_used_frame.load(std::memory_order_relaxed);
+    });
+    vector<Block*> kept;
+    for (Block* p_block : resident_)
+    {
+        if (resident_bytes_ > budget_bytes_ && p_block->pinned == false)
+        {
+            Evict(*p_block);
+        }
+        else
+        {
+            kept.push_back(p_block);
+        }
+    }
+    resident_.swap(kept);
+}
+
+void ClipStreamer::LoadAll() {
+    for (const std::unique_ptr<ClipStream>& p_stream : streams_)
+    {
+        for (const std::unique_ptr<Block>& p_block : p_stream->blocks_)
+        {
+            if (p_block->p_owner == nullptr)
+            {
+                p_block->requested = true;
+                MakeResident(*p_block, ReadBlock(*p_stream, *p_block));
+            }
+        }
+    }
+}
+
+void ClipStreamer::SetBudget(size_t budget_bytes) {
+    budget_bytes_ = budget_bytes;
+}
+
+size_t ClipStreamer::GetBudget() const {
+    return budget_bytes_;
+}
+
+void ClipStreamer::SetPrefetchTime(float prefetch_sec) {
+    prefetch_sec_.store(prefetch_sec, std::memory_order_relaxed);
+}
+
+ClipStreamStats ClipStreamer::GetStats() const {
+    ClipStreamStats stats;
+    stats.hits = hits_.load();
+    stats.misses = misses_.load();
+    stats.loads = loads_;
+    stats.evictions = evictions_;
+    stats.failed_loads = failed_loads_.load();
+    stats.resident_blocks = static_cast<int>(resident_.size());
+    stats.resident_bytes = resident_bytes_;
+    return stats;
+}
+
+// called by sampling threads, a block is queued once until it is evicted again
+void ClipStreamer::Request(const ClipStream& stream, Block& block) {
+    if (block.requested.exchange(true, std::memory_order_relaxed) == false)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            requests_.emplace_back(&stream, &block);
+        }
+        queue_cv_.notify_one();
+    }
+}
+
+// block = Track array of the clip's channels, padded to kBakedSectionAlignment, then its KeyBlocks
+std::unique_ptr<Animation> ClipStreamer::ReadBlock(const ClipStream& stream, const Block& block) {
+    AnimationClipData clip_data = stream.p_clip_->GetClipData();
+    const size_t num_tracks = clip_data.channels.size() * 3;
+    const size_t key_offset = GetStreamBlockKeyOffset(clip_data.channels.size());
+    if (block.info.size < key_offset || (block.info.size - key_offset) % sizeof(KeyBlock) != 0)
+    {
+        throw string("Corrupt clip block of ") + clip_data.name + " in " + path_;
+    }
+
+    vector<Track> tracks(num_tracks);
+    clip_data.key_buffer.resize((block.info.size - key_offset) / sizeof(KeyBlock));
+    {
+        std::lock_guard<std::mutex> lock(file_mutex_);
+        file_.clear();
+        file_.seekg(block.info.file_offset);
+        file_.read(reinterpret_cast<char*>(tracks.data()), num_tracks * sizeof(Track));
+        file_.seekg(block.info.file_offset + key_offset);
+        file_.read(reinterpret_cast<char*>(clip_data.key_buffer.data()), clip_data.key_buffer.size() * sizeof(KeyBlock));
+        if (!file_)
+        {
+            throw string("Can't read clip block of ") + clip_data.name + " from " + path_;
+        }
+    }
+
+    for (size_t i = 0; i < clip_data.channels.size(); i++)
+    {
+        clip_data.channels[i].position_track_ = tracks[i * 3 + 0];
+        clip_data.channels[i].rotation_track_ = tracks[i * 3 + 1];
+        clip_data.channels[i].scale_track_ = tracks[i * 3 + 2];
+    }
+    clip_data.first_uniform_key = block.info.first_uniform_key;
+    if (AreTracksInKeyBuffer(clip_data) == false)
+    {
+        throw string("Corrupt clip block of ") + clip_data.name + " in " + path_;
+    }
+    return std::make_unique<Animation>(std::move(clip_data));
+}
+
+void ClipStreamer::MakeResident(Block& block, std::unique_ptr<Animation> p_keys) {
+    block.p_owner = std::move(p_keys);
+    block.p_resident.store(block.p_owner.get(), std::memory_order_release);
+    resident_.push_back(&block);
+    resident_bytes_ += block.info.size;
+    loads_++;
+}
+
+void ClipStreamer::Evict(Block& block) {
+    block.p_resident.store(nullptr, std::memory_order_relaxed);
+    block.p_owner.reset();
+    block.requested.store(false, std::memory_order_relaxed);
+    resident_bytes_ -= block.info.size;
+    evictions_++;
+}
+
+void ClipStreamer::IoLoop() {
+    while (true)
+    {
+        std::pair<const ClipStream*, Block*> request;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this]() { return stop_ || requests_.empty() == false; });
+            if (stop_)
+            {
+                return;
+            }
+            request = requests_.front();
+            requests_.pop_front();
+        }
+
+        try
+        {
+            std::unique_ptr<Animation> p_keys = ReadBlock(*request.first, *request.second);
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            loaded_.push_back({ request.second, std::move(p_keys) });
+        }
+        catch (string error_message)
+        {
+            // misses keep falling back meanwhile, clearing requested lets the next sample of the block queue it again
+            failed_loads_++;
+            Block& block = *request.second;
+            bool retry = ++block.failed_reads < kMaxBlockReads;
+            std::cout << "Warning: " << error_message << (retry ? ", retried on the next sample" : ", not read again") << std::endl;
+            if (retry)
+            {
+                block.requested.store(false, std::memory_order_relaxed);
+            }
+        }
+    }
+}
@@ -0,0 +1,151 @@
+#ifndef CLIP_STREAMER_H
+#define CLIP_STREAMER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using std::string;
+using std::vector;
+
+#include "animation.h"
+
+// where one block of a streamed clip lies in the baked file
+struct ClipBlockInfo
+{
+    float begin_tick = 0.0f;
+    float end_tick = 0.0f;
+    // uniform clips only, see AnimationClipData::first_uniform_key
+    int first_uniform_key = 0;
+    uint64_t file_offset = 0;
+    uint64_t size = 0;
+};
+
+struct ClipStreamStats
+{
+    // one per sampled clip and character, a miss is served from the block that character sampled last
+    long long hits = 0;
+    long long misses = 0;
+    long long loads = 0;
+    long long evictions = 0;
+    // block reads that failed, each is retried by a later sample up to ClipStreamer::kMaxBlockReads times
+    long long failed_loads = 0;
+    int resident_blocks = 0;
+    size_t resident_bytes = 0;
+};
+
+class ClipStreamer;
+
+// the blocks of one streamed clip, sampling threads only read it
+class ClipStream
+{
+public:
+    // block covering normalized_time if it is resident, else the one cursor sampled last time,
+    // else the first block, which is always resident, queues loads and never waits for one
+    const Animation& GetKeys(float normalized_time, AnimationCursor& cursor) const;
+
+private:
+    friend class ClipStreamer;
+
+    struct Block
+    {
+        ClipBlockInfo info;
+        // published by ClipStreamer::Update, samplers only load it
+        std::atomic<const Animation*> p_resident{ nullptr };
+        std::unique_ptr<Animation> p_owner;
+        std::atomic<long long> last_used_frame{ 0 };
+        std::atomic<bool> requested{ false };
+        // IO thread only
+        int failed_reads = 0;
+        bool pinned = false;
+    };
+
+    ClipStreamer* p_streamer_ = nullptr;
+    const Animation* p_clip_ = nullptr;
+    float block_ticks_ = 1.0f;
+    vector<std::unique_ptr<Block>> blocks_;
+
+    int GetBlockIndex(float anim_tick) const;
+    void Touch(Block& block, long long frame) const;
+};
+
+// pages blocks of streamed clips in from a baked model file, keeping them under a byte budget
+// blocks are read on a thread of its own, sampling only queues them, so a frame never waits for the disk
+// least recently sampled blocks are dropped first, the first block of every clip stays resident
+class ClipStreamer
+{
+public:
+    static constexpr size_t kDefaultBudgetBytes = 16 * 1024 * 1024;
+    static constexpr float kDefaultPrefetchSec = 0.5f;
+    // a block that fails this many reads stays requested and is never read again, samples keep falling back
+    static constexpr int kMaxBlockReads = 3;
+
+    explicit ClipStreamer(const string& baked_path, size_t budget_bytes = kDefaultBudgetBytes, float prefetch_sec = kDefaultPrefetchSec);
+    ~ClipStreamer();
+    ClipStreamer(const ClipStreamer&) = delete;
+    ClipStreamer& operator=(const ClipStreamer&) = delete;
+
+    // keys of clip are sampled from these blocks from now on, its first block is read before this returns
+    void AddClip(Animation& clip, float block_ticks, const vector<ClipBlockInfo>& blocks);
+
+    // once per frame, never while poses are being evaluated: makes blocks read since the last call
+    // resident and drops least recently sampled ones until the budget is met
+    void Update();
+    // reads every block now, for tools comparing whole clips, the budget applies again from the next Update
+    void LoadAll();
+
+    void SetBudget(size_t budget_bytes);
+    size_t GetBudget() const;
+    // blocks playback reaches within this time are queued along with the sampled one
+    void SetPrefetchTime(float prefetch_sec);
+    ClipStreamStats GetStats() const;
+
+private:
+    friend class ClipStream;
+    using Block = ClipStream::Block;
+
+    string path_;
+    std::ifstream file_;
+    std::mutex file_mutex_;
+
+    vector<std::unique_ptr<ClipStream>> streams_;
+    // blocks with a p_owner, main thread only
+    vector<Block*> resident_;
+    size_t resident_bytes_ = 0;
+    size_t budget_bytes_;
+    std::atomic<float> prefetch_sec_;
+    std::atomic<long long> frame_{ 1 };
+
+    std::atomic<long long> hits_{ 0 };
+    std::atomic<long long> misses_{ 0 };
+    long long loads_ = 0;
+    long long evictions_ = 0;
+    std::atomic<long long> failed_loads_{ 0 };
+
+    // queued by samplers, read by the IO thread, published by Update
+    struct LoadedBlock
+    {
+        Block* p_block;
+        std::unique_ptr<Animation> p_keys;
+    };
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<std::pair<const ClipStream*, Block*>> requests_;
+    vector<LoadedBlock> loaded_;
+    bool stop_ = false;
+    std::thread io_thread_;
+
+    void Request(const ClipStream& stream, Block& block);
+    std::unique_ptr<Animation> ReadBlock(const ClipStream& stream, const Block& block);
+    void MakeResident(Block& block, std::unique_ptr<Animation> p_keys);
+    void Evict(Block& block);
+    void IoLoop();
+};
+
+#endif
@@ -0,0 +1,220 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "crowd_benchmark.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include "crowd_renderer.h"
+#include "model.h"
+#include "shader.h"
+#include "utility/job_system.h"
+
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr float kFrameDeltaSec = 1.0f / 60.0f;
+// untimed frames first, they size the pose scratch and fill every region of the palette ring
+constexpr int kWarmupFrames = 10;
+constexpr float kVatFrameRate = 30.0f;
+
+
+static const char* GetEncodingName(EPaletteEncoding encoding) {
+    switch (encoding)
+    {
+    case EPaletteEncoding::eMat4: return "mat4";
+    case EPaletteEncoding::eAffine3x4: return "affine3x4";
+    case EPaletteEncoding::eDualQuat: return "dualquat";
+    }
+    return "";
+}
+
+static const char* GetVatName(const CrowdBenchmarkOption& option) {
+    if (option.use_vat == false)
+    {
+        return "none";
+    }
+    bool half = option.vat_precision == EVatPrecision::eHalf;
+    if (option.vat_content == EVatContent::eBonePalette)
+    {
+        return half ? "palette-half" : "palette";
+    }
+    return half ? "vertices-half" : "vertices";
+}
+
+static double ElapsedMs(Clock::time_point begin, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+// distance of the farthest bind pose vertex from the origin, with the root transform the palettes include
+static float GetBindPoseRadius(const ModelData& model_data) {
+    const mat4& root = model_data.GetCharacterAsset().root_transform;
+    float radius = 1e-3f;
+    for (size_t i = 0; i < model_data.GetVertexCount(); i++)
+    {
+        radius = std::max(radius, glm::length(vec3(root * glm::vec4(model_data.GetVertexData()[i].position, 1.0f))));
+    }
+    return radius;
+}
+
+
+bool ParseCrowdBenchmarkOption(int argc, char** argv, CrowdBenchmarkOption& option) {
+    bool found = false;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string key = argv[i];
+        string value = argv[i + 1];
+        if (key == "--crowd")
+        {
+            option.num_instances = std::max(1, std::atoi(value.c_str()));
+            found = true;
+        }
+        else if (key == "--frames")
+        {
+            option.num_frames = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (key == "--model")
+        {
+            option.model_path = value;
+        }
+        else if (key == "--threads")
+        {
+            option.num_threads = std::max(0, std::atoi(value.c_str()));
+        }
+        else if (key == "--encoding")
+        {
+            for (EPaletteEncoding encoding : { EPaletteEncoding::eMat4, EPaletteEncoding::eAffine3x4, EPaletteEncoding::eDualQuat })
+            {
+                if (value == GetEncodingName(encoding))
+                {
+                    option.palette_encoding = encoding;
+                }
+            }
+        }
+        else if (key == "--vat")
+        {
+            option.use_vat = true;
+            option.vat_content = value.find("vertices") == 0 ? EVatContent::eSkinnedVertices : EVatContent::eBonePalette;
+            option.vat_precision = value.find("-half") != string::npos ? EVatPrecision::eHalf : EVatPrecision::eFloat;
+        }
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", key.c_str());
+        }
+    }
+    return found;
+}
+
+int RunCrowdBenchmark(GLFWwindow* window, const CrowdBenchmarkOption& option) {
+    try
+    {
+        auto p_model_data = std::make_shared<const ModelData>(option.model_path);
+        if (p_model_data->HaveAnimation() == false)
+        {
+            throw string("no skeleton or animation");
+        }
+        float radius = GetBindPoseRadius(*p_model_data);
+
+        ModelUploadOption upload_option;
+        upload_option.vertex_format = option.vertex_format;
+        upload_option.merge_meshes = option.merge_meshes;
+        Model model(p_model_data, EModelUpload::eImmediate, upload_option);
+        Shader shader("lighting.vs", "lighting.fs");
+        shader.use();
+        CrowdRenderer crowd(model, option.num_instances, option.palette_encoding);
+
+        // square grid on the xz plane, members are out of step so they don't share keys
+        int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(option.num_instances))));
+        float spacing = radius * 2.0f;
+        int num_clips = static_cast<int>(p_model_data->GetAnimations().size());
+        for (int i = 0; i < option.num_instances; i++)
+        {
+            vec3 position(((i % side) - (side - 1) * 0.5f) * spacing, 0.0f, ((i / side) - (side - 1) * 0.5f) * spacing);
+            crowd.SetTransform(i, glm::translate(mat4(1.0f), position));
+            crowd.GetInstance(i).PlaySingle(i % num_clips);
+            crowd.SetTimeOffset(i, i * 0.37f);
+        }
+        size_t vat_bytes = 0;
+        if (option.use_vat)
+        {
+            const CharacterAsset& asset = p_model_data->GetCharacterAsset();
+            VertexAnimationTexture vat = BakeVertexAnimationTexture(*asset.p_skeleton, *p_model_data->GetAnimations()[0],
+                asset.root_transform, p_model_data->GetVertexData(), p_model_data->GetVertexCount(),
+                option.vat_content, option.vat_precision, kVatFrameRate);
+            crowd.UseVertexAnimationTexture(vat);
+            vat_bytes = vat.GetMemorySize();
+        }
+
+        // the whole grid in view from above one side
+        int width = 0;
+        int height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        glViewport(0, 0, width, height);
+        float extent = side * spacing;
+        vec3 eye(0.0f, extent * 0.6f + radius, extent * 0.8f + radius * 4.0f);
+        mat4 projection = glm::perspective(glm::radians(45.0f), static_cast<float>(width) / std::max(height, 1),
+            radius * 0.1f, extent * 4.0f + radius * 10.0f);
+        shader.setMat4(shader.getUniformLocation("projection"), projection);
+        shader.setMat4(shader.getUniformLocation("view"), glm::lookAt(eye, vec3(0.0f), vec3(0.0f, 1.0f, 0.0f)));
+        shader.setVec3(shader.getUniformLocation("lightColor"), vec3(1.0f));
+        shader.setVec3(shader.getUniformLocation("lightPos"), eye);
+        shader.setVec3(shader.getUniformLocation("viewPos"), eye);
+
+        JobSystem job_system(option.num_threads);
+        // frames aren't held back to the display's refresh rate
+        glfwSwapInterval(0);
+
+        double update_ms = 0.0;
+        double draw_ms = 0.0;
+        double finish_ms = 0.0;
+        double frame_ms = 0.0;
+        for (int frame = -kWarmupFrames; frame < option.num_frames; frame++)
+        {
+            auto begin = Clock::now();
+            crowd.Update(kFrameDeltaSec, &job_system);
+            auto updated = Clock::now();
+
+            glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            crowd.Draw(shader);
+            auto submitted = Clock::now();
+            // the GPU's share of the frame, all of the rasterization on llvmpipe
+            glFinish();
+            auto finished = Clock::now();
+
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+            if (frame >= 0)
+            {
+                update_ms += ElapsedMs(begin, updated);
+                draw_ms += ElapsedMs(updated, submitted);
+                finish_ms += ElapsedMs(submitted, finished);
+                frame_ms += ElapsedMs(begin, Clock::now());
+            }
+        }
+
+        int num_frames = option.num_frames;
+        const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        printf("{\"benchmark\":\"crowd\",\"renderer\":\"%s\",\"model\":\"%s\",\"instances\":%d,\"bones\":%d,\"encoding\":\"%s\","
+            "\"draw_calls\":%d,\"threads\":%d,\"frames\":%d,\"update_ms\":%.3f,\"draw_ms\":%.3f,\"finish_ms\":%.3f,"
+            "\"frame_ms\":%.3f,\"fps\":%.1f,\"palette_stalls\":%d,\"vat\":\"%s\",\"vat_kb\":%.1f}\n",
+            renderer != nullptr ? renderer : "", option.model_path.c_str(), option.num_instances,
+            p_model_data->GetSkeleton()->GetBoneCount(), GetEncodingName(option.palette_encoding), crowd.GetDrawCallCount(),
+            job_system.GetThreadCount(), num_frames, update_ms / num_frames, draw_ms / num_frames, finish_ms / num_frames,
+            frame_ms / num_frames, num_frames * 1000.0 / frame_ms, crowd.GetPaletteRing().GetStallCount(),
+            GetVatName(option), vat_bytes / 1024.0);
+    }
+    catch (string error_message)
+    {
+        fprintf(stderr, "%s: %s\n", option.model_path.c_str(), error_message.c_str());
+        return 1;
+    }
+    return 0;
+}
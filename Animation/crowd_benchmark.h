@@ -0,0 +1,38 @@
+#ifndef CROWD_BENCHMARK_H
+#define CROWD_BENCHMARK_H
+
+#include <string>
+using std::string;
+
+#include "vertex.h"
+#include "vertex_animation_texture.h"
+#include "utility/skinning_palette.h"
+
+struct GLFWwindow;
+
+// Animation --crowd <instances> [--frames N] [--model path] [--threads N] [--encoding mat4|affine3x4|dualquat]
+//           [--vat palette|vertices|palette-half|vertices-half]
+// renders a grid of animated copies of the model with CrowdRenderer and prints one JSON line of frame times
+// with --vat the crowd plays the first clip from a vertex animation texture instead of being posed
+// needs no GPU, Mesa's llvmpipe runs it with LIBGL_ALWAYS_SOFTWARE=1
+struct CrowdBenchmarkOption
+{
+    int num_instances = 1024;
+    int num_frames = 300;
+    string model_path = "resource/bob/boblampclean.md5mesh";
+    // 0 is one per hardware thread
+    int num_threads = 0;
+    EPaletteEncoding palette_encoding = EPaletteEncoding::eDualQuat;
+    EVertexFormat vertex_format = EVertexFormat::ePacked;
+    bool merge_meshes = true;
+    bool use_vat = false;
+    EVatContent vat_content = EVatContent::eBonePalette;
+    EVatPrecision vat_precision = EVatPrecision::eFloat;
+};
+
+// false if the arguments don't ask for the crowd benchmark
+bool ParseCrowdBenchmarkOption(int argc, char** argv, CrowdBenchmarkOption& option);
+// returns the process exit code
+int RunCrowdBenchmark(GLFWwindow* window, const CrowdBenchmarkOption& option);
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef CROWD_RENDERER_H
+#define CROWD_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+using std::vector;
+
+#include "animated_instance.h"
+#include "bone_palette_ring.h"
+#include "model.h"
+#include "shader.h"
+#include "vertex_animation_texture.h"
+
+// binding point of the CrowdInstances storage block in lighting.vs
+constexpr GLuint kCrowdInstanceBinding = 1;
+// texture unit of vatTexture in lighting.vs, past the ones materials take
+constexpr int kVatTextureUnit = 15;
+// vatContent in lighting.vs
+constexpr int kVatNone = 0;
+constexpr int kVatBonePalette = 1;
+constexpr int kVatSkinnedVertices = 2;
+
+// one crowd member as lighting.vs reads it, std430 layout
+struct CrowdInstanceData
+{
+    mat4 model;
+    // columns of the normal matrix, std430 pads vec3 columns to vec4
+    glm::vec4 normal_matrix[3];
+    // first vec4 of the member's palette slice, see BonePaletteRing::GetSliceOffset
+    int palette_offset;
+    // added to the crowd's clock in vertex animation texture playback
+    float vat_time_offset;
+    int padding[2];
+};
+static_assert(sizeof(CrowdInstanceData) == 128, "CrowdInstanceData must match CrowdInstance in lighting.vs");
+
+// many animated copies of one model drawn together, each mesh or material takes one instanced draw for the whole crowd
+// members pose into their slices of a BonePaletteRing, the vertex shader finds its member's
+// transform and palette offset by gl_InstanceID, so no uniform changes between members
+// distant crowds can play a VertexAnimationTexture instead, then nothing is posed on the CPU at all
+class CrowdRenderer
+{
+public:
+    // the model must have a skeleton and clips
+    CrowdRenderer(const Model& model, int num_instances, EPaletteEncoding encoding)
+        : model_(model), group_(model_.GetCharacterAsset()),
+        palette_ring_(model_.GetCharacterAsset().p_skeleton->GetBoneCount(), num_instances, encoding) {
+        instance_data_.resize(num_instances);
+        for (int i = 0; i < num_instances; i++)
+        {
+            group_.AddInstance();
+            instance_data_[i].palette_offset = palette_ring_.GetSliceOffset(i);
+            instance_data_[i].vat_time_offset = 0.0f;
+            SetTransform(i, mat4(1.0f));
+        }
+
+        glGenBuffers(1, &instance_buffer_);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance_buffer_);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, instance_data_.size() * sizeof(CrowdInstanceData), instance_data_.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        instances_dirty_ = false;
+    }
+
+    int GetInstanceCount() const {
+        return group_.GetInstanceCount();
+    }
+
+    // playback of a member, its transform goes through SetTransform
+    AnimatedInstance& GetInstance(int index) {
+        return group_.GetInstance(index);
+    }
+
+    void SetTransform(int index, const mat4& model_mat) {
+        group_.GetInstance(index).SetTransform(model_mat);
+        CrowdInstanceData& data = instance_data_[index];
+        data.model = model_mat;
+        glm::mat3 normal_mat = glm::transpose(glm::inverse(glm::mat3(model_mat)));
+        for (int c = 0; c < 3; c++)
+        {
+            data.normal_matrix[c] = glm::vec4(normal_mat[c], 0.0f);
+        }
+        instances_dirty_ = true;
+    }
+
+    // where a member is in its clip, it's also the member's offset into a vertex animation texture's clip
+    void SetTimeOffset(int index, float time_sec) {
+        group_.GetInstance(index).SetTime(time_sec);
+        instance_data_[index].vat_time_offset = time_sec;
+        instances_dirty_ = true;
+    }
+
+    // from now on every member plays vat's clip from the texture, each from its SetTimeOffset
+    // eSkinnedVertices textures need a model drawn from merged meshes, see Model::HasMergedMeshes
+    void UseVertexAnimationTexture(const VertexAnimationTexture& vat) {
+        if (vat.content == EVatContent::eSkinnedVertices && model_.HasMergedMeshes() == false)
+        {
+            throw std::string("Skinned vertex animation textures need merged meshes");
+        }
+        // baking keeps to the GL 4.3 minimum, a driver may still report less
+        GLint max_size = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+        if (vat.width > max_size || vat.GetHeight() > max_size)
+        {
+            throw std::string("Vertex animation texture of ") + std::to_string(vat.width) + "x" + std::to_string(vat.GetHeight())
+                + " texels is larger than GL_MAX_TEXTURE_SIZE " + std::to_string(max_size);
+        }
+        if (vat_texture_ == 0)
+        {
+            glGenTextures(1, &vat_texture_);
+        }
+        glBindTexture(GL_TEXTURE_2D, vat_texture_);
+        glTexImage2D(GL_TEXTURE_2D, 0, vat.precision == EVatPrecision::eHalf ? GL_RGBA16F : GL_RGBA32F, vat.width, vat.GetHeight(),
+            0, GL_RGBA, GL_FLOAT, vat.texels.data());
+        // texelFetch only, frames are blended in the shader
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        vat_content_ = vat.content == EVatContent::eBonePalette ? kVatBonePalette : kVatSkinnedVertices;
+        vat_width_ = vat.width;
+        vat_rows_per_frame_ = vat.rows_per_frame;
+        vat_frame_count_ = vat.num_frames;
+        vat_frame_rate_ = vat.frame_rate;
+        vat_time_ = 0.0f;
+    }
+
+    bool IsPlayingVertexAnimationTexture() const {
+        return vat_content_ != kVatNone;
+    }
+
+    // poses every member straight into this frame's palette region, or only advances the clock of a vertex animation texture
+    void Update(float delta_sec, JobSystem* job_system = nullptr) {
+        if (IsPlayingVertexAnimationTexture())
+        {
+            vat_time_ += delta_sec;
+            return;
+        }
+        model_.UpdateClipStreaming();
+        palette_ring_.BeginFrame();
+        for (int i = 0; i < group_.GetInstanceCount(); i++)
+        {
+            group_.GetInstance(i).SetPaletteTarget(palette_ring_.GetSlice(i), palette_ring_.GetEncoding());
+        }
+        group_.UpdateAll(delta_sec, job_system);
+    }
+
+    // view, projection and light uniforms are the caller's
+    void Draw(const Shader& shader) {
+        if (instances_dirty_)
+        {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance_buffer_);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instance_data_.size() * sizeof(CrowdInstanceData), instance_data_.data());
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            instances_dirty_ = false;
+        }
+        if (program_ != shader.ID)
+        {
+            instanced_location_ = shader.getUniformLocation("instanced");
+            palette_encoding_location_ = shader.getUniformLocation("paletteEncoding");
+            vat_locations_.content = shader.getUniformLocation("vatContent");
+            vat_locations_.texture = shader.getUniformLocation("vatTexture");
+            vat_locations_.width = shader.getUniformLocation("vatWidth");
+            vat_locations_.rows_per_frame = shader.getUniformLocation("vatRowsPerFrame");
+            vat_locations_.frame_count = shader.getUniformLocation("vatFrameCount");
+            vat_locations_.frame_rate = shader.getUniformLocation("vatFrameRate");
+            vat_locations_.time = shader.getUniformLocation("vatTime");
+            program_ = shader.ID;
+        }
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCrowdInstanceBinding, instance_buffer_);
+        shader.setBool(instanced_location_, true);
+        if (IsPlayingVertexAnimationTexture())
+        {
+            glActiveTexture(GL_TEXTURE0 + kVatTextureUnit);
+            glBindTexture(GL_TEXTURE_2D, vat_texture_);
+            glActiveTexture(GL_TEXTURE0);
+            shader.setInt(vat_locations_.texture, kVatTextureUnit);
+            shader.setInt(vat_locations_.width, vat_width_);
+            shader.setInt(vat_locations_.rows_per_frame, vat_rows_per_frame_);
+            shader.setInt(vat_locations_.frame_count, vat_frame_count_);
+            shader.setFloat(vat_locations_.frame_rate, vat_frame_rate_);
+            shader.setFloat(vat_locations_.time, vat_time_);
+            shader.setInt(vat_locations_.content, vat_content_);
+            model_.DrawInstanced(shader, group_.GetInstanceCount());
+            shader.setInt(vat_locations_.content, kVatNone);
+        }
+        else
+        {
+            palette_ring_.BindRegion();
+            shader.setInt(palette_encoding_location_, static_cast<int>(palette_ring_.GetEncoding()));
+            model_.DrawInstanced(shader, group_.GetInstanceCount());
+            palette_ring_.FenceFrame();
+        }
+        shader.setBool(instanced_location_, false);
+    }
+
+    int GetDrawCallCount() const {
+        return model_.GetDrawCallCount();
+    }
+
+    const BonePaletteRing& GetPaletteRing() const {
+        return palette_ring_;
+    }
+
+private:
+    struct VatLocations
+    {
+        int content = -1;
+        int texture = -1;
+        int width = -1;
+        int rows_per_frame = -1;
+        int frame_count = -1;
+        int frame_rate = -1;
+        int time = -1;
+    };
+
+    Model model_;
+    AnimatedInstanceGroup group_;
+    BonePaletteRing palette_ring_;
+
+    vector<CrowdInstanceData> instance_data_;
+    unsigned int instance_buffer_ = 0;
+    bool instances_dirty_ = true;
+
+    // locations in program_
+    unsigned int program_ = 0;
+    int instanced_location_ = -1;
+    int palette_encoding_location_ = -1;
+    VatLocations vat_locations_;
+
+    unsigned int vat_texture_ = 0;
+    int vat_content_ = kVatNone;
+    int vat_width_ = 0;
+    int vat_rows_per_frame_ = 0;
+    int vat_frame_count_ = 0;
+    float vat_frame_rate_ = 0.0f;
+    float vat_time_ = 0.0f;
+};
+
+#endif
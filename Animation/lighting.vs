@@ -1,7 +1,9 @@
-#version 330 core
+#version 430 core
 layout (location = 0) in vec3 aPos;
+// octahedral (x, y, 0) for packed vertices
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// kPackedNoBone instead of -1 for unused slots of packed vertices
 layout (location = 5) in ivec4 aBoneIDs;
 layout (location = 6) in vec4 aWeights;
 
@@ -13,26 +15,222 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
-const int kMaxTotalBoneNums = 100;
-uniform mat4 bones[kMaxTotalBoneNums];
+// once per instance on the CPU, transpose(inverse(mat3(model)))
+uniform mat3 normalMatrix;
 
-void main()
+// the instance's slice of BonePaletteRing, one bone per entry of the skeleton, in EPaletteEncoding
+layout(std430, binding = 0) readonly buffer BonePalette
+{
+    vec4 palette[];
+};
+uniform int paletteEncoding;
+const int kPaletteMat4 = 0;
+const int kPaletteAffine3x4 = 1;
+const int kPaletteDualQuat = 2;
+
+// set while CrowdRenderer draws, each instance is a crowd member with its own transform and palette slice
+uniform bool instanced;
+// CrowdInstanceData in crowd_renderer.h
+struct CrowdInstance
+{
+    mat4 model;
+    vec4 normalMatrix[3];
+    int paletteOffset;
+    float vatTimeOffset;
+    ivec2 padding;
+};
+layout(std430, binding = 1) readonly buffer CrowdInstances
+{
+    CrowdInstance crowd[];
+};
+// first vec4 of the palette being skinned with, 0 when a single slice is bound
+int paletteBase = 0;
+
+// clip baked by BakeVertexAnimationTexture, played instead of the palette when vatContent isn't kVatNone
+// texel k of a frame is at (k % vatWidth, frame * vatRowsPerFrame + k / vatWidth)
+uniform int vatContent;
+const int kVatNone = 0;
+const int kVatBonePalette = 1;
+const int kVatSkinnedVertices = 2;
+uniform sampler2D vatTexture;
+uniform int vatWidth;
+uniform int vatRowsPerFrame;
+uniform int vatFrameCount;
+uniform float vatFrameRate;
+uniform float vatTime;
+
+// set per mesh, see EVertexFormat
+uniform bool packedVertices;
+const int kPackedNoBone = 255;
+
+// inverse of OctahedralEncode in utility/vertex_packing.cpp
+vec3 OctDecode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+int GetBoneID(int i)
+{
+    return packedVertices && aBoneIDs[i] == kPackedNoBone ? -1 : aBoneIDs[i];
+}
+
+mat4 GetBoneMatrix(int bone)
+{
+    if(paletteEncoding == kPaletteAffine3x4)
+    {
+        // rows, the last one is always (0, 0, 0, 1)
+        int i = paletteBase + bone * 3;
+        return transpose(mat4(palette[i], palette[i + 1], palette[i + 2], vec4(0.0, 0.0, 0.0, 1.0)));
+    }
+    int i = paletteBase + bone * 4;
+    return mat4(palette[i], palette[i + 1], palette[i + 2], palette[i + 3]);
+}
+
+// linear blend of eMat4 or eAffine3x4 bones
+void SkinLinear(inout vec3 position, inout vec3 normal)
 {
     mat4 totalBoneTransform = mat4(0.0f);
-    vec4 totalPosition = vec4(0.0f);
+    for(int i = 0 ; i < 4 ; i++)
+    {
+        int boneID = GetBoneID(i);
+        if(boneID == -1)
+            continue;
+
+        totalBoneTransform += GetBoneMatrix(boneID) * aWeights[i];
+    }
+    position = (totalBoneTransform * vec4(position, 1.0f)).xyz;
+    normal = mat3(totalBoneTransform) * normal;
+}
 
+// q is (x, y, z, w), same as QuatRotate in utility/skinning_palette.cpp
+vec3 QuatRotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// dual quaternion linear blending of eDualQuat bones, see SkinPosition in utility/skinning_palette.cpp
+void SkinDualQuat(inout vec3 position, inout vec3 normal)
+{
+    vec4 blendReal = vec4(0.0);
+    vec4 blendDual = vec4(0.0);
+    vec4 firstReal = vec4(0.0);
+    float scale = 0.0;
+    float weightSum = 0.0;
     for(int i = 0 ; i < 4 ; i++)
     {
-        if(aBoneIDs[i] == -1)
+        int boneID = GetBoneID(i);
+        if(boneID == -1)
             continue;
 
-        totalBoneTransform += bones[aBoneIDs[i]] * aWeights[i];
+        // the length of the real part is the bone's uniform scale
+        vec4 boneReal = palette[paletteBase + boneID * 2];
+        vec4 boneDual = palette[paletteBase + boneID * 2 + 1];
+        float boneScale = length(boneReal);
+        boneReal /= boneScale;
+        boneDual /= boneScale;
+        if(i == 0)
+            firstReal = boneReal;
+
+        // q and -q are the same rotation, blend along the shorter arc
+        float weight = dot(boneReal, firstReal) < 0.0 ? -aWeights[i] : aWeights[i];
+        blendReal += boneReal * weight;
+        blendDual += boneDual * weight;
+        scale += boneScale * aWeights[i];
+        weightSum += aWeights[i];
     }
+    float len = length(blendReal);
+    blendReal /= len;
+    blendDual /= len;
+    vec3 translation = 2.0 * (blendReal.w * blendDual.xyz - blendDual.w * blendReal.xyz + cross(blendReal.xyz, blendDual.xyz));
+    position = (QuatRotate(blendReal, position) + translation) * (scale / max(weightSum, 1e-6));
+    normal = QuatRotate(blendReal, normal);
+}
+
+vec4 FetchVat(int frame, int texel)
+{
+    return texelFetch(vatTexture, ivec2(texel % vatWidth, frame * vatRowsPerFrame + texel / vatWidth), 0);
+}
 
-    totalPosition = totalBoneTransform *  vec4(aPos,1.0f);
+// texel of the clip at time, blended between the two frames around it
+vec4 SampleVat(int frame0, int frame1, float blend, int texel)
+{
+    return mix(FetchVat(frame0, texel), FetchVat(frame1, texel), blend);
+}
+
+// linear blend of baked eAffine3x4 bones, as SkinLinear
+void SkinVatPalette(int frame0, int frame1, float blend, inout vec3 position, inout vec3 normal)
+{
+    mat4 totalBoneTransform = mat4(0.0f);
+    for(int i = 0 ; i < 4 ; i++)
+    {
+        int boneID = GetBoneID(i);
+        if(boneID == -1)
+            continue;
+
+        int texel = boneID * 3;
+        mat4 bone = transpose(mat4(SampleVat(frame0, frame1, blend, texel), SampleVat(frame0, frame1, blend, texel + 1),
+            SampleVat(frame0, frame1, blend, texel + 2), vec4(0.0, 0.0, 0.0, 1.0)));
+        totalBoneTransform += bone * aWeights[i];
+    }
+    position = (totalBoneTransform * vec4(position, 1.0f)).xyz;
+    normal = mat3(totalBoneTransform) * normal;
+}
+
+// the clip loops, the frame after the last is the first
+void PlayVat(float time, inout vec3 position, inout vec3 normal)
+{
+    float frame = mod(time * vatFrameRate, float(vatFrameCount));
+    int frame0 = min(int(frame), vatFrameCount - 1);
+    int frame1 = (frame0 + 1) % vatFrameCount;
+    float blend = frame - float(frame0);
+    if(vatContent == kVatSkinnedVertices)
+    {
+        // gl_VertexID includes the base vertex, so it indexes the model's vertices in merged meshes
+        position = SampleVat(frame0, frame1, blend, gl_VertexID * 2).xyz;
+        normal = SampleVat(frame0, frame1, blend, gl_VertexID * 2 + 1).xyz;
+    }
+    else if(GetBoneID(0) != -1)
+    {
+        SkinVatPalette(frame0, frame1, blend, position, normal);
+    }
+}
+
+void main()
+{
+    mat4 modelMatrix = model;
+    mat3 normalMat = normalMatrix;
+    float vatOffset = 0.0;
+    if(instanced)
+    {
+        CrowdInstance member = crowd[gl_InstanceID];
+        modelMatrix = member.model;
+        normalMat = mat3(member.normalMatrix[0].xyz, member.normalMatrix[1].xyz, member.normalMatrix[2].xyz);
+        paletteBase = member.paletteOffset;
+        vatOffset = member.vatTimeOffset;
+    }
+
+    vec3 position = aPos;
+    vec3 normal = packedVertices ? OctDecode(aNormal.xy) : aNormal;
+
+    if(vatContent != kVatNone)
+    {
+        PlayVat(vatTime + vatOffset, position, normal);
+    }
+    // vertices without bones, e.g. of the loading placeholder, stay as they are
+    else if(GetBoneID(0) != -1)
+    {
+        if(paletteEncoding == kPaletteDualQuat)
+            SkinDualQuat(position, normal);
+        else
+            SkinLinear(position, normal);
+    }
 
-    FragPos = vec3(model * totalPosition);
-    Normal = (transpose(inverse(model)) * totalBoneTransform * vec4(aNormal, 0.0)).xyz;
+    FragPos = vec3(modelMatrix * vec4(position, 1.0f));
+    Normal = normalMat * normal;
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model * totalPosition;
+    gl_Position = projection * view * vec4(FragPos, 1.0f);
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include"local_pose.h"
+
+
+void LocalPose::Resize(int num_bones) {
+	translations.resize(num_bones);
+	rotations.resize(num_bones);
+	scales.resize(num_bones);
+}
+
+int LocalPose::GetBoneCount() const {
+	return translations.size();
+}
+
+
+void BlendLocalPose(const LocalPose& pose1, const LocalPose& pose2, float weight, LocalPose& result, ERotationBlend rotation_blend) {
+	int num_bones = pose1.GetBoneCount();
+	result.Resize(num_bones);
+
+	for (int i = 0; i < num_bones; i++)
+	{
+		result.translations[i] = pose1.translations[i] + (pose2.translations[i] - pose1.translations[i]) * weight;
+	}
+	for (int i = 0; i < num_bones; i++)
+	{
+		result.scales[i] = pose1.scales[i] + (pose2.scales[i] - pose1.scales[i]) * weight;
+	}
+
+	if (rotation_blend == ERotationBlend::eSlerp)
+	{
+		for (int i = 0; i < num_bones; i++)
+		{
+			result.rotations[i] = glm::slerp(pose1.rotations[i], pose2.rotations[i], weight);
+		}
+		return;
+	}
+
+	for (int i = 0; i < num_bones; i++)
+	{
+		const quat& q1 = pose1.rotations[i];
+		const quat& q2 = pose2.rotations[i];
+		// q and -q are the same rotation, flip q2 into q1's hemisphere so the blend takes the short arc
+		float sign = glm::dot(q1, q2) < 0.0f ? -1.0f : 1.0f;
+		quat q = q1 * (1.0f - weight) + q2 * (weight * sign);
+		result.rotations[i] = q * (1.0f / glm::length(q));
+	}
+}
@@ -0,0 +1,34 @@
+#ifndef LOCAL_POSE_H
+#define LOCAL_POSE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+using glm::quat;
+using glm::vec3;
+
+#include <vector>
+using std::vector;
+
+enum class ERotationBlend
+{
+	eNlerp,	// normalized lerp along the shortest arc, cheap and fine for nearby poses
+	eSlerp	// constant angular velocity, costs trigonometry per bone
+};
+
+// local space transform of every bone, indexed by bone index
+// clips sample into it, blends work on it, the hierarchy is composed from it once
+struct LocalPose
+{
+	vector<vec3> translations;
+	vector<quat> rotations;
+	vector<float> scales;
+
+	void Resize(int num_bones);
+	int GetBoneCount() const;
+};
+
+// result = pose1 * (1 - weight) + pose2 * weight, result may alias pose1 or pose2
+void BlendLocalPose(const LocalPose& pose1, const LocalPose& pose2, float weight, LocalPose& result,
+	ERotationBlend rotation_blend = ERotationBlend::eNlerp);
+
+#endif
@@ -10,29 +10,74 @@
 #include <imgui/imgui_impl_glfw.h>
 
 #include <iostream>
+#ifdef COUNT_DRAW_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#endif
 
 #include "input_process.h"
 #include "ui_manager.h"
 #include "anim_ui_window.h"
+#include "model_loader.h"
+#include "crowd_benchmark.h"
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// GL upload time per frame while a model is loading
+const float kUploadBudgetMs = 4.0f;
+// decoded textures and their mips, reused by later runs, AssetBaker --clean-image-cache empties it
+const char kImageCacheDirectory[] = "cache/images";
+// 32 bytes per vertex instead of 88, lighting.vs decodes it
+const EVertexFormat kVertexFormat = EVertexFormat::ePacked;
+// all meshes in one vertex and index buffer, one multi-draw per material
+const bool kMergeMeshes = true;
+// 48 bytes per bone instead of 64, skins exactly as eMat4 does
+// eDualQuat blends multi bone vertices differently, it's opt in
+const EPaletteEncoding kPaletteEncoding = EPaletteEncoding::eAffine3x4;
 
 float delta_time;
 float last_frame;
 
+#ifdef COUNT_DRAW_ALLOCATIONS
+// every heap allocation of the process goes through here, so MainLoop can check the draw path makes none
+// only in builds that define COUNT_DRAW_ALLOCATIONS, it replaces the allocator of the whole process
+static std::atomic<long long> g_num_allocations{ 0 };
+
+void* operator new(size_t size) {
+    g_num_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size > 0 ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+#endif
+
 GLFWwindow* Init();
 void SetGLState();
+void LoadingLoop(GLFWwindow*, ModelLoader&, RenderScene&);
 void MainLoop(GLFWwindow*, RenderScene&, UIManager&);
 void ShowFPS(GLFWwindow*);
 void PlayAnimation(RenderScene&);
 void Render(const RenderScene&);
+#ifdef COUNT_DRAW_ALLOCATIONS
+void ReportDrawAllocations(long long);
+#endif
 
 // used to be accessed by glfw callback functions
 RenderScene* p_render_scene = nullptr;
 
-int main()
+int main(int argc, char** argv)
 {
     GLFWwindow* window = nullptr;
     try
@@ -46,8 +91,45 @@ int main()
         return -1;
     }
 
-    p_render_scene = new RenderScene(Model("resource/T-Rex.glb"), Shader("lighting.vs", "lighting.fs"), 
-        RenderVolume(45.0f, SCR_WIDTH, SCR_HEIGHT, 0.1f, 1000.0f), Camera(glm::vec3(0.0f, 0.0f, 20.0f)));
+    ImageDiskCache::Get().SetDirectory(kImageCacheDirectory);
+
+    CrowdBenchmarkOption crowd_option;
+    if (ParseCrowdBenchmarkOption(argc, argv, crowd_option))
+    {
+        int exit_code = RunCrowdBenchmark(window, crowd_option);
+        glfwTerminate();
+        return exit_code;
+    }
+
+    // the model imports on a background thread, a placeholder is rendered until it is uploaded
+    ModelUploadOption upload_option;
+    upload_option.vertex_format = kVertexFormat;
+    upload_option.merge_meshes = kMergeMeshes;
+    ModelLoader model_loader("resource/T-Rex.glb", {}, upload_option);
+    RenderVolume render_volume(45.0f, SCR_WIDTH, SCR_HEIGHT, 0.1f, 1000.0f);
+    p_render_scene = new RenderScene(Model(CreatePlaceholderModelData()), Shader("lighting.vs", "lighting.fs"), 
+        render_volume, Camera(glm::vec3(0.0f, 0.0f, 20.0f)));
+
+    try
+    {
+        LoadingLoop(window, model_loader, *p_render_scene);
+    }
+    catch (string error_message)
+    {
+        std::cout << "Model Load Failed: " << error_message << std::endl;
+        delete p_render_scene;
+        glfwTerminate();
+        return -1;
+    }
+
+    if (model_loader.IsLoaded())
+    {
+        // keep the camera the user may have moved while loading
+        RenderScene* p_placeholder_scene = p_render_scene;
+        p_render_scene = new RenderScene(model_loader.GetModel(), p_placeholder_scene->shader_, render_volume,
+            p_placeholder_scene->camera_, p_placeholder_scene->light_, kPaletteEncoding);
+        delete p_placeholder_scene;
+    }
     p_render_scene->SetTransform(vec3(0.0f, 0.0f, 0.0f), 45.0f, vec3(0.0f, 1.0f, 0.0f), vec3(1.0f, 1.0f, 1.0f));
     
     UIManager ui_manager(window);
@@ -70,7 +152,13 @@ void MainLoop(GLFWwindow* window, RenderScene& render_scene, UIManager& ui_manag
 
         ui_manager.RenderWindows(render_scene.render_parameter_);
         PlayAnimation(render_scene);
+#ifdef COUNT_DRAW_ALLOCATIONS
+        long long allocations_before = g_num_allocations.load();
+        Render(render_scene);
+        ReportDrawAllocations(g_num_allocations.load() - allocations_before);
+#else
         Render(render_scene);
+#endif
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
         glfwSwapBuffers(window);
@@ -78,6 +166,24 @@ void MainLoop(GLFWwindow* window, RenderScene& render_scene, UIManager& ui_manag
     }
 }
 
+void LoadingLoop(GLFWwindow* window, ModelLoader& model_loader, RenderScene& placeholder_scene) {
+    while (!glfwWindowShouldClose(window) && model_loader.IsLoaded() == false)
+    {
+        ShowFPS(window);
+
+        ProcessInput(window);
+
+        model_loader.Update(kUploadBudgetMs);
+
+        // spinning shows the app is alive
+        placeholder_scene.SetTransform(vec3(0.0f, 0.0f, 0.0f), static_cast<float>(glfwGetTime()) * 90.0f, vec3(0.0f, 1.0f, 0.0f), vec3(1.0f, 1.0f, 1.0f));
+        Render(placeholder_scene);
+
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+}
+
 void PlayAnimation(RenderScene& render_scene) {
     render_scene.CalculateModelAnimationPose();
 }
@@ -89,6 +195,18 @@ void Render(const RenderScene& render_scene) {
     render_scene.Draw();
 }
 
+#ifdef COUNT_DRAW_ALLOCATIONS
+// the draw path is meant to make no heap allocation, prints whenever a frame's count changes
+void ReportDrawAllocations(long long num_allocations) {
+    static long long last_num_allocations = 0;
+    if (num_allocations != last_num_allocations)
+    {
+        std::cout << "draw made " << num_allocations << " heap allocations this frame" << std::endl;
+        last_num_allocations = num_allocations;
+    }
+}
+#endif
+
 GLFWwindow*  Init() {
     if (glfwInit() == false)
     {
@@ -0,0 +1,243 @@
+#ifndef MERGED_MESH_H
+#define MERGED_MESH_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+// GL's layout of one indirect draw
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+// all meshes of a model in one vertex and one index buffer, indices stay relative to their mesh's first vertex
+// meshes sharing textures are drawn by one multi-draw, from an indirect buffer where the context is GL 4.3
+class MergedMesh
+{
+public:
+    // allocates the buffers, UploadSubmesh fills them one mesh at a time
+    // short_indices requires every mesh to have at most kMaxShortIndexVertices vertices
+    MergedMesh(size_t num_vertices, size_t num_indices, bool short_indices, EVertexFormat vertex_format) {
+        num_vertices_ = num_vertices;
+        num_indices_ = num_indices;
+        index_type_ = short_indices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        vertex_format_ = vertex_format;
+        use_indirect_ = GLAD_GL_VERSION_4_3 != 0;
+
+        glGenVertexArrays(1, &VAO_);
+        glGenBuffers(1, &VBO_);
+        glGenBuffers(1, &EBO_);
+
+        glBindVertexArray(VAO_);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+        glBufferData(GL_ARRAY_BUFFER, num_vertices * GetVertexSize(), nullptr, GL_STATIC_DRAW);
+        Mesh::SetupVertexAttributes(vertex_format_);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * GetIndexSize(), nullptr, GL_STATIC_DRAW);
+        glBindVertexArray(0);
+
+        if (use_indirect_)
+        {
+            glGenBuffers(1, &indirect_buffer_);
+        }
+    }
+
+    // vertices and indices go to first_vertex and first_index of the merged buffers
+    void UploadSubmesh(const Vertex* vertices, size_t num_vertices, size_t first_vertex,
+        const unsigned int* indices, size_t num_indices, size_t first_index, const vector<Texture>& textures) {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+        if (vertex_format_ == EVertexFormat::ePacked)
+        {
+            vector<PackedVertex> packed = PackVertices(vertices, num_vertices);
+            glBufferSubData(GL_ARRAY_BUFFER, first_vertex * sizeof(PackedVertex), num_vertices * sizeof(PackedVertex), packed.data());
+        }
+        else
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, first_vertex * sizeof(Vertex), num_vertices * sizeof(Vertex), vertices);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // the element buffer binding is VAO state
+        glBindVertexArray(VAO_);
+        if (index_type_ == GL_UNSIGNED_SHORT)
+        {
+            vector<uint16_t> short_indices(indices, indices + num_indices);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first_index * sizeof(uint16_t), num_indices * sizeof(uint16_t), short_indices.data());
+        }
+        else
+        {
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first_index * sizeof(unsigned int), num_indices * sizeof(unsigned int), indices);
+        }
+        glBindVertexArray(0);
+
+        MaterialGroup& group = GetMaterialGroup(textures);
+        group.counts.push_back(static_cast<GLsizei>(num_indices));
+        group.index_offsets.push_back(reinterpret_cast<const void*>(first_index * GetIndexSize()));
+        group.base_vertices.push_back(static_cast<GLint>(first_vertex));
+        num_submeshes_++;
+
+        if (use_indirect_)
+        {
+            UploadIndirectCommands();
+        }
+    }
+
+    // one multi-draw per material
+    void Draw(const Shader& shader) const {
+        DrawInstanced(shader, 1);
+    }
+
+    // num_instances copies of every submesh, gl_InstanceID tells them apart
+    // without indirect draws, more than one instance takes a draw per submesh
+    void DrawInstanced(const Shader& shader, int num_instances) const {
+        glBindVertexArray(VAO_);
+        if (use_indirect_)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+            SetIndirectInstanceCount(num_instances);
+        }
+
+        for (const MaterialGroup& group : vec_group_)
+        {
+            group.material.Bind(shader, vertex_format_);
+            if (use_indirect_)
+            {
+                glMultiDrawElementsIndirect(GL_TRIANGLES, index_type_, reinterpret_cast<const void*>(group.first_command * sizeof(DrawElementsIndirectCommand)),
+                    static_cast<GLsizei>(group.counts.size()), 0);
+            }
+            else if (num_instances == 1)
+            {
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, group.counts.data(), index_type_, group.index_offsets.data(),
+                    static_cast<GLsizei>(group.counts.size()), group.base_vertices.data());
+            }
+            else
+            {
+                for (size_t i = 0; i < group.counts.size(); i++)
+                {
+                    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, group.counts[i], index_type_, group.index_offsets[i],
+                        num_instances, group.base_vertices[i]);
+                }
+            }
+        }
+
+        if (use_indirect_)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    int GetSubmeshCount() const {
+        return num_submeshes_;
+    }
+
+    int GetDrawCallCount() const {
+        return static_cast<int>(vec_group_.size());
+    }
+
+    size_t GetVertexBufferSize() const {
+        return num_vertices_ * GetVertexSize();
+    }
+
+    size_t GetIndexBufferSize() const {
+        return num_indices_ * GetIndexSize();
+    }
+
+private:
+    unsigned int VAO_;
+    unsigned int VBO_;
+    unsigned int EBO_;
+    unsigned int indirect_buffer_ = 0;
+
+    size_t num_vertices_;
+    size_t num_indices_;
+    GLenum index_type_;
+    EVertexFormat vertex_format_;
+    bool use_indirect_;
+    int num_submeshes_ = 0;
+    // instance count of the commands in the indirect buffer
+    mutable GLuint indirect_instance_count_ = 1;
+
+    // submeshes drawn with the same textures, in the arrays glMultiDrawElementsBaseVertex takes
+    struct MaterialGroup
+    {
+        MaterialBinding material;
+        vector<GLsizei> counts;
+        vector<const void*> index_offsets;
+        vector<GLint> base_vertices;
+        // into the indirect buffer
+        size_t first_command = 0;
+    };
+    vector<MaterialGroup> vec_group_;
+
+    size_t GetVertexSize() const {
+        return vertex_format_ == EVertexFormat::ePacked ? sizeof(PackedVertex) : sizeof(Vertex);
+    }
+
+    size_t GetIndexSize() const {
+        return index_type_ == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+    }
+
+    MaterialGroup& GetMaterialGroup(const vector<Texture>& textures) {
+        MaterialBinding material(textures);
+        for (MaterialGroup& group : vec_group_)
+        {
+            if (group.material == material)
+            {
+                return group;
+            }
+        }
+        vec_group_.emplace_back();
+        vec_group_.back().material = material;
+        return vec_group_.back();
+    }
+
+    // patches the instance count of every command, the indirect buffer must be bound
+    void SetIndirectInstanceCount(int num_instances) const {
+        GLuint instance_count = static_cast<GLuint>(num_instances);
+        if (instance_count == indirect_instance_count_)
+        {
+            return;
+        }
+        for (int i = 0; i < num_submeshes_; i++)
+        {
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, i * sizeof(DrawElementsIndirectCommand) + offsetof(DrawElementsIndirectCommand, instance_count),
+                sizeof(GLuint), &instance_count);
+        }
+        indirect_instance_count_ = instance_count;
+    }
+
+    // commands of each group are contiguous, a new submesh can shift later groups, so all are rewritten
+    void UploadIndirectCommands() {
+        vector<DrawElementsIndirectCommand> commands;
+        for (MaterialGroup& group : vec_group_)
+        {
+            group.first_command = commands.size();
+            for (size_t i = 0; i < group.counts.size(); i++)
+            {
+                DrawElementsIndirectCommand command;
+                command.count = static_cast<GLuint>(group.counts[i]);
+                command.instance_count = indirect_instance_count_;
+                command.first_index = static_cast<GLuint>(reinterpret_cast<uintptr_t>(group.index_offsets[i]) / GetIndexSize());
+                command.base_vertex = group.base_vertices[i];
+                command.base_instance = 0;
+                commands.push_back(command);
+            }
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+};
+
+#endif
@@ -10,27 +10,9 @@
 #include <vector>
 
 #include "shader.h"
-
-constexpr int kMaxBonePerVertex = 4;
-
-struct Vertex 
-{
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 tex_coords;
-    glm::vec3 tangent;
-    glm::vec3 bitangent;
-
-    //bone indexes which will influence this vertex
-    int bone_id[kMaxBonePerVertex];
-    //weights from each bone
-    float weights[kMaxBonePerVertex];
-
-    Vertex() : position(0.0f), normal(0.0f), tex_coords(0.0f), tangent(0.0f), bitangent(0.0f) {
-        std::fill_n(bone_id, kMaxBonePerVertex, -1);
-        std::fill_n(weights, kMaxBonePerVertex, -1.0f);
-    }
-};
+#include "vertex.h"
+#include "utility/mesh_optimizer.h"
+#include "utility/vertex_packing.h"
 
 struct Texture 
 {
@@ -39,39 +21,25 @@ struct Texture
     string path;
 };
 
-class Mesh 
+// which texture goes to which unit and sampler, worked out once at load
+// the sampler locations are resolved on the first draw with a program and kept until another program draws it
+class MaterialBinding
 {
 public:
-    // mesh Data
-    vector<Vertex>       vertices_;
-    vector<unsigned int> indices_;
-    vector<Texture>      textures_;
-    unsigned int VAO_;
-
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures) {
-        vertices_ = vertices;
-        indices_ = indices;
-        textures_ = textures;
+    MaterialBinding() = default;
 
-        SetupMesh();
-    }
-
-    // render the mesh
-    void Draw(const Shader& shader) const {
-        // bind appropriate textures
+    // textures go to units 0 and up, samplers are named type + N, as in diffuse_textureN
+    explicit MaterialBinding(const vector<Texture>& textures) {
         unsigned int diffuseNr = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr = 1;
         unsigned int heightNr = 1;
 
-        for (unsigned int i = 0; i < textures_.size(); i++)
+        for (unsigned int i = 0; i < textures.size(); i++)
         {
-            // active proper texture unit before binding
-            glActiveTexture(GL_TEXTURE0 + i);
-
             // retrieve texture number (the N in diffuse_textureN)
             string number;
-            string name = textures_[i].type;
+            const string& name = textures[i].type;
             if (name == "texture_diffuse")
                 number = std::to_string(diffuseNr++);
             else if (name == "texture_specular")
@@ -81,27 +49,137 @@ public:
             else if (name == "texture_height")
                 number = std::to_string(heightNr++);
 
-            // set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures_[i].id);
+            units_.push_back({ i, textures[i].id, name + number, -1 });
+        }
+    }
+
+    // no string work and no allocation once the locations are resolved
+    void Bind(const Shader& shader, EVertexFormat vertex_format) const {
+        if (program_ != shader.ID)
+        {
+            ResolveLocations(shader);
+        }
+        for (const Unit& unit : units_)
+        {
+            // active proper texture unit before binding
+            glActiveTexture(GL_TEXTURE0 + unit.unit);
+            glUniform1i(unit.sampler_location, unit.unit);
+            glBindTexture(GL_TEXTURE_2D, unit.texture_id);
+        }
+        glUniform1i(packed_vertices_location_, vertex_format == EVertexFormat::ePacked);
+    }
+
+    // same textures on the same units
+    bool operator==(const MaterialBinding& other) const {
+        if (units_.size() != other.units_.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < units_.size(); i++)
+        {
+            if (units_[i].texture_id != other.units_[i].texture_id || units_[i].sampler_name != other.units_[i].sampler_name)
+            {
+                return false;
+            }
         }
+        return true;
+    }
+
+private:
+    struct Unit
+    {
+        unsigned int unit;
+        unsigned int texture_id;
+        string sampler_name;
+        // in program_
+        int sampler_location;
+    };
+    mutable vector<Unit> units_;
+    mutable unsigned int program_ = 0;
+    mutable int packed_vertices_location_ = -1;
+
+    void ResolveLocations(const Shader& shader) const {
+        for (Unit& unit : units_)
+        {
+            unit.sampler_location = shader.getUniformLocation(unit.sampler_name);
+        }
+        packed_vertices_location_ = shader.getUniformLocation("packedVertices");
+        program_ = shader.ID;
+    }
+};
+
+class Mesh 
+{
+public:
+    // mesh Data
+    vector<Texture>      textures_;
+    unsigned int VAO_;
+    unsigned int num_indices_;
+    unsigned int num_vertices_;
+    // GL_UNSIGNED_SHORT for meshes of at most kMaxShortIndexVertices vertices
+    GLenum index_type_;
+    // ePacked falls back to eFull for meshes CanPackVertices refuses
+    EVertexFormat vertex_format_;
+
+    // vertices and indices are only read by the upload, they can point into a mapped file
+    // with EVertexFormat::ePacked the vertices are packed before the upload, the shader decodes them
+    Mesh(const Vertex* vertices, size_t num_vertices, const unsigned int* indices, size_t num_indices, vector<Texture> textures,
+        EVertexFormat vertex_format = EVertexFormat::eFull) {
+        num_indices_ = static_cast<unsigned int>(num_indices);
+        num_vertices_ = static_cast<unsigned int>(num_vertices);
+        index_type_ = num_vertices <= kMaxShortIndexVertices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        textures_ = textures;
+        material_ = MaterialBinding(textures_);
+        vertex_format_ = vertex_format == EVertexFormat::ePacked && CanPackVertices(vertices, num_vertices) ? EVertexFormat::ePacked : EVertexFormat::eFull;
+
+        SetupMesh(vertices, num_vertices, indices, num_indices);
+    }
+
+    size_t GetVertexBufferSize() const {
+        return num_vertices_ * (vertex_format_ == EVertexFormat::ePacked ? sizeof(PackedVertex) : sizeof(Vertex));
+    }
+
+    size_t GetIndexBufferSize() const {
+        return num_indices_ * (index_type_ == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int));
+    }
+
+    // render the mesh
+    void Draw(const Shader& shader) const {
+        DrawInstanced(shader, 1);
+    }
+
+    // num_instances copies in one draw, the shader tells them apart by gl_InstanceID
+    void DrawInstanced(const Shader& shader, int num_instances) const {
+        material_.Bind(shader, vertex_format_);
 
         // draw mesh
         glBindVertexArray(VAO_);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices_.size()), GL_UNSIGNED_INT, 0);
+        glDrawElementsInstanced(GL_TRIANGLES, num_indices_, index_type_, 0, num_instances);
 
         // set everything back to defaults once configured.
         glBindVertexArray(0);
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // attribute pointers into the bound GL_ARRAY_BUFFER, for the bound VAO
+    static void SetupVertexAttributes(EVertexFormat vertex_format) {
+        if (vertex_format == EVertexFormat::ePacked)
+        {
+            SetupPackedAttributes();
+        }
+        else
+        {
+            SetupAttributes();
+        }
+    }
+
 private:
     unsigned int VBO_;
     unsigned int EBO_;
+    MaterialBinding material_;
 
     // initializes all the buffer objects/arrays
-    void SetupMesh() {
+    void SetupMesh(const Vertex* vertices, size_t num_vertices, const unsigned int* indices, size_t num_indices) {
         // create buffers/arrays
         glGenVertexArrays(1, &VAO_);
         glGenBuffers(1, &VBO_);
@@ -110,11 +188,31 @@ private:
         glBindVertexArray(VAO_);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-        glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(Vertex), &vertices_[0], GL_STATIC_DRAW);
+        if (vertex_format_ == EVertexFormat::ePacked)
+        {
+            vector<PackedVertex> packed = PackVertices(vertices, num_vertices);
+            glBufferData(GL_ARRAY_BUFFER, num_vertices * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+        }
+        else
+        {
+            glBufferData(GL_ARRAY_BUFFER, num_vertices * sizeof(Vertex), vertices, GL_STATIC_DRAW);
+        }
+        SetupVertexAttributes(vertex_format_);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(unsigned int), &indices_[0], GL_STATIC_DRAW);
+        if (index_type_ == GL_UNSIGNED_SHORT)
+        {
+            vector<uint16_t> short_indices(indices, indices + num_indices);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * sizeof(uint16_t), short_indices.data(), GL_STATIC_DRAW);
+        }
+        else
+        {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+        }
+        glBindVertexArray(0);
+    }
 
+    static void SetupAttributes() {
         // set the vertex attribute pointers
         // vertex Positions
         glEnableVertexAttribArray(0);
@@ -137,7 +235,28 @@ private:
         // weights
         glEnableVertexAttribArray(6);
         glVertexAttribPointer(6, kMaxBonePerVertex, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, weights));
-        glBindVertexArray(0);
+    }
+
+    // same locations as SetupAttributes, lighting.vs decodes what GL doesn't
+    static void SetupPackedAttributes() {
+        // positions as they are
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)0);
+        // octahedral normals, the shader reads (x, y, 0)
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+        // half float texture coords need no decoding
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, tex_coords));
+        // octahedral tangent with the bitangent sign in w, the bitangent (location 4) is rebuilt from it
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_BYTE, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, tangent));
+        // bone ids, kPackedNoBone for unused slots
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, kMaxBonePerVertex, GL_UNSIGNED_BYTE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, bone_id));
+        // weights
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, kMaxBonePerVertex, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, weights));
     }
 };
 #endif
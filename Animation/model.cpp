@@ -1,32 +1,24 @@
 #include "model.h"
 
-#include "utility/file_loader.h"
-#include "utility/anim_math.h"
+#include <chrono>
 
-#include <stb_image.h>
-#define STB_IMAGE_IMPLEMENTATION
 
+Model::Model(const string& model_path, const unordered_map<string, AnimationImportOption>& anim_import_options) :
+    Model(std::make_shared<const ModelData>(model_path, anim_import_options)) {}
 
-Model::Model(const string& model_path) {
-    LoadModel(model_path);
-}
-
-void Model::PlaySingleAnimation(const PlaySingleAnimParameter& parameter) {
-    p_skeleton_->CalcBoneAnimTransform(*vec_p_anims_[parameter.anim_index], parameter.normalized_time, root_transform_);
-}
-
-void Model::BlendAnimation1D(const BlendAnimParameter& parameter) {
-    p_skeleton_->BlendBoneAnimTransform(*vec_p_anims_[parameter.anim_index1], *vec_p_anims_[parameter.anim_index2], 
-        parameter.normalized_time, parameter.anim_blend_weight, root_transform_);
-}
-
-void Model::PlayAnimationTransition(const TransitionAnimParameter& parameter) {
-    p_skeleton_->TransitionAnim(*vec_p_anims_[parameter.anim_index1], *vec_p_anims_[parameter.anim_index2], 
-        parameter.time_in_sec, parameter.begin_trans_time_in_sec, root_transform_);
+Model::Model(std::shared_ptr<const ModelData> p_model_data, EModelUpload upload, const ModelUploadOption& upload_option) :
+    p_model_data_(std::move(p_model_data)), upload_option_(upload_option) {
+    if (upload == EModelUpload::eImmediate)
+    {
+        while (IsUploaded() == false)
+        {
+            UploadNextItem();
+        }
+    }
 }
 
 bool Model::HaveAnimation() const {
-    return vec_p_anims_.size() > 0;
+    return p_model_data_->HaveAnimation();
 }
 
 vector<string> Model::GetAnimationNameList() const {
@@ -36,9 +28,9 @@ vector<string> Model::GetAnimationNameList() const {
     }
 
     vector<string> animation_name_list;
-    for (int i = 0; i < vec_p_anims_.size(); i++)
+    for (const Animation* p_anim : p_model_data_->GetAnimations())
     {
-        animation_name_list.emplace_back(vec_p_anims_[i]->anim_name_);
+        animation_name_list.emplace_back(p_anim->anim_name_);
     }
     return animation_name_list;
 }
@@ -50,237 +42,171 @@ vector<float> Model::GetAnimationDurationList() const {
     }
 
     vector<float> animation_duration_list;
-    for (int i = 0; i < vec_p_anims_.size(); i++)
+    for (const Animation* p_anim : p_model_data_->GetAnimations())
     {
-        animation_duration_list.emplace_back(vec_p_anims_[i]->total_sec_);
+        animation_duration_list.emplace_back(p_anim->total_sec_);
     }
     return animation_duration_list;
 }
 
-const vector<mat4>& Model::GetSkeletonTransformMatsRef() const {
-    return p_skeleton_->GetFinalBoneTransform();
+const CharacterAsset& Model::GetCharacterAsset() const {
+    return p_model_data_->GetCharacterAsset();
 }
 
-void Model::Draw(const Shader& shader) const {
-    for (unsigned int i = 0; i < vec_mesh_.size(); i++)
+void Model::UpdateClipStreaming() const {
+    ClipStreamer* p_streamer = p_model_data_->GetClipStreamer();
+    if (p_streamer != nullptr)
     {
-        vec_mesh_[i].Draw(shader);
+        p_streamer->Update();
     }
 }
 
-void Model::LoadModel(const string& path) {
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate
-        | aiProcess_GenSmoothNormals
-        | aiProcess_FlipUVs
-        | aiProcess_CalcTangentSpace
-        | aiProcess_LimitBoneWeights);
-
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || scene->mRootNode == nullptr)
+void Model::Draw(const Shader& shader) const {
+    if (p_merged_mesh_ != nullptr)
     {
-        throw string("Assimp Error:") + importer.GetErrorString();
+        p_merged_mesh_->Draw(shader);
+        return;
     }
-
-    // retrieve the directory path of the filepath
-    model_directory_ = path.substr(0, path.find_last_of('/'));
-
-    // process ASSIMP's root node recursively and store child to parent relation
-    unordered_map<string, string> node_parent;
-    // used to get root transform
-    unordered_map<string, mat4> node_transform;
-    ProcessNode(scene->mRootNode, scene, node_parent, node_transform);
-
-    // skeleton has been loaded and store child to parent relation into skeleton
-    if (p_skeleton_ != nullptr)
+    for (unsigned int i = 0; i < vec_mesh_.size(); i++)
     {
-        p_skeleton_->SetBoneChildToParent(node_parent);
-        Bone root_bone = p_skeleton_->GetRootBone();
-        root_transform_ = GetModelRootTransform(node_parent, node_transform, root_bone.name);
+        vec_mesh_[i].Draw(shader);
     }
-
-    LoadAnimation(scene);
 }
 
-
-void Model::ProcessNode(const aiNode* node, const aiScene* scene, unordered_map<string, string>& node_parent, unordered_map<string, mat4>& node_transform) {
-    node_transform[node->mName.data] = Convert<mat4>(node->mTransformation);
-
-    for (unsigned int i = 0; i < node->mNumMeshes; i++)
+void Model::DrawInstanced(const Shader& shader, int num_instances) const {
+    if (p_merged_mesh_ != nullptr)
     {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        vec_mesh_.push_back(ProcessMesh(mesh, scene));
+        p_merged_mesh_->DrawInstanced(shader, num_instances);
+        return;
     }
-
-    for (unsigned int i = 0; i < node->mNumChildren; i++)
+    for (unsigned int i = 0; i < vec_mesh_.size(); i++)
     {
-        ProcessNode(node->mChildren[i], scene, node_parent, node_transform);
-        node_parent[node->mChildren[i]->mName.data] = node->mName.data;
+        vec_mesh_[i].DrawInstanced(shader, num_instances);
     }
 }
 
+bool Model::UploadIncremental(float time_budget_ms) {
+    using Clock = std::chrono::steady_clock;
+    auto begin = Clock::now();
 
-Mesh Model::ProcessMesh(const aiMesh* mesh, const aiScene* scene) {
-    // data to fill
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture> textures;
-
-    Vertex temp_vertex;
-    glm::vec3 temp_vec3;
-    glm::vec2 temp_vec2;
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+    // a texture or mesh is the smallest step, so one larger than the budget is still uploaded in one frame
+    while (IsUploaded() == false)
     {
-        temp_vec3.x = mesh->mVertices[i].x;
-        temp_vec3.y = mesh->mVertices[i].y;
-        temp_vec3.z = mesh->mVertices[i].z;
-        temp_vertex.position = temp_vec3;
-
-        if (mesh->HasNormals())
+        UploadNextItem();
+        if (std::chrono::duration<float, std::milli>(Clock::now() - begin).count() >= time_budget_ms)
         {
-            temp_vec3.x = mesh->mNormals[i].x;
-            temp_vec3.y = mesh->mNormals[i].y;
-            temp_vec3.z = mesh->mNormals[i].z;
-            temp_vertex.normal = temp_vec3;
+            break;
         }
+    }
+    return IsUploaded();
+}
 
-        // assume that each texture use the same tex coords
-        if (mesh->mTextureCoords[0])
-        {
-            // tex coords
-            temp_vec2.x = mesh->mTextureCoords[0][i].x;
-            temp_vec2.y = mesh->mTextureCoords[0][i].y;
-            temp_vertex.tex_coords = temp_vec2;
-            // tangent
-            temp_vec3.x = mesh->mTangents[i].x;
-            temp_vec3.y = mesh->mTangents[i].y;
-            temp_vec3.z = mesh->mTangents[i].z;
-            temp_vertex.tangent = temp_vec3;
-            // bitangent
-            temp_vec3.x = mesh->mBitangents[i].x;
-            temp_vec3.y = mesh->mBitangents[i].y;
-            temp_vec3.z = mesh->mBitangents[i].z;
-            temp_vertex.bitangent = temp_vec3;
-        }
-        else
-        {
-            temp_vertex.tex_coords = glm::vec2(0.0f, 0.0f);
-        }
+bool Model::IsUploaded() const {
+    return GetUploadedItemCount() == GetUploadItemCount();
+}
 
-        vertices.push_back(temp_vertex);
-    }
+float Model::GetUploadProgress() const {
+    int item_count = GetUploadItemCount();
+    return item_count == 0 ? 1.0f : static_cast<float>(GetUploadedItemCount()) / item_count;
+}
 
-    // vertex bone info
-    if (mesh->HasBones())
+size_t Model::GetVertexMemorySize() const {
+    if (p_merged_mesh_ != nullptr)
     {
-        // load bone
-        if (p_skeleton_ == nullptr)
-        {
-            p_skeleton_ = new Skeleton();
-        }
-        p_skeleton_->LoadSkeletonAndRetrieveVertexInfo(mesh, vertices);
+        return p_merged_mesh_->GetVertexBufferSize();
     }
-
-    // vertex indices.
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+    size_t size = 0;
+    for (const Mesh& mesh : vec_mesh_)
     {
-        aiFace face = mesh->mFaces[i];
-        for (unsigned int j = 0; j < face.mNumIndices; j++)
-        {
-            indices.push_back(face.mIndices[j]);
-        }
+        size += mesh.GetVertexBufferSize();
     }
+    return size;
+}
 
-    // process materials
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-    aiString texture_file;
-    material->Get(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, 0), texture_file);
-
-    if (const aiTexture* texture_in_mem = scene->GetEmbeddedTexture(texture_file.C_Str()))
+size_t Model::GetIndexMemorySize() const {
+    if (p_merged_mesh_ != nullptr)
     {
-        Texture texture = LoadTextureFromMemory(texture_in_mem);
-        textures.push_back(texture);
+        return p_merged_mesh_->GetIndexBufferSize();
     }
-    else
+    size_t size = 0;
+    for (const Mesh& mesh : vec_mesh_)
     {
-        vector<Texture> diffuseMaps = LoadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-        vector<Texture> specularMaps = LoadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-
-        std::vector<Texture> normalMaps = LoadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-
-        std::vector<Texture> heightMaps = LoadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        size += mesh.GetIndexBufferSize();
     }
+    return size;
+}
 
-    // return would call automatically generated move constructor
-    // so it doesn't need to reallocate memory
-    return Mesh(vertices, indices, textures);
+int Model::GetDrawCallCount() const {
+    return p_merged_mesh_ != nullptr ? p_merged_mesh_->GetDrawCallCount() : static_cast<int>(vec_mesh_.size());
 }
 
+bool Model::HasMergedMeshes() const {
+    return upload_option_.merge_meshes;
+}
 
-// checks all material textures of a given type and loads the textures if they're not loaded yet
-// the required info is returned as a Texture struct
-vector<Texture> Model::LoadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName) {
-    vector<Texture> textures;
+int Model::GetUploadItemCount() const {
+    return static_cast<int>(p_model_data_->GetTextures().size() + p_model_data_->GetMeshes().size());
+}
+
+int Model::GetUploadedItemCount() const {
+    int num_meshes = p_merged_mesh_ != nullptr ? p_merged_mesh_->GetSubmeshCount() : static_cast<int>(vec_mesh_.size());
+    return static_cast<int>(vec_texture_.size()) + num_meshes;
+}
 
-    for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+// textures go first, meshes refer to them
+void Model::UploadNextItem() {
+    const vector<TextureSource>& texture_sources = p_model_data_->GetTextures();
+    if (vec_texture_.size() < texture_sources.size())
     {
-        aiString str;
-        mat->GetTexture(type, i, &str);
+        const TextureSource& source = texture_sources[vec_texture_.size()];
 
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for (unsigned int j = 0; j < vec_loaded_tex_.size(); j++)
-        {
-            if (std::strcmp(vec_loaded_tex_[j].path.data(), str.C_Str()) == 0)
-            {
-                textures.push_back(vec_loaded_tex_[j]);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one
-                break;
-            }
-        }
+        // an image another model already uploaded is shared
+        std::shared_ptr<const CachedTexture> p_cached = TextureCache::Get().Acquire(source.cache_key, *source.p_image);
+        vec_texture_ref_.push_back(p_cached);
 
-        if (!skip)
-        {
-            // if texture hasn't been loaded already, load it
-            Texture texture;
-            texture.id = LoadTextureFromFile(str.C_Str(), this->model_directory_);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            vec_loaded_tex_.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-        }
+        Texture texture;
+        texture.id = p_cached->id;
+        texture.type = source.type;
+        texture.path = source.path;
+        vec_texture_.push_back(texture);
+        return;
     }
 
-    return textures;
-}
-
-
-mat4 Model::GetModelRootTransform(const unordered_map<string, string>& node_parent, const unordered_map<string, mat4>& node_transform, const string& bone_root) {
-    if (bone_root == string()) return mat4(1.0f);
-
-    mat4 root_transform = mat4(1.0f);
-    string curr_child = bone_root;
+    if (upload_option_.merge_meshes && p_merged_mesh_ == nullptr)
+    {
+        p_merged_mesh_ = CreateMergedMesh();
+    }
 
-    // from bone's root all the way up to model's root
-    while (node_parent.find(curr_child) != node_parent.end())
+    int mesh_index = GetUploadedItemCount() - static_cast<int>(texture_sources.size());
+    const MeshData& mesh_data = p_model_data_->GetMeshes()[mesh_index];
+    vector<Texture> textures;
+    for (int texture_index : mesh_data.texture_indices)
+    {
+        textures.push_back(vec_texture_[texture_index]);
+    }
+    const Vertex* vertices = p_model_data_->GetVertexData() + mesh_data.first_vertex;
+    const unsigned int* indices = p_model_data_->GetIndexData() + mesh_data.first_index;
+    if (p_merged_mesh_ != nullptr)
     {
-        curr_child = node_parent.find(curr_child)->second;
-        root_transform = node_transform.find(curr_child)->second * root_transform;
+        p_merged_mesh_->UploadSubmesh(vertices, mesh_data.num_vertices, mesh_data.first_vertex,
+            indices, mesh_data.num_indices, mesh_data.first_index, textures);
+        return;
     }
-    return root_transform;
+    vec_mesh_.emplace_back(vertices, mesh_data.num_vertices, indices, mesh_data.num_indices, textures, upload_option_.vertex_format);
 }
 
-
-void Model::LoadAnimation(const aiScene* scene) {
-    if (scene->HasAnimations() == false) return;
-
-    for (int i = 0; i < scene->mNumAnimations; i++)
+// the merged buffers take ModelData's layout, so each mesh keeps its first vertex and first index
+std::shared_ptr<MergedMesh> Model::CreateMergedMesh() const {
+    bool short_indices = true;
+    for (const MeshData& mesh_data : p_model_data_->GetMeshes())
+    {
+        short_indices = short_indices && mesh_data.num_vertices <= kMaxShortIndexVertices;
+    }
+    // one layout for all meshes, ePacked only if every mesh can be packed
+    EVertexFormat vertex_format = upload_option_.vertex_format;
+    if (vertex_format == EVertexFormat::ePacked && CanPackVertices(p_model_data_->GetVertexData(), p_model_data_->GetVertexCount()) == false)
     {
-        Animation* p_anim = new Animation(scene->mAnimations[i]);
-        vec_p_anims_.push_back(p_anim);
+        vertex_format = EVertexFormat::eFull;
     }
-}
\ No newline at end of file
+    return std::make_shared<MergedMesh>(p_model_data_->GetVertexCount(), p_model_data_->GetIndexCount(), short_indices, vertex_format);
+}
@@ -6,9 +6,6 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 using glm::mat4;
 
 #include <string>
@@ -16,58 +13,85 @@ using glm::mat4;
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 using std::string;
 using std::vector;
 using std::map;
 
 #include "mesh.h"
-#include "animation.h"
-#include "skeleton.h"
-#include "render_parameter.h"
+#include "merged_mesh.h"
+#include "model_data.h"
+#include "texture_cache.h"
 
+enum class EModelUpload
+{
+    eImmediate,
+    // nothing is uploaded by the constructor, UploadIncremental spreads it over frames
+    eIncremental
+};
+
+// how a model's meshes are laid out on the GPU
+struct ModelUploadOption
+{
+    // ePacked keeps full vertices for meshes it can't pack
+    EVertexFormat vertex_format = EVertexFormat::eFull;
+    // one vertex and index buffer for all meshes instead of one per mesh, drawn with a multi-draw per material
+    bool merge_meshes = false;
+};
+
+// GL side of a model: meshes and textures uploaded from imported ModelData
 class Model
 {
 public:
-    Model(const string& model_path);
-
-    void PlaySingleAnimation(const PlaySingleAnimParameter&);
-    void BlendAnimation1D(const BlendAnimParameter&);
-    void PlayAnimationTransition(const TransitionAnimParameter&);
+    // clips named in anim_import_options are imported with that option, others with the default one
+    Model(const string& model_path, const unordered_map<string, AnimationImportOption>& anim_import_options = {});
+    explicit Model(std::shared_ptr<const ModelData> p_model_data, EModelUpload upload = EModelUpload::eImmediate,
+        const ModelUploadOption& upload_option = ModelUploadOption());
+
+    // uploads textures, then meshes, until time_budget_ms is spent, at least one per call
+    // returns true once everything is uploaded, render thread only
+    bool UploadIncremental(float time_budget_ms);
+    bool IsUploaded() const;
+    // uploaded textures and meshes over all of them, 0 to 1
+    float GetUploadProgress() const;
+    // GL vertex and index buffer bytes of the meshes uploaded so far
+    size_t GetVertexMemorySize() const;
+    size_t GetIndexMemorySize() const;
+    int GetDrawCallCount() const;
+    // meshes share one vertex buffer in ModelData's vertex order, gl_VertexID indexes GetVertexData
+    bool HasMergedMeshes() const;
 
     inline bool HaveAnimation() const;
     vector<string> GetAnimationNameList() const;
     vector<float> GetAnimationDurationList() const;
 
-    const vector<mat4>& GetSkeletonTransformMatsRef() const;
+    // skeleton and clips to pose AnimatedInstances with, pose state lives in the instances
+    const CharacterAsset& GetCharacterAsset() const;
+    // pages in the blocks streamed clips sampled last frame need, call once per frame before posing
+    void UpdateClipStreaming() const;
     
     void Draw(const Shader& shader) const;
+    // every mesh num_instances times, in GetDrawCallCount draws unless merged meshes lack indirect draws
+    void DrawInstanced(const Shader& shader, int num_instances) const;
 
 private:
-    vector<Mesh> vec_mesh_;
+    // shared between copies, it owns the skeleton and animations instances point to
+    std::shared_ptr<const ModelData> p_model_data_;
+    ModelUploadOption upload_option_;
 
-    // stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once
-    vector<Texture> vec_loaded_tex_;
-    // used to get texture path
-    string model_directory_;
-
-    vector<Animation*> vec_p_anims_;
-
-    Skeleton* p_skeleton_ = nullptr;
-
-    // root transform which are not affected by skeleton hierarchy
-    // used to set transform for meshes that don't belong to skeleton
-    mat4 root_transform_ = mat4(1.0f);
-    mat4 GetModelRootTransform(const unordered_map<string, string>& node_parent, const unordered_map<string, mat4>& node_transform, const string& bone_root);
-
-    void LoadModel(const string& path);
-
-    void ProcessNode(const aiNode* node, const aiScene* scene, unordered_map<string, string>& node_parent, unordered_map<string, mat4>& node_transform);
-    Mesh ProcessMesh(const aiMesh* mesh, const aiScene* scene);
-
-    void LoadAnimation(const aiScene* scene);
-
-    vector<Texture> LoadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName);
+    // uploaded so far, in the order of ModelData's meshes and textures
+    vector<Mesh> vec_mesh_;
+    // instead of vec_mesh_ with merge_meshes, shared between copies like the GL objects of meshes
+    std::shared_ptr<MergedMesh> p_merged_mesh_;
+    vector<Texture> vec_texture_;
+    // keeps the textures from being evicted from TextureCache while copies of this model exist
+    vector<std::shared_ptr<const CachedTexture>> vec_texture_ref_;
+
+    int GetUploadItemCount() const;
+    int GetUploadedItemCount() const;
+    void UploadNextItem();
+    std::shared_ptr<MergedMesh> CreateMergedMesh() const;
 };
 
-#endif
\ No newline at end of file
+#endif
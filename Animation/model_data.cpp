@@ -0,0 +1,745 @@
+#include "model_data.h"
+
+#include "baked_model_format.h"
+#include "utility/anim_math.h"
+#include "utility/mesh_optimizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+
+ModelData::ModelData(const string& path, const unordered_map<string, AnimationImportOption>& anim_import_options) {
+    size_t extension_size = strlen(kBakedModelExtension);
+    if (path.size() > extension_size && path.compare(path.size() - extension_size, extension_size, kBakedModelExtension) == 0)
+    {
+        LoadBakedModel(path);
+        return;
+    }
+
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate
+        | aiProcess_GenSmoothNormals
+        | aiProcess_FlipUVs
+        | aiProcess_CalcTangentSpace
+        | aiProcess_LimitBoneWeights);
+
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || scene->mRootNode == nullptr)
+    {
+        throw string("Assimp Error:") + importer.GetErrorString();
+    }
+
+    // retrieve the directory path of the filepath
+    model_directory_ = path.substr(0, path.find_last_of('/'));
+
+    LoadScene(scene, anim_import_options);
+}
+
+ModelData::ModelData(const aiScene* scene, const string& model_directory, const unordered_map<string, AnimationImportOption>& anim_import_options) :
+    model_directory_(model_directory) {
+    LoadScene(scene, anim_import_options);
+}
+
+ModelData::ModelData(vector<Vertex> vertices, vector<unsigned int> indices, vector<MeshData> meshes, vector<TextureSource> textures) :
+    vec_mesh_data_(std::move(meshes)), vec_texture_(std::move(textures)), vertex_buffer_(std::move(vertices)), index_buffer_(std::move(indices)) {
+    UseOwnBuffers();
+}
+
+ModelData::~ModelData() {
+    // stops reading blocks of the clips deleted below
+    p_clip_streamer_.reset();
+    for (Animation* p_anim : vec_p_anims_)
+    {
+        delete p_anim;
+    }
+    delete p_skeleton_;
+}
+
+void ModelData::LoadScene(const aiScene* scene, const unordered_map<string, AnimationImportOption>& anim_import_options) {
+    // process ASSIMP's root node recursively and store child to parent relation
+    unordered_map<string, string> node_parent;
+    // used to get root transform
+    unordered_map<string, mat4> node_transform;
+    ProcessNode(scene->mRootNode, scene, node_parent, node_transform);
+    PrintMeshOptimizationReport();
+
+    UseOwnBuffers();
+
+    // all texture paths are known now, decode them on a worker pool while the skeleton and clips are imported
+    auto decode_begin = Clock::now();
+    // declared before the pool so that it outlives the pool's threads
+    JobCounter decode_counter;
+    std::unique_ptr<JobSystem> p_decode_pool = SubmitTextureDecodes(decode_counter);
+
+    // skeleton has been loaded and store child to parent relation into skeleton
+    if (p_skeleton_ != nullptr)
+    {
+        p_skeleton_->SetBoneChildToParent(node_parent);
+        p_skeleton_->SetBoneBindTransform(node_transform);
+        Bone root_bone = p_skeleton_->GetRootBone();
+        root_transform_ = GetModelRootTransform(node_parent, node_transform, root_bone.name);
+    }
+
+    LoadAnimation(scene, anim_import_options);
+
+    FinishTextureDecodes(p_decode_pool, decode_counter, decode_begin);
+    SetCharacterAsset();
+}
+
+void ModelData::UseOwnBuffers() {
+    p_vertex_data_ = vertex_buffer_.data();
+    num_vertices_ = vertex_buffer_.size();
+    p_index_data_ = index_buffer_.data();
+    num_indices_ = index_buffer_.size();
+}
+
+void ModelData::SetCharacterAsset() {
+    character_asset_.p_skeleton = p_skeleton_;
+    character_asset_.animations.assign(vec_p_anims_.begin(), vec_p_anims_.end());
+    character_asset_.root_transform = root_transform_;
+}
+
+
+const vector<MeshData>& ModelData::GetMeshes() const {
+    return vec_mesh_data_;
+}
+
+const Vertex* ModelData::GetVertexData() const {
+    return p_vertex_data_;
+}
+
+size_t ModelData::GetVertexCount() const {
+    return num_vertices_;
+}
+
+const unsigned int* ModelData::GetIndexData() const {
+    return p_index_data_;
+}
+
+size_t ModelData::GetIndexCount() const {
+    return num_indices_;
+}
+
+const vector<TextureSource>& ModelData::GetTextures() const {
+    return vec_texture_;
+}
+
+const string& ModelData::GetDirectory() const {
+    return model_directory_;
+}
+
+bool ModelData::HaveAnimation() const {
+    return vec_p_anims_.size() > 0;
+}
+
+const vector<Animation*>& ModelData::GetAnimations() const {
+    return vec_p_anims_;
+}
+
+const Skeleton* ModelData::GetSkeleton() const {
+    return p_skeleton_;
+}
+
+const CharacterAsset& ModelData::GetCharacterAsset() const {
+    return character_asset_;
+}
+
+bool ModelData::IsBaked() const {
+    return p_baked_file_ != nullptr;
+}
+
+ClipStreamer* ModelData::GetClipStreamer() const {
+    return p_clip_streamer_.get();
+}
+
+
+void ModelData::ProcessNode(const aiNode* node, const aiScene* scene, unordered_map<string, string>& node_parent, unordered_map<string, mat4>& node_transform) {
+    node_transform[node->mName.data] = Convert<mat4>(node->mTransformation);
+
+    for (unsigned int i = 0; i < node->mNumMeshes; i++)
+    {
+        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+        vec_mesh_data_.push_back(ProcessMesh(mesh, scene));
+    }
+
+    for (unsigned int i = 0; i < node->mNumChildren; i++)
+    {
+        ProcessNode(node->mChildren[i], scene, node_parent, node_transform);
+        node_parent[node->mChildren[i]->mName.data] = node->mName.data;
+    }
+}
+
+
+MeshData ModelData::ProcessMesh(const aiMesh* mesh, const aiScene* scene) {
+    // data to fill
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    vector<int> texture_indices;
+
+    Vertex temp_vertex;
+    glm::vec3 temp_vec3;
+    glm::vec2 temp_vec2;
+    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+    {
+        temp_vec3.x = mesh->mVertices[i].x;
+        temp_vec3.y = mesh->mVertices[i].y;
+        temp_vec3.z = mesh->mVertices[i].z;
+        temp_vertex.position = temp_vec3;
+
+        if (mesh->HasNormals())
+        {
+            temp_vec3.x = mesh->mNormals[i].x;
+            temp_vec3.y = mesh->mNormals[i].y;
+            temp_vec3.z = mesh->mNormals[i].z;
+            temp_vertex.normal = temp_vec3;
+        }
+
+        // assume that each texture use the same tex coords
+        if (mesh->mTextureCoords[0])
+        {
+            // tex coords
+            temp_vec2.x = mesh->mTextureCoords[0][i].x;
+            temp_vec2.y = mesh->mTextureCoords[0][i].y;
+            temp_vertex.tex_coords = temp_vec2;
+            // tangent
+            temp_vec3.x = mesh->mTangents[i].x;
+            temp_vec3.y = mesh->mTangents[i].y;
+            temp_vec3.z = mesh->mTangents[i].z;
+            temp_vertex.tangent = temp_vec3;
+            // bitangent
+            temp_vec3.x = mesh->mBitangents[i].x;
+            temp_vec3.y = mesh->mBitangents[i].y;
+            temp_vec3.z = mesh->mBitangents[i].z;
+            temp_vertex.bitangent = temp_vec3;
+        }
+        else
+        {
+            temp_vertex.tex_coords = glm::vec2(0.0f, 0.0f);
+        }
+
+        vertices.push_back(temp_vertex);
+    }
+
+    // vertex bone info
+    if (mesh->HasBones())
+    {
+        // load bone
+        if (p_skeleton_ == nullptr)
+        {
+            p_skeleton_ = new Skeleton();
+        }
+        p_skeleton_->LoadSkeletonAndRetrieveVertexInfo(mesh, vertices);
+    }
+
+    // vertex indices.
+    bool triangles_only = true;
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+    {
+        aiFace face = mesh->mFaces[i];
+        for (unsigned int j = 0; j < face.mNumIndices; j++)
+        {
+            indices.push_back(face.mIndices[j]);
+        }
+        triangles_only = triangles_only && face.mNumIndices == 3;
+    }
+
+    // welded and reordered for the post-transform cache, after bone weights are in the vertices
+    if (triangles_only)
+    {
+        mesh_optimization_report_.Add(OptimizeMesh(vertices, indices));
+    }
+
+    // process materials
+    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    aiString texture_file;
+    material->Get(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, 0), texture_file);
+
+    if (const aiTexture* texture_in_mem = scene->GetEmbeddedTexture(texture_file.C_Str()))
+    {
+        AddEmbeddedTexture(texture_in_mem, texture_file.C_Str(), texture_indices);
+    }
+    else
+    {
+        AddMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", texture_indices);
+        AddMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", texture_indices);
+        AddMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", texture_indices);
+        AddMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", texture_indices);
+    }
+
+    MeshData mesh_data;
+    mesh_data.first_vertex = static_cast<unsigned int>(vertex_buffer_.size());
+    mesh_data.num_vertices = static_cast<unsigned int>(vertices.size());
+    mesh_data.first_index = static_cast<unsigned int>(index_buffer_.size());
+    mesh_data.num_indices = static_cast<unsigned int>(indices.size());
+    mesh_data.texture_indices = std::move(texture_indices);
+
+    vertex_buffer_.insert(vertex_buffer_.end(), vertices.begin(), vertices.end());
+    index_buffer_.insert(index_buffer_.end(), indices.begin(), indices.end());
+    return mesh_data;
+}
+
+
+void ModelData::PrintMeshOptimizationReport() const {
+    const MeshOptimizationReport& report = mesh_optimization_report_;
+    int num_short_index_meshes = 0;
+    for (const MeshData& mesh_data : vec_mesh_data_)
+    {
+        num_short_index_meshes += mesh_data.num_vertices <= kMaxShortIndexVertices ? 1 : 0;
+    }
+    std::cout << "Meshes: " << vec_mesh_data_.size() << ", " << report.vertices_before << " -> " << report.vertices_after << " vertices welded, ACMR "
+        << report.cache_before.GetACMR() << " -> " << report.cache_after.GetACMR() << ", ATVR " << report.cache_before.GetATVR() << " -> "
+        << report.cache_after.GetATVR() << " (FIFO " << kVertexCacheSize << "), " << num_short_index_meshes << " with 16 bit indices" << std::endl;
+}
+
+
+void ModelData::AddMaterialTextures(const aiMaterial* mat, aiTextureType type, const string& type_name, vector<int>& texture_indices) {
+    for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+    {
+        aiString str;
+        mat->GetTexture(type, i, &str);
+        texture_indices.push_back(AddTexture(type_name, str.C_Str(), NormalizeImagePath(model_directory_ + '/' + str.C_Str()), nullptr));
+    }
+}
+
+void ModelData::AddEmbeddedTexture(const aiTexture* texture_in_mem, const string& path, vector<int>& texture_indices) {
+    // mHeight == 0 means pcData holds a compressed image of mWidth bytes, raw texels otherwise
+    size_t data_size = texture_in_mem->mHeight == 0 ? texture_in_mem->mWidth : static_cast<size_t>(texture_in_mem->mWidth) * texture_in_mem->mHeight * sizeof(aiTexel);
+    string cache_key = EmbeddedImageKey(reinterpret_cast<const unsigned char*>(texture_in_mem->pcData), data_size);
+    texture_indices.push_back(AddTexture("texture_diffuse", path, cache_key, texture_in_mem));
+}
+
+// registers the texture for decoding unless the model already uses it, returns its index
+int ModelData::AddTexture(const string& type, const string& path, const string& cache_key, const aiTexture* p_embedded) {
+    auto iter = texture_index_by_key_.find(type + '|' + cache_key);
+    if (iter != texture_index_by_key_.end())
+    {
+        return iter->second;
+    }
+
+    TextureSource texture;
+    texture.type = type;
+    texture.path = path;
+    texture.cache_key = cache_key;
+    texture.embedded = p_embedded != nullptr;
+
+    int texture_index = static_cast<int>(vec_texture_.size());
+    vec_texture_.push_back(std::move(texture));
+    texture_index_by_key_.emplace(type + '|' + cache_key, texture_index);
+    pending_decodes_.push_back({ texture_index, p_embedded, 0.0f, false, false });
+    return texture_index;
+}
+
+
+std::unique_ptr<JobSystem> ModelData::SubmitTextureDecodes(JobCounter& counter) {
+    if (pending_decodes_.empty())
+    {
+        return nullptr;
+    }
+
+    int num_threads = std::min<int>(pending_decodes_.size(), std::max(1u, std::thread::hardware_concurrency()));
+    auto p_decode_pool = std::make_unique<JobSystem>(num_threads);
+
+    // vec_texture_ doesn't grow anymore, so every job can write its own texture
+    for (int i = 0; i < pending_decodes_.size(); i++)
+    {
+        p_decode_pool->Submit(counter, &ModelData::DecodeTextureJob, this, i, i + 1);
+    }
+    return p_decode_pool;
+}
+
+void ModelData::FinishTextureDecodes(std::unique_ptr<JobSystem>& p_decode_pool, JobCounter& counter, Clock::time_point decode_begin) {
+    if (p_decode_pool == nullptr) return;
+
+    // this thread helps with the decodes that are left
+    p_decode_pool->Wait(counter);
+    PrintTextureDecodeReport(std::chrono::duration<float, std::milli>(Clock::now() - decode_begin).count(), p_decode_pool->GetThreadCount());
+    pending_decodes_.clear();
+    p_decode_pool.reset();
+}
+
+void ModelData::DecodeTextureJob(void* data, int begin, int end, int worker_index) {
+    ModelData& model_data = *static_cast<ModelData*>(data);
+    for (int i = begin; i < end; i++)
+    {
+        model_data.DecodeTexture(model_data.pending_decodes_[i]);
+    }
+}
+
+void ModelData::DecodeTexture(PendingDecode& pending) {
+    auto begin = Clock::now();
+    TextureSource& texture = vec_texture_[pending.texture_index];
+
+    texture.p_image = ImageCache::Get().Acquire(texture.cache_key, [&](ImageData& image) {
+        pending.decoded = true;
+        ImageDiskCache& disk_cache = ImageDiskCache::Get();
+        string source_path = pending.p_embedded == nullptr ? model_directory_ + '/' + texture.path : string();
+        if (disk_cache.Load(texture.cache_key, source_path, image))
+        {
+            pending.from_disk_cache = true;
+            return;
+        }
+
+        if (pending.p_embedded == nullptr)
+        {
+            DecodeImageFile(source_path, image);
+        }
+        else if (pending.p_embedded->mHeight == 0)
+        {
+            DecodeImageMemory(reinterpret_cast<const unsigned char*>(pending.p_embedded->pcData), pending.p_embedded->mWidth, image);
+        }
+        else
+        {
+            // raw BGRA texels
+            image.width = pending.p_embedded->mWidth;
+            image.height = pending.p_embedded->mHeight;
+            image.components = 4;
+            image.pixels.reserve(static_cast<size_t>(pending.p_embedded->mWidth) * pending.p_embedded->mHeight * 4);
+            for (unsigned int i = 0; i < pending.p_embedded->mWidth * pending.p_embedded->mHeight; i++)
+            {
+                const aiTexel& texel = pending.p_embedded->pcData[i];
+                image.pixels.insert(image.pixels.end(), { texel.r, texel.g, texel.b, texel.a });
+            }
+        }
+
+        // mips are built once here instead of by GL on every run
+        if (disk_cache.IsEnabled() && image.IsValid())
+        {
+            BuildMipChain(image);
+            disk_cache.Store(texture.cache_key, source_path, image);
+        }
+    });
+
+    pending.decode_ms = std::chrono::duration<float, std::milli>(Clock::now() - begin).count();
+}
+
+// serial time is the sum of all decodes, what importing the textures one after another would have taken
+void ModelData::PrintTextureDecodeReport(float wall_ms, int num_threads) const {
+    float serial_ms = 0.0f;
+    int num_decoded = 0;
+    int num_from_disk = 0;
+    for (const PendingDecode& pending : pending_decodes_)
+    {
+        serial_ms += pending.decode_ms;
+        num_decoded += pending.decoded && pending.from_disk_cache == false ? 1 : 0;
+        num_from_disk += pending.from_disk_cache ? 1 : 0;
+
+        const TextureSource& texture = vec_texture_[pending.texture_index];
+        if (pending.decoded && texture.p_image->IsValid() == false)
+        {
+            std::cout << "Texture failed to load at path: " << texture.path << std::endl;
+        }
+    }
+
+    CacheStats cache_stats = ImageCache::Get().GetStats();
+    std::cout << "Textures: " << pending_decodes_.size() << " used, " << num_decoded << " decoded on " << num_threads << " threads, "
+        << num_from_disk << " read from disk cache, " << pending_decodes_.size() - num_decoded - num_from_disk << " from image cache (" << cache_stats.hits << " hits, " << cache_stats.misses << " misses so far), serial "
+        << serial_ms << " ms -> wall " << wall_ms << " ms (overlapped with skeleton and animation import)" << std::endl;
+}
+
+
+mat4 ModelData::GetModelRootTransform(const unordered_map<string, string>& node_parent, const unordered_map<string, mat4>& node_transform, const string& bone_root) {
+    if (bone_root == string()) return mat4(1.0f);
+
+    mat4 root_transform = mat4(1.0f);
+    string curr_child = bone_root;
+
+    // from bone's root all the way up to model's root
+    while (node_parent.find(curr_child) != node_parent.end())
+    {
+        curr_child = node_parent.find(curr_child)->second;
+        root_transform = node_transform.find(curr_child)->second * root_transform;
+    }
+    return root_transform;
+}
+
+
+void ModelData::LoadAnimation(const aiScene* scene, const unordered_map<string, AnimationImportOption>& anim_import_options) {
+    if (scene->HasAnimations() == false) return;
+
+    for (int i = 0; i < scene->mNumAnimations; i++)
+    {
+        AnimationImportOption option;
+        auto iter = anim_import_options.find(scene->mAnimations[i]->mName.data);
+        if (iter != anim_import_options.end())
+        {
+            option = iter->second;
+        }
+
+        Animation* p_anim = new Animation(scene->mAnimations[i], option);
+        vec_p_anims_.push_back(p_anim);
+
+        if (option.reduce_keys || option.quantize_keys)
+        {
+            CompressAnimationKeys(*p_anim, option);
+        }
+
+        // resolve bone to channel table once instead of on every sample
+        if (p_skeleton_ != nullptr)
+        {
+            p_skeleton_->BindAnimation(*p_anim);
+        }
+    }
+}
+
+void ModelData::CompressAnimationKeys(Animation& anim, const AnimationImportOption& option) {
+    // errors are measured against the clip as imported
+    Animation reference = anim;
+
+    if (option.reduce_keys)
+    {
+        if (p_skeleton_ == nullptr || anim.GetKeySampleMode() != EKeySampleMode::eKeyframe)
+        {
+            std::cout << "Animation " << anim.anim_name_ << ": key reduction skipped, needs a skeleton and keyframe mode" << std::endl;
+        }
+        else
+        {
+            KeyCompressionReport report = anim.ReduceKeys(p_skeleton_->CalcChannelErrorTolerance(anim, option.key_error_tolerance));
+            PrintKeyCompressionReport(anim, reference, "key reduction", report);
+        }
+    }
+
+    if (option.quantize_keys)
+    {
+        KeyCompressionReport report = anim.QuantizeKeys();
+        PrintKeyCompressionReport(anim, reference, "quantization", report);
+    }
+}
+
+void ModelData::PrintKeyCompressionReport(const Animation& anim, const Animation& reference, const string& step_name, const KeyCompressionReport& report) const {
+    std::cout << "Animation " << anim.anim_name_ << " " << step_name << ": keys " << report.keys_before << " -> " << report.keys_after
+        << ", key memory " << report.bytes_before / 1024.0f << " KB -> " << report.bytes_after / 1024.0f << " KB";
+
+    if (p_skeleton_ != nullptr)
+    {
+        // 4 samples per frame also catches errors between keys
+        float max_world_error = p_skeleton_->CalcMaxWorldError(reference, anim, std::max(anim.total_frames_, 1) * 4, root_transform_);
+        std::cout << ", max world error " << max_world_error;
+    }
+    std::cout << std::endl;
+}
+
+// arrays of a baked file are used in place, only the skeleton and clip tables are copied out
+void ModelData::LoadBakedModel(const string& path) {
+    auto load_begin = Clock::now();
+    model_directory_ = path.substr(0, path.find_last_of('/'));
+    p_baked_file_ = std::make_unique<MappedFile>(path);
+
+    const unsigned char* file_data = p_baked_file_->GetData();
+    size_t file_size = p_baked_file_->GetSize();
+    size_t table_end = sizeof(BakedFileHeader) + sizeof(BakedSection) * static_cast<size_t>(EBakedSection::eCount);
+    if (file_size < table_end)
+    {
+        throw string("Baked model too small: ") + path;
+    }
+
+    const BakedFileHeader& header = *reinterpret_cast<const BakedFileHeader*>(file_data);
+    if (memcmp(header.magic, kBakedModelMagic, sizeof(kBakedModelMagic)) != 0 || header.endian_tag != kBakedEndianTag)
+    {
+        throw string("Not a baked model: ") + path;
+    }
+    if (header.version != kBakedModelVersion || header.vertex_size != sizeof(Vertex) || header.section_count != static_cast<uint32_t>(EBakedSection::eCount))
+    {
+        throw string("Baked model of version ") + std::to_string(header.version) + ", expected " + std::to_string(kBakedModelVersion) + ", rebake " + path;
+    }
+
+    const BakedSection* sections = reinterpret_cast<const BakedSection*>(file_data + sizeof(BakedFileHeader));
+    for (uint32_t i = 0; i < header.section_count; i++)
+    {
+        if (sections[i].offset % kBakedSectionAlignment != 0 || sections[i].offset > file_size || sections[i].size > file_size - sections[i].offset)
+        {
+            throw string("Corrupt baked model: ") + path;
+        }
+    }
+
+    auto get_section = [&](EBakedSection section, size_t element_size, size_t& count) {
+        const BakedSection& baked_section = sections[static_cast<uint32_t>(section)];
+        count = baked_section.size / element_size;
+        return file_data + baked_section.offset;
+    };
+    size_t strings_size;
+    const char* strings = reinterpret_cast<const char*>(get_section(EBakedSection::eStrings, 1, strings_size));
+    auto get_string = [&](uint32_t offset) {
+        return offset < strings_size ? string(strings + offset) : string();
+    };
+
+    // vertex and index arrays stay in the mapping, upload reads them from there
+    size_t count;
+    p_vertex_data_ = reinterpret_cast<const Vertex*>(get_section(EBakedSection::eVertices, sizeof(Vertex), num_vertices_));
+    p_index_data_ = reinterpret_cast<const unsigned int*>(get_section(EBakedSection::eIndices, sizeof(uint32_t), num_indices_));
+
+    size_t num_texture_refs, num_textures;
+    const int32_t* texture_refs = reinterpret_cast<const int32_t*>(get_section(EBakedSection::eTextureRefs, sizeof(int32_t), num_texture_refs));
+    const BakedTexture* textures = reinterpret_cast<const BakedTexture*>(get_section(EBakedSection::eTextures, sizeof(BakedTexture), num_textures));
+    const BakedMesh* meshes = reinterpret_cast<const BakedMesh*>(get_section(EBakedSection::eMeshes, sizeof(BakedMesh), count));
+    for (size_t i = 0; i < count; i++)
+    {
+        if (static_cast<size_t>(meshes[i].first_vertex) + meshes[i].num_vertices > num_vertices_
+            || static_cast<size_t>(meshes[i].first_index) + meshes[i].num_indices > num_indices_
+            || static_cast<size_t>(meshes[i].first_texture_ref) + meshes[i].num_texture_refs > num_texture_refs)
+        {
+            throw string("Corrupt baked model: ") + path;
+        }
+
+        // refs index the textures section, which becomes vec_texture_ entry for entry
+        for (uint32_t j = 0; j < meshes[i].num_texture_refs; j++)
+        {
+            int32_t texture_ref = texture_refs[meshes[i].first_texture_ref + j];
+            if (texture_ref < 0 || static_cast<size_t>(texture_ref) >= num_textures)
+            {
+                throw string("Corrupt baked model: ") + path;
+            }
+        }
+
+        MeshData mesh_data;
+        mesh_data.first_vertex = meshes[i].first_vertex;
+        mesh_data.num_vertices = meshes[i].num_vertices;
+        mesh_data.first_index = meshes[i].first_index;
+        mesh_data.num_indices = meshes[i].num_indices;
+        mesh_data.texture_indices.assign(texture_refs + meshes[i].first_texture_ref, texture_refs + meshes[i].first_texture_ref + meshes[i].num_texture_refs);
+        vec_mesh_data_.push_back(std::move(mesh_data));
+    }
+
+    // file textures are decoded like imported ones, embedded ones were baked decoded
+    size_t pixels_size;
+    const unsigned char* pixels = get_section(EBakedSection::ePixels, 1, pixels_size);
+    for (size_t i = 0; i < num_textures; i++)
+    {
+        const BakedTexture& baked_texture = textures[i];
+        if (baked_texture.pixel_size == 0)
+        {
+            string texture_path = get_string(baked_texture.path);
+            AddTexture(get_string(baked_texture.type), texture_path, NormalizeImagePath(model_directory_ + '/' + texture_path), nullptr);
+            continue;
+        }
+
+        if (baked_texture.pixel_offset > pixels_size || baked_texture.pixel_size > pixels_size - baked_texture.pixel_offset)
+        {
+            throw string("Corrupt baked model: ") + path;
+        }
+
+        TextureSource texture;
+        texture.type = get_string(baked_texture.type);
+        texture.path = get_string(baked_texture.path);
+        texture.cache_key = get_string(baked_texture.cache_key);
+        texture.embedded = true;
+        texture.p_image = ImageCache::Get().Acquire(texture.cache_key, [&](ImageData& image) {
+            image.width = baked_texture.width;
+            image.height = baked_texture.height;
+            image.components = baked_texture.components;
+            image.pixels.assign(pixels + baked_texture.pixel_offset, pixels + baked_texture.pixel_offset + baked_texture.pixel_size);
+        });
+        texture_index_by_key_.emplace(texture.type + '|' + texture.cache_key, static_cast<int>(vec_texture_.size()));
+        vec_texture_.push_back(std::move(texture));
+    }
+    // a texture listed twice would shift the ones after it
+    if (vec_texture_.size() != num_textures)
+    {
+        throw string("Corrupt baked model: ") + path;
+    }
+
+    auto decode_begin = Clock::now();
+    JobCounter decode_counter;
+    std::unique_ptr<JobSystem> p_decode_pool = SubmitTextureDecodes(decode_counter);
+
+    const BakedBone* bones = reinterpret_cast<const BakedBone*>(get_section(EBakedSection::eBones, sizeof(BakedBone), count));
+    if (header.has_skeleton != 0)
+    {
+        vector<BoneData> bone_data(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            bone_data[i].name = get_string(bones[i].name);
+            memcpy(&bone_data[i].offset, bones[i].offset, sizeof(bones[i].offset));
+            bone_data[i].parent_index = bones[i].parent_index;
+            memcpy(&bone_data[i].bind_local_transform, bones[i].bind_local_transform, sizeof(bones[i].bind_local_transform));
+        }
+        p_skeleton_ = new Skeleton(bone_data);
+    }
+    memcpy(&root_transform_, header.root_transform, sizeof(header.root_transform));
+
+    size_t num_channels, num_key_blocks;
+    const BakedChannel* channels = reinterpret_cast<const BakedChannel*>(get_section(EBakedSection::eChannels, sizeof(BakedChannel), num_channels));
+    const KeyBlock* key_blocks = reinterpret_cast<const KeyBlock*>(get_section(EBakedSection::eKeyBlocks, sizeof(KeyBlock), num_key_blocks));
+    const BakedClip* clips = reinterpret_cast<const BakedClip*>(get_section(EBakedSection::eClips, sizeof(BakedClip), count));
+    size_t num_stream_blocks;
+    const BakedStreamBlock* stream_blocks = reinterpret_cast<const BakedStreamBlock*>(get_section(EBakedSection::eStreamBlocks, sizeof(BakedStreamBlock), num_stream_blocks));
+    const BakedSection& stream_data = sections[static_cast<uint32_t>(EBakedSection::eStreamData)];
+    for (size_t i = 0; i < count; i++)
+    {
+        const BakedClip& clip = clips[i];
+        if (static_cast<size_t>(clip.first_channel) + clip.num_channels > num_channels || clip.first_key_block > num_key_blocks
+            || clip.num_key_blocks > num_key_blocks - clip.first_key_block)
+        {
+            throw string("Corrupt baked model: ") + path;
+        }
+
+        AnimationClipData clip_data;
+        clip_data.name = get_string(clip.name);
+        clip_data.total_frames = clip.total_frames;
+        clip_data.frame_per_sec = clip.frame_per_sec;
+        clip_data.total_sec = clip.total_sec;
+        clip_data.key_format = static_cast<EKeyFormat>(clip.key_format);
+        clip_data.key_time_step = clip.key_time_step;
+        clip_data.key_sample_mode = static_cast<EKeySampleMode>(clip.key_sample_mode);
+        clip_data.keys_per_tick = clip.keys_per_tick;
+        clip_data.num_uniform_keys = clip.num_uniform_keys;
+        for (uint32_t j = 0; j < clip.num_channels; j++)
+        {
+            const BakedChannel& baked_channel = channels[clip.first_channel + j];
+            Channel channel;
+            channel.name_ = get_string(baked_channel.name);
+            channel.position_track_ = baked_channel.position_track;
+            channel.rotation_track_ = baked_channel.rotation_track;
+            channel.scale_track_ = baked_channel.scale_track;
+            clip_data.channels.push_back(channel);
+        }
+        clip_data.key_buffer.assign(key_blocks + clip.first_key_block, key_blocks + clip.first_key_block + clip.num_key_blocks);
+        if (AreTracksInKeyBuffer(clip_data) == false)
+        {
+            throw string("Corrupt baked model: ") + path;
+        }
+
+        Animation* p_anim = new Animation(std::move(clip_data));
+        vec_p_anims_.push_back(p_anim);
+        if (clip.num_stream_blocks > 0)
+        {
+            if (clip.first_stream_block > num_stream_blocks || clip.num_stream_blocks > num_stream_blocks - clip.first_stream_block)
+            {
+                throw string("Corrupt baked model: ") + path;
+            }
+
+            // blocks are read from the file as playback reaches them, not from the mapping
+            vector<ClipBlockInfo> block_infos(clip.num_stream_blocks);
+            for (size_t j = 0; j < block_infos.size(); j++)
+            {
+                const BakedStreamBlock& block = stream_blocks[clip.first_stream_block + j];
+                if (block.offset > stream_data.size || block.size > stream_data.size - block.offset)
+                {
+                    throw string("Corrupt baked model: ") + path;
+                }
+                block_infos[j].begin_tick = block.begin_tick;
+                block_infos[j].end_tick = block.end_tick;
+                block_infos[j].first_uniform_key = block.first_uniform_key;
+                block_infos[j].file_offset = stream_data.offset + block.offset;
+                block_infos[j].size = block.size;
+            }
+            if (p_clip_streamer_ == nullptr)
+            {
+                p_clip_streamer_ = std::make_unique<ClipStreamer>(path);
+            }
+            p_clip_streamer_->AddClip(*p_anim, clip.stream_block_ticks, block_infos);
+        }
+        if (p_skeleton_ != nullptr)
+        {
+            p_skeleton_->BindAnimation(*p_anim);
+        }
+    }
+
+    FinishTextureDecodes(p_decode_pool, decode_counter, decode_begin);
+    SetCharacterAsset();
+
+    std::cout << "Baked model " << path << ": " << vec_mesh_data_.size() << " meshes, " << num_vertices_ << " vertices, "
+        << vec_p_anims_.size() << " clips mapped in " << std::chrono::duration<float, std::milli>(Clock::now() - load_begin).count() << " ms" << std::endl;
+}
@@ -0,0 +1,164 @@
+#ifndef MODEL_DATA_H
+#define MODEL_DATA_H
+
+#include <glm/glm.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+using glm::mat4;
+
+#include <chrono>
+#include <string>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+using std::string;
+using std::vector;
+using std::unordered_map;
+
+#include "vertex.h"
+#include "animation.h"
+#include "skeleton.h"
+#include "animated_instance.h"
+#include "clip_streamer.h"
+#include "utility/image_cache.h"
+#include "utility/image_disk_cache.h"
+#include "utility/job_system.h"
+#include "utility/mapped_file.h"
+#include "utility/mesh_optimizer.h"
+
+// an image materials refer to, decoded but not uploaded yet
+struct TextureSource
+{
+    string type;
+    // file path relative to the model directory, or the name of an embedded texture
+    string path;
+    // key of the image in ImageCache and TextureCache, models sharing an image share the key
+    string cache_key;
+    // shared with every model using the image, empty if the image failed to decode
+    std::shared_ptr<const ImageData> p_image;
+    // stored in the model file instead of next to it
+    bool embedded = false;
+};
+
+// a range of ModelData's vertex and index buffers, indices count from the mesh's first vertex
+struct MeshData
+{
+    unsigned int first_vertex = 0;
+    unsigned int num_vertices = 0;
+    unsigned int first_index = 0;
+    unsigned int num_indices = 0;
+    // into ModelData::GetTextures
+    vector<int> texture_indices;
+};
+
+// everything imported from a model file, including decoded images, kept on the CPU
+// it makes no GL call, so it can be imported without a window or on a background thread
+class ModelData
+{
+public:
+    // clips named in anim_import_options are imported with that option, others with the default one
+    // files with kBakedModelExtension are memory mapped instead of imported, their clips are used as baked
+    ModelData(const string& model_path, const unordered_map<string, AnimationImportOption>& anim_import_options = {});
+    // imports a scene that is already in memory, texture files are relative to model_directory
+    ModelData(const aiScene* scene, const string& model_directory, const unordered_map<string, AnimationImportOption>& anim_import_options = {});
+    // model built in code, without skeleton and animation
+    ModelData(vector<Vertex> vertices, vector<unsigned int> indices, vector<MeshData> meshes, vector<TextureSource> textures);
+    ~ModelData();
+
+    // skeleton and animations are referenced by pointer from bindings and instances
+    ModelData(const ModelData&) = delete;
+    ModelData& operator=(const ModelData&) = delete;
+
+    const vector<MeshData>& GetMeshes() const;
+    // vertices and indices of all meshes, in the mapped file for baked models
+    const Vertex* GetVertexData() const;
+    size_t GetVertexCount() const;
+    const unsigned int* GetIndexData() const;
+    size_t GetIndexCount() const;
+    const vector<TextureSource>& GetTextures() const;
+    const string& GetDirectory() const;
+
+    bool HaveAnimation() const;
+    const vector<Animation*>& GetAnimations() const;
+    const Skeleton* GetSkeleton() const;
+    // skeleton and clips to pose AnimatedInstances with
+    const CharacterAsset& GetCharacterAsset() const;
+    bool IsBaked() const;
+    // null unless the baked file has streamed clips, update it once per frame
+    ClipStreamer* GetClipStreamer() const;
+
+private:
+    vector<MeshData> vec_mesh_data_;
+    vector<TextureSource> vec_texture_;
+
+    // imported models own their buffers, baked models point into the mapped file
+    vector<Vertex> vertex_buffer_;
+    vector<unsigned int> index_buffer_;
+    std::unique_ptr<MappedFile> p_baked_file_;
+    const Vertex* p_vertex_data_ = nullptr;
+    size_t num_vertices_ = 0;
+    const unsigned int* p_index_data_ = nullptr;
+    size_t num_indices_ = 0;
+    void UseOwnBuffers();
+
+    // used to get texture path
+    string model_directory_;
+
+    vector<Animation*> vec_p_anims_;
+    // streamed clips keep only the blocks playback needs in memory
+    std::unique_ptr<ClipStreamer> p_clip_streamer_;
+
+    Skeleton* p_skeleton_ = nullptr;
+
+    // root transform which are not affected by skeleton hierarchy
+    // used to set transform for meshes that don't belong to skeleton
+    mat4 root_transform_ = mat4(1.0f);
+    mat4 GetModelRootTransform(const unordered_map<string, string>& node_parent, const unordered_map<string, mat4>& node_transform, const string& bone_root);
+
+    CharacterAsset character_asset_;
+    void SetCharacterAsset();
+
+    void LoadScene(const aiScene* scene, const unordered_map<string, AnimationImportOption>& anim_import_options);
+
+    void ProcessNode(const aiNode* node, const aiScene* scene, unordered_map<string, string>& node_parent, unordered_map<string, mat4>& node_transform);
+    MeshData ProcessMesh(const aiMesh* mesh, const aiScene* scene);
+    // summed over the meshes ProcessMesh optimized
+    MeshOptimizationReport mesh_optimization_report_;
+    void PrintMeshOptimizationReport() const;
+
+    void LoadAnimation(const aiScene* scene, const unordered_map<string, AnimationImportOption>& anim_import_options);
+    void CompressAnimationKeys(Animation& anim, const AnimationImportOption& option);
+    void PrintKeyCompressionReport(const Animation& anim, const Animation& reference, const string& step_name, const KeyCompressionReport& report) const;
+
+    void LoadBakedModel(const string& path);
+
+    // textures are only registered while nodes are processed and decoded all at once afterwards
+    struct PendingDecode
+    {
+        int texture_index;
+        // null for texture files
+        const aiTexture* p_embedded;
+        float decode_ms;
+        // false if ImageCache already had the image
+        bool decoded;
+        // decoded earlier and read back from ImageDiskCache, mips included
+        bool from_disk_cache;
+    };
+    vector<PendingDecode> pending_decodes_;
+    // type and cache key to index in vec_texture_, a texture used by several meshes is registered once
+    unordered_map<string, int> texture_index_by_key_;
+
+    void AddMaterialTextures(const aiMaterial* mat, aiTextureType type, const string& type_name, vector<int>& texture_indices);
+    void AddEmbeddedTexture(const aiTexture* texture_in_mem, const string& path, vector<int>& texture_indices);
+    int AddTexture(const string& type, const string& path, const string& cache_key, const aiTexture* p_embedded);
+
+    // returns the pool decoding the pending textures, null if there are none
+    std::unique_ptr<JobSystem> SubmitTextureDecodes(JobCounter& counter);
+    void FinishTextureDecodes(std::unique_ptr<JobSystem>& p_decode_pool, JobCounter& counter, std::chrono::steady_clock::time_point decode_begin);
+    static void DecodeTextureJob(void* data, int begin, int end, int worker_index);
+    void DecodeTexture(PendingDecode& pending);
+    void PrintTextureDecodeReport(float wall_ms, int num_threads) const;
+};
+
+#endif
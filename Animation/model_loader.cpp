@@ -0,0 +1,122 @@
+#include "model_loader.h"
+
+#include <chrono>
+#include <iostream>
+
+using Clock = std::chrono::steady_clock;
+
+
+ModelLoader::ModelLoader(const string& model_path, const unordered_map<string, AnimationImportOption>& anim_import_options, const ModelUploadOption& upload_option) :
+    model_path_(model_path), upload_option_(upload_option), begin_time_(Clock::now()) {
+    // import_ms_ is written before the future becomes ready, get() makes it visible to the render thread
+    import_future_ = std::async(std::launch::async, [this, anim_import_options]() {
+        auto import_begin = Clock::now();
+        auto p_model_data = std::make_shared<const ModelData>(model_path_, anim_import_options);
+        import_ms_ = std::chrono::duration<float, std::milli>(Clock::now() - import_begin).count();
+        return p_model_data;
+    });
+}
+
+void ModelLoader::Update(float upload_budget_ms) {
+    if (p_model_ == nullptr)
+    {
+        if (import_future_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return;
+        }
+        p_model_ = std::make_unique<Model>(import_future_.get(), EModelUpload::eIncremental, upload_option_);
+    }
+
+    if (p_model_->IsUploaded() && upload_frames_ > 0)
+    {
+        return;
+    }
+
+    auto upload_begin = Clock::now();
+    bool uploaded = p_model_->UploadIncremental(upload_budget_ms);
+    upload_ms_ += std::chrono::duration<float, std::milli>(Clock::now() - upload_begin).count();
+    upload_frames_++;
+
+    if (uploaded)
+    {
+        float total_ms = std::chrono::duration<float, std::milli>(Clock::now() - begin_time_).count();
+        CacheStats texture_stats = TextureCache::Get().GetStats();
+        std::cout << "Model " << model_path_ << " loaded in " << total_ms << " ms: import " << import_ms_
+            << " ms, upload " << upload_ms_ << " ms over " << upload_frames_ << " frames, texture cache "
+            << texture_stats.hits << " hits, " << texture_stats.misses << " misses, vertex buffers "
+            << p_model_->GetVertexMemorySize() / 1024.0f << " KB, index buffers " << p_model_->GetIndexMemorySize() / 1024.0f << " KB, "
+            << p_model_->GetDrawCallCount() << " draw calls" << std::endl;
+        if (ImageDiskCache::Get().IsEnabled())
+        {
+            DiskCacheStats disk_stats = ImageDiskCache::Get().GetStats();
+            std::cout << "Image disk cache " << ImageDiskCache::Get().GetDirectory() << ": " << disk_stats.hits << " hits, "
+                << disk_stats.misses << " misses, " << disk_stats.writes << " written, " << disk_stats.evictions << " evicted, "
+                << disk_stats.files << " entries in " << disk_stats.size_bytes / (1024.0f * 1024.0f) << " MB" << std::endl;
+        }
+    }
+}
+
+bool ModelLoader::IsLoaded() const {
+    return p_model_ != nullptr && p_model_->IsUploaded();
+}
+
+float ModelLoader::GetProgress() const {
+    return p_model_ == nullptr ? 0.0f : 0.5f + 0.5f * p_model_->GetUploadProgress();
+}
+
+const Model& ModelLoader::GetModel() const {
+    return *p_model_;
+}
+
+
+std::shared_ptr<const ModelData> CreatePlaceholderModelData(float half_size) {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    // 4 vertices per face so each face keeps its own normal
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (float sign : { 1.0f, -1.0f })
+        {
+            glm::vec3 normal(0.0f);
+            normal[axis] = sign;
+            glm::vec3 u(0.0f), v(0.0f);
+            u[(axis + 1) % 3] = half_size;
+            v[(axis + 2) % 3] = half_size * sign;
+
+            unsigned int first = static_cast<unsigned int>(vertices.size());
+            for (int corner = 0; corner < 4; corner++)
+            {
+                Vertex vertex;
+                float cu = (corner & 1) ? 1.0f : -1.0f;
+                float cv = (corner & 2) ? 1.0f : -1.0f;
+                vertex.position = normal * half_size + u * cu + v * cv;
+                vertex.normal = normal;
+                vertex.tex_coords = glm::vec2(0.5f);
+                vertices.push_back(vertex);
+            }
+            indices.insert(indices.end(), { first, first + 1, first + 2, first + 1, first + 3, first + 2 });
+        }
+    }
+    MeshData box;
+    box.num_vertices = static_cast<unsigned int>(vertices.size());
+    box.num_indices = static_cast<unsigned int>(indices.size());
+    box.texture_indices.push_back(0);
+
+    // 1x1 grey texture, the lighting shader always samples a diffuse texture
+    TextureSource grey;
+    grey.type = "texture_diffuse";
+    grey.path = "placeholder";
+    grey.cache_key = "placeholder:grey";
+    auto p_image = std::make_shared<ImageData>();
+    p_image->width = 1;
+    p_image->height = 1;
+    p_image->components = 4;
+    p_image->pixels = { 160, 160, 160, 255 };
+    grey.p_image = p_image;
+
+    vector<MeshData> meshes;
+    meshes.push_back(std::move(box));
+    vector<TextureSource> textures;
+    textures.push_back(std::move(grey));
+    return std::make_shared<const ModelData>(std::move(vertices), std::move(indices), std::move(meshes), std::move(textures));
+}
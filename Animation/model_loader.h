@@ -0,0 +1,56 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+using std::string;
+using std::unordered_map;
+
+#include "model.h"
+
+// loads a model without blocking the render thread: ModelData is imported on a background thread,
+// then Update uploads it a few textures and meshes per frame
+class ModelLoader
+{
+public:
+    // starts the import right away, clips named in anim_import_options are imported with that option
+    // meshes are uploaded as upload_option says
+    ModelLoader(const string& model_path, const unordered_map<string, AnimationImportOption>& anim_import_options = {},
+        const ModelUploadOption& upload_option = ModelUploadOption());
+
+    // the import thread points back to the loader
+    ModelLoader(const ModelLoader&) = delete;
+    ModelLoader& operator=(const ModelLoader&) = delete;
+
+    // call once per frame on the render thread, upload_budget_ms bounds the GL upload time of the frame
+    // rethrows the import error if the import failed
+    void Update(float upload_budget_ms);
+
+    bool IsLoaded() const;
+    // import counts as the first half, upload as the second
+    float GetProgress() const;
+    // valid once IsLoaded
+    const Model& GetModel() const;
+
+private:
+    string model_path_;
+    ModelUploadOption upload_option_;
+    std::unique_ptr<Model> p_model_;
+
+    // startup timing, reported when the upload is done
+    std::chrono::steady_clock::time_point begin_time_;
+    float import_ms_ = 0.0f;
+    float upload_ms_ = 0.0f;
+    int upload_frames_ = 0;
+
+    // last member, so destroying the loader waits for the import before the members it writes go away
+    std::future<std::shared_ptr<const ModelData>> import_future_;
+};
+
+// lit grey box drawn while the real model is loading, it has no skeleton and no animation
+std::shared_ptr<const ModelData> CreatePlaceholderModelData(float half_size = 1.0f);
+
+#endif
@@ -7,6 +7,9 @@
 #include"render_parameter.h"
 #include"shader.h"
 #include"render_volume.h"
+#include"bone_palette_ring.h"
+
+#include<memory>
 
 using glm::mat4;
 
@@ -14,11 +17,20 @@ using glm::mat4;
 class RenderScene
 {
 public:
-	RenderScene(Model model, Shader shader, RenderVolume render_volume, Camera camera = Camera(), Light light = Light())
-		: model_(model), shader_(shader), camera_(camera), light_(light), 
-		render_parameter_(model.HaveAnimation(), model.GetAnimationNameList(), model.GetAnimationDurationList()) 
+	RenderScene(Model model, Shader shader, RenderVolume render_volume, Camera camera = Camera(), Light light = Light(),
+		EPaletteEncoding palette_encoding = EPaletteEncoding::eMat4)
+		: model_(model), instance_(model_.GetCharacterAsset()), shader_(shader), camera_(camera), light_(light), 
+		render_parameter_(model.HaveAnimation(), model.GetAnimationNameList(), model.GetAnimationDurationList()),
+		palette_encoding_(palette_encoding)
 	{
 		shader_.use();
+		ResolveUniformLocations();
+
+		// one palette slice, for the displayed character
+		if (render_parameter_.have_animtion == true)
+		{
+			p_palette_ring_ = std::make_shared<BonePaletteRing>(model_.GetCharacterAsset().p_skeleton->GetBoneCount(), 1, palette_encoding_);
+		}
 
 		projection_mat_ = glm::perspective(glm::radians(render_volume.fov_in_degree),
 			(float)render_volume.screen_width / (float)render_volume.screen_height, 
@@ -26,18 +38,22 @@ public:
 	}
 
 	void CalculateModelAnimationPose() {
+		model_.UpdateClipStreaming();
 		if (render_parameter_.have_animtion == true)
 		{
+			// the pose goes straight into this frame's slice of the palette buffer
+			p_palette_ring_->BeginFrame();
+			instance_.SetPaletteTarget(p_palette_ring_->GetSlice(0), palette_encoding_);
 			switch (render_parameter_.eanim_play_mode)
 			{
 			case EAnimtionPlayMode::eSingle:
-				model_.PlaySingleAnimation(render_parameter_.play_single_anim_para);
+				instance_.PlaySingleAnimation(render_parameter_.play_single_anim_para, pose_scratch_);
 				break;
 			case EAnimtionPlayMode::eBlend:
-				model_.BlendAnimation1D(render_parameter_.blend_anim_para);
+				instance_.BlendAnimation1D(render_parameter_.blend_anim_para, pose_scratch_);
 				break;
 			case EAnimtionPlayMode::eTransition:
-				model_.PlayAnimationTransition(render_parameter_.transition_anim_para);
+				instance_.PlayAnimationTransition(render_parameter_.transition_anim_para, pose_scratch_);
 				break;
 			}
 		}
@@ -46,6 +62,10 @@ public:
 	void Draw() const { 
 		PassUniforms();
 		model_.Draw(shader_);
+		if (p_palette_ring_ != nullptr)
+		{
+			p_palette_ring_->FenceFrame();
+		}
 	}
 
 	void SetTransform(vec3 position, float rotate_angle, vec3 rotate_axis, vec3 scale) {
@@ -53,9 +73,13 @@ public:
 		model_mat_ = glm::translate(model_mat_, position);
 		model_mat_ = glm::rotate(model_mat_, glm::radians(rotate_angle), rotate_axis);
 		model_mat_ = glm::scale(model_mat_, scale);
+		// once per transform instead of per vertex in lighting.vs
+		normal_mat_ = glm::transpose(glm::inverse(glm::mat3(model_mat_)));
 	}
 
 	Model model_;
+	// pose of the displayed character, model_ only holds shared data
+	AnimatedInstance instance_;
 	Camera camera_;
 	Light light_;
 	RenderParameter render_parameter_;
@@ -65,21 +89,52 @@ private:
 	mat4 projection_mat_;
 
 	mat4 model_mat_ = mat4(1.0f);
+	glm::mat3 normal_mat_ = glm::mat3(1.0f);
+	EPaletteEncoding palette_encoding_;
+	PoseScratch pose_scratch_;
+	// shared, copies of the scene draw from the same buffer
+	std::shared_ptr<BonePaletteRing> p_palette_ring_;
+
+	// looked up once, PassUniforms runs every frame
+	struct UniformLocations
+	{
+		int projection;
+		int view;
+		int model;
+		int normal_matrix;
+		int palette_encoding;
+		int light_color;
+		int light_pos;
+		int view_pos;
+	};
+	UniformLocations uniform_locations_;
+
+	void ResolveUniformLocations() {
+		uniform_locations_.projection = shader_.getUniformLocation("projection");
+		uniform_locations_.view = shader_.getUniformLocation("view");
+		uniform_locations_.model = shader_.getUniformLocation("model");
+		uniform_locations_.normal_matrix = shader_.getUniformLocation("normalMatrix");
+		uniform_locations_.palette_encoding = shader_.getUniformLocation("paletteEncoding");
+		uniform_locations_.light_color = shader_.getUniformLocation("lightColor");
+		uniform_locations_.light_pos = shader_.getUniformLocation("lightPos");
+		uniform_locations_.view_pos = shader_.getUniformLocation("viewPos");
+	}
 
 	void PassUniforms() const {
-		shader_.setMat4("projection", projection_mat_);
-		shader_.setMat4("view", camera_.GetViewMatrix());
-		shader_.setMat4("model", model_mat_);
+		shader_.setMat4(uniform_locations_.projection, projection_mat_);
+		shader_.setMat4(uniform_locations_.view, camera_.GetViewMatrix());
+		shader_.setMat4(uniform_locations_.model, model_mat_);
+		shader_.setMat3(uniform_locations_.normal_matrix, normal_mat_);
+		shader_.setInt(uniform_locations_.palette_encoding, static_cast<int>(palette_encoding_));
 
-		shader_.setVec3("lightColor", light_.color_);
-		shader_.setVec3("lightPos", light_.pos_);
+		shader_.setVec3(uniform_locations_.light_color, light_.color_);
+		shader_.setVec3(uniform_locations_.light_pos, light_.pos_);
 
-		shader_.setVec3("viewPos", camera_.Position);
+		shader_.setVec3(uniform_locations_.view_pos, camera_.Position);
 
-		if (render_parameter_.have_animtion == true)
+		if (p_palette_ring_ != nullptr)
 		{
-			glUniformMatrix4fv(glGetUniformLocation(shader_.ID, "bones"), 75, 
-				GL_FALSE, glm::value_ptr(model_.GetSkeletonTransformMatsRef()[0]));
+			p_palette_ring_->BindSlice(0);
 		}
 	}
 };
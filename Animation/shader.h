@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -94,7 +96,7 @@ public:
         glDeleteShader(fragment);
         if (geometryPath != nullptr)
             glDeleteShader(geometry);
-
+        reflectUniforms();
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -102,66 +104,130 @@ public:
     {
         glUseProgram(ID);
     }
+    // location of an active uniform from the table built at link time, -1 if the program has none by that name
+    // per frame code resolves its locations once and passes them to the location setters below
+    // ------------------------------------------------------------------------
+    int getUniformLocation(const std::string& name) const
+    {
+        auto it = uniform_locations_.find(name);
+        return it == uniform_locations_.end() ? -1 : it->second;
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(getUniformLocation(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(getUniformLocation(name), 1, &value[0]);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(getUniformLocation(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(getUniformLocation(name), 1, &value[0]);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(getUniformLocation(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(getUniformLocation(name), 1, &value[0]);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(getUniformLocation(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+    }
+    // setters by location, they do no lookup
+    // ------------------------------------------------------------------------
+    void setBool(int location, bool value) const
+    {
+        glUniform1i(location, (int)value);
+    }
+    void setInt(int location, int value) const
+    {
+        glUniform1i(location, value);
+    }
+    void setFloat(int location, float value) const
+    {
+        glUniform1f(location, value);
+    }
+    void setVec3(int location, const glm::vec3& value) const
+    {
+        glUniform3fv(location, 1, &value[0]);
+    }
+    void setMat3(int location, const glm::mat3& mat) const
+    {
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(int location, const glm::mat4& mat) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // active uniforms by name, arrays under both "name" and "name[0]"
+    std::unordered_map<std::string, int> uniform_locations_;
+
+    // asks the linked program for its active uniforms once, so no setter has to
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        GLint num_uniforms = 0;
+        GLint max_name_length = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &num_uniforms);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+        std::vector<GLchar> name_buffer(max_name_length > 0 ? max_name_length : 1);
+        for (GLint i = 0; i < num_uniforms; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, i, static_cast<GLsizei>(name_buffer.size()), &length, &size, &type, name_buffer.data());
+            std::string name(name_buffer.data(), length);
+            // members of uniform blocks have no location
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0)
+                continue;
+            uniform_locations_[name] = location;
+            size_t bracket = name.find("[0]");
+            if (bracket != std::string::npos && bracket + 3 == name.size())
+                uniform_locations_[name.substr(0, bracket)] = location;
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -1,10 +1,33 @@
 #include"skeleton.h"
 #include"utility/anim_math.h"
 
+#include<algorithm>
+
 Skeleton::Skeleton() :
 	vec_bone_(),
 	bone_name_to_index_() {}
 
+Skeleton::Skeleton(const vector<BoneData>& bones) {
+	for (const BoneData& bone_data : bones)
+	{
+		bone_name_to_index_[bone_data.name] = vec_bone_.size();
+		vec_bone_.emplace_back(bone_data.offset, bone_data.parent_index, bone_data.name);
+		vec_bone_.back().bind_local_transform = bone_data.bind_local_transform;
+	}
+
+	DecomposeBindTransforms();
+	BuildPoseTables();
+}
+
+vector<BoneData> Skeleton::GetBoneData() const {
+	vector<BoneData> bones;
+	for (const Bone& bone : vec_bone_)
+	{
+		bones.push_back({ bone.name, bone.offset, bone.parent_index, bone.bind_local_transform });
+	}
+	return bones;
+}
+
 
 void Skeleton::LoadSkeletonAndRetrieveVertexInfo(const aiMesh* const mesh, vector<Vertex>& vertices) {
 	for (unsigned int i = 0; i < mesh->mNumBones; i++)
@@ -16,7 +39,7 @@ void Skeleton::LoadSkeletonAndRetrieveVertexInfo(const aiMesh* const mesh, vecto
 		{
 			bone_index = vec_bone_.size();
 			aiMatrix4x4 ai_mat_bone_offset = mesh->mBones[i]->mOffsetMatrix;
-			vec_bone_.emplace_back(Convert<mat4>(ai_mat_bone_offset), mat4(1.0f), -1, bone_name);
+			vec_bone_.emplace_back(Convert<mat4>(ai_mat_bone_offset), -1, bone_name);
 			bone_name_to_index_[bone_name] = bone_index;
 		}
 		else
@@ -72,105 +95,285 @@ Bone Skeleton::GetRootBone() const {
 
 
 
-void Skeleton::CalcBoneAnimTransform(const Animation& animation, float normalized_time, const mat4& root_transform) {
-	// calculate hierarchy transform
-	// parent's index is necessarily smaller than child's
-	for (int i = 0; i < vec_bone_.size(); i++)
+void Skeleton::SetBoneBindTransform(const unordered_map<string, mat4>& node_transform) {
+	for (auto& bone : vec_bone_)
 	{
-		mat4 pos = glm::translate(mat4(1.0f), animation.GetPosition(vec_bone_[i].name, normalized_time));
-		mat4 rot = glm::mat4_cast(animation.GetRotation(vec_bone_[i].name, normalized_time));
-		mat4 scale = glm::scale(mat4(1.0f), vec3(animation.GetScale(vec_bone_[i].name, normalized_time)));
-
-		int parent_i = vec_bone_[i].parent_index;
-		mat4 parent_mat = parent_i >= 0 ? vec_bone_[parent_i].transform : root_transform;
-		vec_bone_[i].transform = parent_mat * pos * rot * scale;
+		auto iter = node_transform.find(bone.name);
+		if (iter != node_transform.end())
+		{
+			bone.bind_local_transform = iter->second;
+		}
 	}
 
-	CalculateFinalTransform();
+	// bind transforms are the last bone data set at load
+	DecomposeBindTransforms();
+	BuildPoseTables();
 }
 
-void Skeleton::BlendBoneAnimTransform(const Animation& anim1, const Animation& anim2, float normalized_time, float weight, const mat4& root_transform) {
-	// calculate hierarchy transform
-	for (int i = 0; i < vec_bone_.size(); i++)
+void Skeleton::DecomposeBindTransforms() {
+	for (auto& bone : vec_bone_)
 	{
-		mat4 pos1 = glm::translate(mat4(1.0f), anim1.GetPosition(vec_bone_[i].name, normalized_time));
-		mat4 rot1 = glm::mat4_cast(anim1.GetRotation(vec_bone_[i].name, normalized_time));
-		mat4 scale1 = glm::scale(mat4(1.0f), vec3(anim1.GetScale(vec_bone_[i].name, normalized_time)));
+		// node transforms are translation * rotation * uniform scale
+		bone.bind_translation = vec3(bone.bind_local_transform[3]);
+		bone.bind_scale = glm::length(vec3(bone.bind_local_transform[0]));
+		float inv_scale = bone.bind_scale > 0.0f ? 1.0f / bone.bind_scale : 1.0f;
+		bone.bind_rotation = glm::normalize(glm::quat_cast(glm::mat3(bone.bind_local_transform) * inv_scale));
+	}
+}
 
-		mat4 pos2 = glm::translate(mat4(1.0f), anim2.GetPosition(vec_bone_[i].name, normalized_time));
-		mat4 rot2 = glm::mat4_cast(anim2.GetRotation(vec_bone_[i].name, normalized_time));
-		mat4 scale2 = glm::scale(mat4(1.0f), vec3(anim2.GetScale(vec_bone_[i].name, normalized_time)));
+void Skeleton::BuildPoseTables() {
+	int num_bones = vec_bone_.size();
+	bone_parent_index_.resize(num_bones);
+	bone_offset_.resize(num_bones);
+	for (int i = 0; i < num_bones; i++)
+	{
+		bone_parent_index_[i] = vec_bone_[i].parent_index;
+		bone_offset_[i] = ToAffine(vec_bone_[i].offset);
+	}
+}
 
-		pos1 = Interpolate(pos1, pos2, weight);
-		rot1 = Interpolate(rot1, rot2, weight);
-		scale1 = Interpolate(scale1, scale2, weight);
 
-		int parent_i = vec_bone_[i].parent_index;
-		mat4 parent_mat = parent_i >= 0 ? vec_bone_[parent_i].transform : root_transform;
-		vec_bone_[i].transform = parent_mat * pos1 * rot1 * scale1;
+void Skeleton::BindAnimation(const Animation& animation) {
+	auto iter = anim_bindings_.find(&animation);
+	int cursor_slot = iter != anim_bindings_.end() ? iter->second.cursor_slot : anim_bindings_.size();
+	anim_bindings_[&animation] = MakeAnimBinding(animation);
+	anim_bindings_[&animation].cursor_slot = cursor_slot;
+}
+
+PoseState Skeleton::CreatePoseState() const {
+	PoseState state;
+	state.cursors.resize(anim_bindings_.size());
+	for (const auto& iter : anim_bindings_)
+	{
+		state.cursors[iter.second.cursor_slot] = iter.first->CreateCursor();
 	}
 
-	CalculateFinalTransform();
+	int num_bones = vec_bone_.size();
+	state.global_transform.resize(num_bones);
+	state.final_affine_transform.resize(num_bones);
+	state.final_bone_transform.resize(num_bones);
+	return state;
 }
 
-void Skeleton::TransitionAnim(const Animation& anim1, const Animation& anim2, float time_in_sec, float trans_begin_time_in_sec, const mat4& root_transform) {
-	float anim1_total_sec = anim1.total_sec_;
-	if (trans_begin_time_in_sec > anim1_total_sec)
+AnimationBinding Skeleton::MakeAnimBinding(const Animation& animation) const {
+	AnimationBinding binding;
+	binding.bone_to_channel.resize(vec_bone_.size());
+	for (int i = 0; i < vec_bone_.size(); i++)
 	{
-		throw string("Transition time error, transition begin time > animation1 total time");
+		binding.bone_to_channel[i] = animation.GetChannelIndex(vec_bone_[i].name);
 	}
+	return binding;
+}
 
-	float anim2_total_sec = anim2.total_sec_;
+const AnimationBinding& Skeleton::GetAnimBinding(const Animation& animation) const {
+	auto iter = anim_bindings_.find(&animation);
+	if (iter == anim_bindings_.end())
+	{
+		throw string("Animation " + animation.anim_name_ + " is not bound to skeleton");
+	}
+	return iter->second;
+}
 
-	time_in_sec = fmod(time_in_sec, trans_begin_time_in_sec + anim2_total_sec);
+void Skeleton::SampleBoneLocalTRS(const Animation& animation, const AnimationBinding& binding, AnimationCursor& cursor, int bone_index, float normalized_time,
+	vec3& translation, quat& rotation, float& scale) const {
+	int channel_index = binding.bone_to_channel[bone_index];
+	if (channel_index == AnimationBinding::kNoChannel)
+	{
+		const Bone& bone = vec_bone_[bone_index];
+		translation = bone.bind_translation;
+		rotation = bone.bind_rotation;
+		scale = bone.bind_scale;
+		return;
+	}
 
-	if (time_in_sec <= trans_begin_time_in_sec)
+	translation = animation.GetPosition(channel_index, normalized_time, cursor);
+	rotation = animation.GetRotation(channel_index, normalized_time, cursor);
+	scale = animation.GetScale(channel_index, normalized_time, cursor);
+}
+
+void Skeleton::SampleLocalPose(const Animation& animation, float normalized_time, PoseState& state, LocalPose& pose, JobSystem* job_system) const {
+	const AnimationBinding& binding = GetAnimBinding(animation);
+	if (binding.cursor_slot >= state.cursors.size())
 	{
-		CalcBoneAnimTransform(anim1, anim1.GetNormalizedTime(time_in_sec), root_transform);
+		state.cursors.resize(binding.cursor_slot + 1);
 	}
-	else if (time_in_sec > trans_begin_time_in_sec && time_in_sec <= anim1_total_sec)
+	AnimationCursor& cursor = state.cursors[binding.cursor_slot];
+	if (cursor.channel_cursors.size() != animation.GetChannelCount())
 	{
-		for (int i = 0; i < vec_bone_.size(); i++)
+		// animation bound after the state was created
+		cursor = animation.CreateCursor();
+	}
+
+	// a streamed clip is sampled from one resident block, looked up once for all bones
+	const Animation& keys = animation.GetResidentKeys(normalized_time, cursor);
+
+	pose.Resize(vec_bone_.size());
+	auto sample_bones = [&](int begin, int end, int worker_index) {
+		for (int i = begin; i < end; i++)
 		{
-			float anim1_normalize_time = anim1.GetNormalizedTime(time_in_sec);
-			mat4 pos1 = glm::translate(mat4(1.0f), anim1.GetPosition(vec_bone_[i].name, anim1_normalize_time));
-			mat4 rot1 = glm::mat4_cast(anim1.GetRotation(vec_bone_[i].name, anim1_normalize_time));
-			mat4 scale1 = glm::scale(mat4(1.0f), vec3(anim1.GetScale(vec_bone_[i].name, anim1_normalize_time)));
+			SampleBoneLocalTRS(keys, binding, cursor, i, normalized_time, pose.translations[i], pose.rotations[i], pose.scales[i]);
+		}
+	};
 
-			float anim2_normalize_time = anim2.GetNormalizedTime(time_in_sec - trans_begin_time_in_sec);
-			mat4 pos2 = glm::translate(mat4(1.0f), anim2.GetPosition(vec_bone_[i].name, anim2_normalize_time));
-			mat4 rot2 = glm::mat4_cast(anim2.GetRotation(vec_bone_[i].name, anim2_normalize_time));
-			mat4 scale2 = glm::scale(mat4(1.0f), vec3(anim1.GetScale(vec_bone_[i].name, anim2_normalize_time)));
+	// bones sample independently and each touches only its own channel's cursor,
+	// so the result doesn't depend on how bones are split between threads
+	if (job_system != nullptr && vec_bone_.size() >= kParallelSampleBones)
+	{
+		job_system->ParallelFor(vec_bone_.size(), kParallelSampleBones / 4, sample_bones);
+	}
+	else
+	{
+		sample_bones(0, vec_bone_.size(), 0);
+	}
+}
 
-			float weight = (time_in_sec - trans_begin_time_in_sec) / (anim1_total_sec - trans_begin_time_in_sec);
 
-			pos1 = Interpolate(pos1, pos2, weight);
-			rot1 = Interpolate(rot1, rot2, weight);
-			scale1 = Interpolate(scale1, scale2, weight);
+vector<KeyErrorTolerance> Skeleton::CalcChannelErrorTolerance(const Animation& animation, const KeyErrorTolerance& world_tolerance) const {
+	// channels that drive no bone only need the world bound
+	vector<KeyErrorTolerance> channel_tolerances(animation.GetChannelCount(), world_tolerance);
+	if (vec_bone_.empty()) return channel_tolerances;
 
-			int parent_i = vec_bone_[i].parent_index;
-			mat4 parent_mat = parent_i >= 0 ? vec_bone_[parent_i].transform : root_transform;
-			vec_bone_[i].transform = parent_mat * pos1 * rot1;
+	// reach: farthest bind pose distance from a bone down to any of its descendants
+	// parent's index is necessarily smaller than child's
+	vector<float> reach(vec_bone_.size(), 0.0f);
+	vector<int> depth(vec_bone_.size(), 1);
+	int max_depth = 1;
+	for (int i = 0; i < vec_bone_.size(); i++)
+	{
+		int parent_i = vec_bone_[i].parent_index;
+		depth[i] = parent_i >= 0 ? depth[parent_i] + 1 : 1;
+		max_depth = std::max(max_depth, depth[i]);
+	}
+	for (int i = vec_bone_.size() - 1; i >= 0; i--)
+	{
+		int parent_i = vec_bone_[i].parent_index;
+		if (parent_i >= 0)
+		{
+			vec3 bone_pos = vec3(glm::inverse(vec_bone_[i].offset)[3]);
+			vec3 parent_pos = vec3(glm::inverse(vec_bone_[parent_i].offset)[3]);
+			reach[parent_i] = std::max(reach[parent_i], glm::distance(bone_pos, parent_pos) + reach[i]);
 		}
+	}
 
-		CalculateFinalTransform();
+	// errors of every bone on a chain add up at its end, so each bone of the deepest chain
+	// gets an equal share, split again between its position, rotation and scale tracks
+	float bone_budget = world_tolerance.position / (max_depth * 3.0f);
+	for (int i = 0; i < vec_bone_.size(); i++)
+	{
+		int channel_index = animation.GetChannelIndex(vec_bone_[i].name);
+		if (channel_index < 0) continue;
+
+		KeyErrorTolerance& tolerance = channel_tolerances[channel_index];
+		tolerance.position = bone_budget;
+		if (reach[i] > 0.0f)
+		{
+			// a small rotation (scale) error moves descendants by about angle (scale) * distance
+			tolerance.rotation = std::min(world_tolerance.rotation, bone_budget / reach[i]);
+			tolerance.scale = std::min(world_tolerance.scale, bone_budget / reach[i]);
+		}
 	}
-	else
+	return channel_tolerances;
+}
+
+float Skeleton::CalcMaxWorldError(const Animation& reference, const Animation& approx, int num_samples, const mat4& root_transform) const {
+	AnimationBinding reference_binding = MakeAnimBinding(reference);
+	AnimationBinding approx_binding = MakeAnimBinding(approx);
+	AnimationCursor reference_cursor = reference.CreateCursor();
+	AnimationCursor approx_cursor = approx.CreateCursor();
+	vector<Affine3x4> reference_global(vec_bone_.size());
+	vector<Affine3x4> approx_global(vec_bone_.size());
+	Affine3x4 root = ToAffine(root_transform);
+
+	float max_error = 0.0f;
+	for (int s = 0; s < num_samples; s++)
 	{
-		CalcBoneAnimTransform(anim2, anim2.GetNormalizedTime(time_in_sec - trans_begin_time_in_sec), root_transform);
+		float normalized_time = static_cast<float>(s) / num_samples;
+		for (int i = 0; i < vec_bone_.size(); i++)
+		{
+			int parent_i = vec_bone_[i].parent_index;
+			vec3 translation;
+			quat rotation;
+			float scale;
+
+			SampleBoneLocalTRS(reference, reference_binding, reference_cursor, i, normalized_time, translation, rotation, scale);
+			reference_global[i] = MultiplyAffine(parent_i >= 0 ? reference_global[parent_i] : root, ComposeTRS(translation, rotation, scale));
+
+			SampleBoneLocalTRS(approx, approx_binding, approx_cursor, i, normalized_time, translation, rotation, scale);
+			approx_global[i] = MultiplyAffine(parent_i >= 0 ? approx_global[parent_i] : root, ComposeTRS(translation, rotation, scale));
+
+			vec3 reference_pos(reference_global[i].rows[0][3], reference_global[i].rows[1][3], reference_global[i].rows[2][3]);
+			vec3 approx_pos(approx_global[i].rows[0][3], approx_global[i].rows[1][3], approx_global[i].rows[2][3]);
+			max_error = std::max(max_error, glm::distance(reference_pos, approx_pos));
+		}
 	}
+	return max_error;
+}
+
+
+void Skeleton::CalcBoneAnimTransform(const Animation& animation, float normalized_time, PoseState& state, PoseScratch& scratch,
+	const mat4& root_transform, JobSystem* job_system) const {
+	SampleLocalPose(animation, normalized_time, state, scratch.sample_pose[0], job_system);
+	ComposePose(scratch.sample_pose[0], state, root_transform);
 }
 
+void Skeleton::ComposePose(const LocalPose& pose, PoseState& state, const mat4& root_transform) const {
+	// parent's index is necessarily smaller than child's
+	ComposePoseHierarchy(vec_bone_.size(), pose.translations.data(), pose.rotations.data(), pose.scales.data(),
+		bone_parent_index_.data(), ToAffine(root_transform), bone_offset_.data(), state.global_transform.data(), state.final_affine_transform.data());
 
-void Skeleton::CalculateFinalTransform() {
-	final_bone_transform_.resize(vec_bone_.size());
+	if (state.palette_target != nullptr)
+	{
+		EncodePalette(state.final_affine_transform.data(), vec_bone_.size(), state.palette_encoding, state.palette_target);
+		return;
+	}
 	for (int i = 0; i < vec_bone_.size(); i++)
 	{
-		final_bone_transform_[i] = vec_bone_[i].transform * vec_bone_[i].offset;
+		state.final_bone_transform[i] = ToMat4(state.final_affine_transform[i]);
 	}
 }
 
+void Skeleton::BlendBoneAnimTransform(const Animation& anim1, const Animation& anim2, float normalized_time, float weight, PoseState& state, PoseScratch& scratch,
+	const mat4& root_transform, JobSystem* job_system) const {
+	SampleLocalPose(anim1, normalized_time, state, scratch.sample_pose[0], job_system);
+	SampleLocalPose(anim2, normalized_time, state, scratch.sample_pose[1], job_system);
+	BlendLocalPose(scratch.sample_pose[0], scratch.sample_pose[1], weight, scratch.sample_pose[0]);
+	ComposePose(scratch.sample_pose[0], state, root_transform);
+}
+
+void Skeleton::TransitionAnim(const Animation& anim1, const Animation& anim2, float time_in_sec, float trans_begin_time_in_sec, PoseState& state, PoseScratch& scratch,
+	const mat4& root_transform, JobSystem* job_system) const {
+	float anim1_total_sec = anim1.total_sec_;
+	if (trans_begin_time_in_sec > anim1_total_sec)
+	{
+		throw string("Transition time error, transition begin time > animation1 total time");
+	}
+
+	float anim2_total_sec = anim2.total_sec_;
+
+	time_in_sec = fmod(time_in_sec, trans_begin_time_in_sec + anim2_total_sec);
 
-const vector<mat4>& Skeleton::GetFinalBoneTransform() const {
-	return final_bone_transform_;
-}
\ No newline at end of file
+	if (time_in_sec <= trans_begin_time_in_sec)
+	{
+		CalcBoneAnimTransform(anim1, anim1.GetNormalizedTime(time_in_sec), state, scratch, root_transform, job_system);
+	}
+	else if (time_in_sec > trans_begin_time_in_sec && time_in_sec <= anim1_total_sec)
+	{
+		float anim1_normalize_time = anim1.GetNormalizedTime(time_in_sec);
+		float anim2_normalize_time = anim2.GetNormalizedTime(time_in_sec - trans_begin_time_in_sec);
+		float weight = (time_in_sec - trans_begin_time_in_sec) / (anim1_total_sec - trans_begin_time_in_sec);
+
+		SampleLocalPose(anim1, anim1_normalize_time, state, scratch.sample_pose[0], job_system);
+		SampleLocalPose(anim2, anim2_normalize_time, state, scratch.sample_pose[1], job_system);
+		BlendLocalPose(scratch.sample_pose[0], scratch.sample_pose[1], weight, scratch.sample_pose[0]);
+		ComposePose(scratch.sample_pose[0], state, root_transform);
+	}
+	else
+	{
+		CalcBoneAnimTransform(anim2, anim2.GetNormalizedTime(time_in_sec - trans_begin_time_in_sec), state, scratch, root_transform, job_system);
+	}
+}
+
+
+int Skeleton::GetBoneCount() const {
+	return vec_bone_.size();
+}
@@ -1,8 +1,6 @@
 #ifndef SKELETON_H
 #define SKELETON_H
 
-#include <glad/glad.h>
-
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <assimp/Importer.hpp>
@@ -20,42 +18,126 @@ using std::string;
 using std::vector;
 using std::unordered_map;
 
-#include "mesh.h"
+#include "vertex.h"
 #include "animation.h"
+#include "local_pose.h"
+#include "utility/affine_math.h"
+#include "utility/skinning_palette.h"
+#include "utility/job_system.h"
 
 struct Bone
 {
 	const mat4 offset;
-	mat4 transform;
 	int parent_index;
 	string name;
+	// node transform in bind pose, used when an animation has no channel for this bone
+	mat4 bind_local_transform = mat4(1.0f);
+	// bind_local_transform split into translation, rotation and uniform scale
+	vec3 bind_translation = vec3(0.0f);
+	quat bind_rotation = quat(1.0f, 0.0f, 0.0f, 0.0f);
+	float bind_scale = 1.0f;
+
+	Bone(const mat4& _offset, const int& _parent_index, const string& _name) :
+		offset(_offset), parent_index(_parent_index), name(_name) {}
+};
+
+// a complete bone, the form baked model files store skeletons in
+struct BoneData
+{
+	string name;
+	mat4 offset;
+	int parent_index;
+	mat4 bind_local_transform;
+};
+
+// bones of a skeleton resolved to channels of one animation, built once per pair
+// so that sampling needs no string lookup
+struct AnimationBinding
+{
+	// channel index of each bone, kNoChannel if the animation doesn't animate that bone
+	static constexpr int kNoChannel = -1;
+	vector<int> bone_to_channel;
+	// index of this animation's cursor in PoseState::cursors
+	int cursor_slot = 0;
+};
 
-	Bone(const mat4& _offset, const mat4& _transform, const int& _parent_index, const string& _name) :
-		offset(_offset), transform(_transform), parent_index(_parent_index), name(_name) {}
+// mutable pose data of one animated character
+// the skeleton and animations stay shared and read only, so any number of characters can be posed from them
+struct PoseState
+{
+	// playback cursors, one per bound animation
+	vector<AnimationCursor> cursors;
+	vector<Affine3x4> global_transform;
+	vector<Affine3x4> final_affine_transform;
+	// skinning palette
+	vector<mat4> final_bone_transform;
+	// when set, the palette goes there in palette_encoding instead of final_bone_transform, e.g. into a mapped GPU buffer
+	float* palette_target = nullptr;
+	EPaletteEncoding palette_encoding = EPaletteEncoding::eMat4;
+};
+
+// poses a pose evaluation needs only while it runs, one per thread serves any number of characters
+struct PoseScratch
+{
+	LocalPose sample_pose[2];
 };
 
 class Skeleton
 {
 public:
 	Skeleton();
+	// skeleton read back from a baked model file, bones keep their order so vertex bone ids stay valid
+	explicit Skeleton(const vector<BoneData>& bones);
+	vector<BoneData> GetBoneData() const;
 
 	void LoadSkeletonAndRetrieveVertexInfo(const aiMesh* const mesh, vector<Vertex>& vertices);
 	void SetBoneChildToParent(const unordered_map<string, string>& node_parent);
+	void SetBoneBindTransform(const unordered_map<string, mat4>& node_transform);
+	void BindAnimation(const Animation& animation);
+	// pose buffers sized for this skeleton, with a cursor for every bound animation
+	PoseState CreatePoseState() const;
+
+	// splits a world space error bound into per channel key tolerances, bones far from their
+	// descendants get tighter rotation and scale tolerance, so end effectors stay within bound
+	vector<KeyErrorTolerance> CalcChannelErrorTolerance(const Animation& animation, const KeyErrorTolerance& world_tolerance) const;
+	// max distance between bone world positions posed by the two animations, over num_samples times
+	float CalcMaxWorldError(const Animation& reference, const Animation& approx, int num_samples, const mat4& root_transform = mat4(1.0f)) const;
 	Bone GetRootBone() const;
 
-	void CalcBoneAnimTransform(const Animation& animation, float time, const mat4& root_transform = mat4(1.0f));
-	void TransitionAnim(const Animation& anim1, const Animation& anim2, float trans_begin_norm_time, float normalized_time, const mat4& root_transform = mat4(1.0f));
-	void BlendBoneAnimTransform(const Animation& anim1, const Animation& anim2, float normalized_time, float weight, const mat4& root_transform = mat4(1.0f));
-	
-	const vector<mat4>& GetFinalBoneTransform() const;
+	// results go to state.final_bone_transform, or encoded to state.palette_target if set
+	// with a job system, skeletons of at least kParallelSampleBones bones are sampled on all its threads
+	void CalcBoneAnimTransform(const Animation& animation, float time, PoseState& state, PoseScratch& scratch,
+		const mat4& root_transform = mat4(1.0f), JobSystem* job_system = nullptr) const;
+	void TransitionAnim(const Animation& anim1, const Animation& anim2, float trans_begin_norm_time, float normalized_time, PoseState& state, PoseScratch& scratch,
+		const mat4& root_transform = mat4(1.0f), JobSystem* job_system = nullptr) const;
+	void BlendBoneAnimTransform(const Animation& anim1, const Animation& anim2, float normalized_time, float weight, PoseState& state, PoseScratch& scratch,
+		const mat4& root_transform = mat4(1.0f), JobSystem* job_system = nullptr) const;
+	static constexpr int kParallelSampleBones = 256;
+
+	// building blocks of the calls above, for blends of any number of clips:
+	// sample each clip into a pose, blend the poses with BlendLocalPose, compose once
+	void SampleLocalPose(const Animation& animation, float normalized_time, PoseState& state, LocalPose& pose, JobSystem* job_system = nullptr) const;
+	void ComposePose(const LocalPose& pose, PoseState& state, const mat4& root_transform = mat4(1.0f)) const;
+	int GetBoneCount() const;
+
 private:
 	vector<Bone> vec_bone_;
 	unordered_map<string, int> bone_name_to_index_;
 
-	vector<mat4> final_bone_transform_;
+	// hierarchy tables in the layout ComposePoseHierarchy reads, built once bones are complete
+	vector<int> bone_parent_index_;
+	vector<Affine3x4> bone_offset_;
+	void DecomposeBindTransforms();
+	void BuildPoseTables();
+
+	unordered_map<const Animation*, AnimationBinding> anim_bindings_;
+	const AnimationBinding& GetAnimBinding(const Animation& animation) const;
+	AnimationBinding MakeAnimBinding(const Animation& animation) const;
+
+	void SampleBoneLocalTRS(const Animation& animation, const AnimationBinding& binding, AnimationCursor& cursor, int bone_index, float normalized_time,
+		vec3& translation, quat& rotation, float& scale) const;
 
 	void SetVertexBoneInfo(Vertex& vertex, unsigned int bone_index, float weight) const;
-	void CalculateFinalTransform();
 };
 
 #endif
\ No newline at end of file
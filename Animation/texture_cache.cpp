@@ -0,0 +1,58 @@
+#include "texture_cache.h"
+
+#include "utility/file_loader.h"
+
+
+TextureCache& TextureCache::Get() {
+    static TextureCache texture_cache;
+    return texture_cache;
+}
+
+std::shared_ptr<const CachedTexture> TextureCache::Acquire(const string& key, const ImageData& image) {
+    auto iter = entries_.find(key);
+    if (iter != entries_.end())
+    {
+        hits_++;
+        return iter->second;
+    }
+
+    misses_++;
+    auto p_texture = std::make_shared<CachedTexture>();
+    p_texture->id = UploadTexture(image);
+    p_texture->key = key;
+    entries_.emplace(key, p_texture);
+    return p_texture;
+}
+
+int TextureCache::EvictUnused() {
+    int num_evicted = 0;
+    for (auto iter = entries_.begin(); iter != entries_.end();)
+    {
+        if (iter->second.use_count() == 1)
+        {
+            glDeleteTextures(1, &iter->second->id);
+            iter = entries_.erase(iter);
+            num_evicted++;
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+    return num_evicted;
+}
+
+CacheStats TextureCache::GetStats() const {
+    CacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.resident = static_cast<int>(entries_.size());
+    for (const auto& entry : entries_)
+    {
+        if (entry.second.use_count() == 1)
+        {
+            stats.unused++;
+        }
+    }
+    return stats;
+}
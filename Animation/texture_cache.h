@@ -0,0 +1,42 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+using std::string;
+using std::unordered_map;
+
+#include "utility/image_cache.h"
+
+struct CachedTexture
+{
+    unsigned int id;
+    string key;
+};
+
+// process wide cache of GL textures with the keys of ImageCache, so every image is uploaded once
+// models hold a reference to each texture they draw with, a texture no model refers to
+// stays uploaded until EvictUnused deletes it
+// render thread only
+class TextureCache
+{
+public:
+    static TextureCache& Get();
+
+    // returns the texture uploaded for key, uploads image if the key is new
+    std::shared_ptr<const CachedTexture> Acquire(const string& key, const ImageData& image);
+
+    // deletes textures nothing refers to, returns how many were deleted
+    int EvictUnused();
+    CacheStats GetStats() const;
+
+private:
+    TextureCache() = default;
+
+    unordered_map<string, std::shared_ptr<CachedTexture>> entries_;
+    long long hits_ = 0;
+    long long misses_ = 0;
+};
+
+#endif
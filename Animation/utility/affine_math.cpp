@@ -0,0 +1,232 @@
+#include "affine_math.h"
+
+Affine3x4 ToAffine(const mat4& mat) {
+    Affine3x4 affine;
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            affine.rows[r][c] = mat[c][r];
+        }
+    }
+    return affine;
+}
+
+mat4 ToMat4(const Affine3x4& affine) {
+    mat4 mat = mat4(1.0f);
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            mat[c][r] = affine.rows[r][c];
+        }
+    }
+    return mat;
+}
+
+Affine3x4 ComposeTRS(const vec3& translation, const quat& rotation, float scale) {
+    const float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+    const float xx = x * x, yy = y * y, zz = z * z;
+    const float xy = x * y, xz = x * z, yz = y * z;
+    const float wx = w * x, wy = w * y, wz = w * z;
+
+    Affine3x4 affine;
+    affine.rows[0][0] = (1.0f - 2.0f * (yy + zz)) * scale;
+    affine.rows[0][1] = 2.0f * (xy - wz) * scale;
+    affine.rows[0][2] = 2.0f * (xz + wy) * scale;
+    affine.rows[0][3] = translation.x;
+
+    affine.rows[1][0] = 2.0f * (xy + wz) * scale;
+    affine.rows[1][1] = (1.0f - 2.0f * (xx + zz)) * scale;
+    affine.rows[1][2] = 2.0f * (yz - wx) * scale;
+    affine.rows[1][3] = translation.y;
+
+    affine.rows[2][0] = 2.0f * (xz - wy) * scale;
+    affine.rows[2][1] = 2.0f * (yz + wx) * scale;
+    affine.rows[2][2] = (1.0f - 2.0f * (xx + yy)) * scale;
+    affine.rows[2][3] = translation.z;
+    return affine;
+}
+
+#if defined(AFFINE_MATH_AVX2)
+// _MM_TRANSPOSE4_PS in each 128 bit lane
+static inline void TransposeLanes4x4(__m256& r0, __m256& r1, __m256& r2, __m256& r3) {
+    const __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+    const __m256 t1 = _mm256_unpacklo_ps(r2, r3);
+    const __m256 t2 = _mm256_unpackhi_ps(r0, r1);
+    const __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+    r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+    r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+    r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+static inline __m256 LoadLanes(const float* low, const float* high) {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+}
+#endif
+
+void ComposeTRSBatch(int num_bones, const vec3* translations, const quat* rotations, const float* scales, Affine3x4* locals) {
+    int i = 0;
+#if defined(AFFINE_MATH_AVX2) || defined(AFFINE_MATH_SSE)
+    static_assert(sizeof(quat) == 4 * sizeof(float), "quaternions are loaded as 4 packed floats");
+#endif
+#if defined(AFFINE_MATH_AVX2)
+    // 8 bones per AVX register, the low lane holds bones i to i + 3 and the high lane bones i + 4 to i + 7,
+    // so each lane is transposed like the SSE loop below does it
+    const __m256 one8 = _mm256_set1_ps(1.0f);
+    const __m256 two8 = _mm256_set1_ps(2.0f);
+    for (; i + 8 <= num_bones; i += 8)
+    {
+        const float* q = reinterpret_cast<const float*>(rotations + i);
+        __m256 q0 = LoadLanes(q, q + 16);
+        __m256 q1 = LoadLanes(q + 4, q + 20);
+        __m256 q2 = LoadLanes(q + 8, q + 24);
+        __m256 q3 = LoadLanes(q + 12, q + 28);
+        TransposeLanes4x4(q0, q1, q2, q3);
+#if defined(GLM_FORCE_QUAT_DATA_WXYZ)
+        const __m256 w = q0, x = q1, y = q2, z = q3;
+#else
+        const __m256 x = q0, y = q1, z = q2, w = q3;
+#endif
+        const __m256 scale = _mm256_loadu_ps(scales + i);
+        const vec3* t = translations + i;
+
+        const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+        __m256 rows[3][4];
+        rows[0][0] = _mm256_mul_ps(_mm256_sub_ps(one8, _mm256_mul_ps(two8, _mm256_add_ps(yy, zz))), scale);
+        rows[0][1] = _mm256_mul_ps(_mm256_mul_ps(two8, _mm256_sub_ps(xy, wz)), scale);
+        rows[0][2] = _mm256_mul_ps(_mm256_mul_ps(two8, _mm256_add_ps(xz, wy)), scale);
+        rows[0][3] = _mm256_set_ps(t[7].x, t[6].x, t[5].x, t[4].x, t[3].x, t[2].x, t[1].x, t[0].x);
+
+        rows[1][0] = _mm256_mul_ps(_mm256_mul_ps(two8, _mm256_add_ps(xy, wz)), scale);
+        rows[1][1] = _mm256_mul_ps(_mm256_sub_ps(one8, _mm256_mul_ps(two8, _mm256_add_ps(xx, zz))), scale);
+        rows[1][2] = _mm256_mul_ps(_mm256_mul_ps(two8, _mm256_sub_ps(yz, wx)), scale);
+        rows[1][3] = _mm256_set_ps(t[7].y, t[6].y, t[5].y, t[4].y, t[3].y, t[2].y, t[1].y, t[0].y);
+
+        rows[2][0] = _mm256_mul_ps(_mm256_mul_ps(two8, _mm256_sub_ps(xz, wy)), scale);
+        rows[2][1] = _mm256_mul_ps(_mm256_mul_ps(two8, _mm256_add_ps(yz, wx)), scale);
+        rows[2][2] = _mm256_mul_ps(_mm256_sub_ps(one8, _mm256_mul_ps(two8, _mm256_add_ps(xx, yy))), scale);
+        rows[2][3] = _mm256_set_ps(t[7].z, t[6].z, t[5].z, t[4].z, t[3].z, t[2].z, t[1].z, t[0].z);
+
+        // after the transpose rows[r][k] holds row r of bone i + k in its low lane and of bone i + 4 + k in its high lane
+        for (int r = 0; r < 3; r++)
+        {
+            TransposeLanes4x4(rows[r][0], rows[r][1], rows[r][2], rows[r][3]);
+            for (int k = 0; k < 4; k++)
+            {
+                _mm_store_ps(locals[i + k].rows[r], _mm256_castps256_ps128(rows[r][k]));
+                _mm_store_ps(locals[i + 4 + k].rows[r], _mm256_extractf128_ps(rows[r][k], 1));
+            }
+        }
+    }
+#endif
+#if defined(AFFINE_MATH_AVX2) || defined(AFFINE_MATH_SSE)
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    for (; i + 4 <= num_bones; i += 4)
+    {
+        const float* q = reinterpret_cast<const float*>(rotations + i);
+        __m128 q0 = _mm_loadu_ps(q);
+        __m128 q1 = _mm_loadu_ps(q + 4);
+        __m128 q2 = _mm_loadu_ps(q + 8);
+        __m128 q3 = _mm_loadu_ps(q + 12);
+        _MM_TRANSPOSE4_PS(q0, q1, q2, q3);
+#if defined(GLM_FORCE_QUAT_DATA_WXYZ)
+        const __m128 w = q0, x = q1, y = q2, z = q3;
+#else
+        const __m128 x = q0, y = q1, z = q2, w = q3;
+#endif
+        const __m128 scale = _mm_loadu_ps(scales + i);
+
+        const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        // the same operations in the same order as ComposeTRS
+        __m128 rows[3][4];
+        rows[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scale);
+        rows[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scale);
+        rows[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scale);
+        rows[0][3] = _mm_set_ps(translations[i + 3].x, translations[i + 2].x, translations[i + 1].x, translations[i].x);
+
+        rows[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scale);
+        rows[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scale);
+        rows[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scale);
+        rows[1][3] = _mm_set_ps(translations[i + 3].y, translations[i + 2].y, translations[i + 1].y, translations[i].y);
+
+        rows[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scale);
+        rows[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scale);
+        rows[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scale);
+        rows[2][3] = _mm_set_ps(translations[i + 3].z, translations[i + 2].z, translations[i + 1].z, translations[i].z);
+
+        // each register holds one element of 4 bones, transposed they are row r of each bone
+        for (int r = 0; r < 3; r++)
+        {
+            _MM_TRANSPOSE4_PS(rows[r][0], rows[r][1], rows[r][2], rows[r][3]);
+            _mm_store_ps(locals[i].rows[r], rows[r][0]);
+            _mm_store_ps(locals[i + 1].rows[r], rows[r][1]);
+            _mm_store_ps(locals[i + 2].rows[r], rows[r][2]);
+            _mm_store_ps(locals[i + 3].rows[r], rows[r][3]);
+        }
+    }
+#endif
+    for (; i < num_bones; i++)
+    {
+        locals[i] = ComposeTRS(translations[i], rotations[i], scales[i]);
+    }
+}
+
+// row r of a * b = sum of a[r][k] * row k of b, plus a[r][3] * (0, 0, 0, 1)
+Affine3x4 MultiplyAffine(const Affine3x4& a, const Affine3x4& b) {
+    Affine3x4 result;
+#if defined(AFFINE_MATH_AVX2) || defined(AFFINE_MATH_SSE)
+    const __m128 b0 = _mm_load_ps(b.rows[0]);
+    const __m128 b1 = _mm_load_ps(b.rows[1]);
+    const __m128 b2 = _mm_load_ps(b.rows[2]);
+    const __m128 w_axis = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+    for (int r = 0; r < 3; r++)
+    {
+        const __m128 a_row = _mm_load_ps(a.rows[r]);
+        const __m128 a0 = _mm_shuffle_ps(a_row, a_row, _MM_SHUFFLE(0, 0, 0, 0));
+        const __m128 a1 = _mm_shuffle_ps(a_row, a_row, _MM_SHUFFLE(1, 1, 1, 1));
+        const __m128 a2 = _mm_shuffle_ps(a_row, a_row, _MM_SHUFFLE(2, 2, 2, 2));
+        const __m128 a3 = _mm_shuffle_ps(a_row, a_row, _MM_SHUFFLE(3, 3, 3, 3));
+#if defined(AFFINE_MATH_AVX2)
+        __m128 row = _mm_mul_ps(a3, w_axis);
+        row = _mm_fmadd_ps(a0, b0, row);
+        row = _mm_fmadd_ps(a1, b1, row);
+        row = _mm_fmadd_ps(a2, b2, row);
+#else
+        __m128 row = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, b0), _mm_mul_ps(a1, b1)),
+            _mm_add_ps(_mm_mul_ps(a2, b2), _mm_mul_ps(a3, w_axis)));
+#endif
+        _mm_store_ps(result.rows[r], row);
+    }
+#else
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            result.rows[r][c] = a.rows[r][0] * b.rows[0][c] + a.rows[r][1] * b.rows[1][c] + a.rows[r][2] * b.rows[2][c];
+        }
+        result.rows[r][3] += a.rows[r][3];
+    }
+#endif
+    return result;
+}
+
+void ComposePoseHierarchy(int num_bones, const vec3* translations, const quat* rotations, const float* scales,
+    const int* parent_indices, const Affine3x4& root, const Affine3x4* offsets, Affine3x4* globals, Affine3x4* finals) {
+    // locals go to globals first, each is replaced by its global once its parent's is done
+    ComposeTRSBatch(num_bones, translations, rotations, scales, globals);
+    for (int i = 0; i < num_bones; i++)
+    {
+        const Affine3x4& parent = parent_indices[i] >= 0 ? globals[parent_indices[i]] : root;
+        globals[i] = MultiplyAffine(parent, globals[i]);
+        finals[i] = MultiplyAffine(globals[i], offsets[i]);
+    }
+}
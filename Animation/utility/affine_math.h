@@ -0,0 +1,49 @@
+#ifndef AFFINE_MATH_H
+#define AFFINE_MATH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+using glm::mat4;
+using glm::quat;
+using glm::vec3;
+
+// SIMD path is picked at compile time, see the ReleaseAVX2 configuration: AVX2 builds compose
+// 8 bones per register and multiply with FMA, SSE builds compose 4 bones per register
+// GCC and Clang only define __FMA__ with -mfma, MSVC's /arch:AVX2 implies FMA without defining it
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define AFFINE_MATH_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AFFINE_MATH_SSE
+#include <emmintrin.h>
+#endif
+
+// affine transform without its constant last row (0, 0, 0, 1),
+// stored row major so that one row fills one SSE register
+struct alignas(16) Affine3x4
+{
+    float rows[3][4];
+};
+
+Affine3x4 ToAffine(const mat4& mat);
+mat4 ToMat4(const Affine3x4& affine);
+
+// translate * rotate * uniform scale, written out directly instead of multiplying three mat4
+Affine3x4 ComposeTRS(const vec3& translation, const quat& rotation, float scale);
+
+// ComposeTRS of every bone, 8 bones per AVX register or 4 per SSE register: their quaternions are
+// transposed into x, y, z and w registers, and the 3x4s transposed back a row at a time, the rest go one by one
+// the operations are ComposeTRS's in the same order, but the compiler may fuse a multiply and add
+// differently in each path (GCC contracts to FMA by default under -mfma), so results can differ from ComposeTRS's in the last bits
+void ComposeTRSBatch(int num_bones, const vec3* translations, const quat* rotations, const float* scales, Affine3x4* locals);
+
+// a * b
+Affine3x4 MultiplyAffine(const Affine3x4& a, const Affine3x4& b);
+
+// composes a whole pose: local TRS of every bone to affine with ComposeTRSBatch, then
+// global = parent global * local and final = global * offset (inverse bind pose)
+// parent index must be smaller than child index, -1 means the bone's parent is root
+void ComposePoseHierarchy(int num_bones, const vec3* translations, const quat* rotations, const float* scales,
+    const int* parent_indices, const Affine3x4& root, const Affine3x4* offsets, Affine3x4* globals, Affine3x4* finals);
+
+#endif
@@ -0,0 +1,148 @@
+#include "image_cache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <vector>
+using std::vector;
+
+#ifdef _WIN32
+#include <direct.h>
+#define getcwd _getcwd
+#else
+#include <unistd.h>
+#endif
+
+
+ImageCache& ImageCache::Get() {
+    static ImageCache image_cache;
+    return image_cache;
+}
+
+std::shared_ptr<const ImageData> ImageCache::Acquire(const string& key, const std::function<void(ImageData&)>& decode) {
+    std::shared_ptr<Entry> p_entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = entries_.find(key);
+        if (iter != entries_.end())
+        {
+            p_entry = iter->second;
+            hits_++;
+        }
+        else
+        {
+            p_entry = std::make_shared<Entry>();
+            entries_.emplace(key, p_entry);
+            misses_++;
+        }
+    }
+
+    // decoding holds only this entry's lock, other keys decode in parallel
+    std::lock_guard<std::mutex> lock(p_entry->decode_mutex);
+    if (p_entry->decoded == false)
+    {
+        decode(*p_entry->p_image);
+        p_entry->decoded = true;
+    }
+    return p_entry->p_image;
+}
+
+int ImageCache::EvictUnused() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int num_evicted = 0;
+    for (auto iter = entries_.begin(); iter != entries_.end();)
+    {
+        // the entry's own pointer is the only one left
+        if (iter->second->decoded && iter->second->p_image.use_count() == 1)
+        {
+            iter = entries_.erase(iter);
+            num_evicted++;
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+    return num_evicted;
+}
+
+CacheStats ImageCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.resident = static_cast<int>(entries_.size());
+    for (const auto& entry : entries_)
+    {
+        if (entry.second->decoded && entry.second->p_image.use_count() == 1)
+        {
+            stats.unused++;
+        }
+    }
+    return stats;
+}
+
+
+string NormalizeImagePath(const string& path) {
+    string full_path = path;
+    std::replace(full_path.begin(), full_path.end(), '\\', '/');
+
+    bool is_absolute = full_path.empty() == false && (full_path[0] == '/' || (full_path.size() > 1 && full_path[1] == ':'));
+    if (is_absolute == false)
+    {
+        char current_dir[4096];
+        if (getcwd(current_dir, sizeof(current_dir)) != nullptr)
+        {
+            string prefix = current_dir;
+            std::replace(prefix.begin(), prefix.end(), '\\', '/');
+            full_path = prefix + '/' + full_path;
+        }
+    }
+
+    // resolve "." and ".." segments, drop empty ones
+    vector<string> segments;
+    size_t begin = 0;
+    while (begin <= full_path.size())
+    {
+        size_t end = full_path.find('/', begin);
+        if (end == string::npos) end = full_path.size();
+        string segment = full_path.substr(begin, end - begin);
+        if (segment == "..")
+        {
+            if (segments.empty() == false) segments.pop_back();
+        }
+        else if (segment.empty() == false && segment != ".")
+        {
+            segments.push_back(segment);
+        }
+        begin = end + 1;
+    }
+
+    // a drive letter keeps the path from starting with '/'
+    bool starts_with_slash = full_path.empty() == false && full_path[0] == '/';
+    string normalized;
+    for (int i = 0; i < segments.size(); i++)
+    {
+        if (i > 0 || starts_with_slash) normalized += '/';
+        normalized += segments[i];
+    }
+
+#ifdef _WIN32
+    std::transform(normalized.begin(), normalized.end(), normalized.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+#endif
+    return normalized;
+}
+
+string EmbeddedImageKey(const unsigned char* data, size_t data_size) {
+    // 64 bit FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < data_size; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+
+    char key[64];
+    snprintf(key, sizeof(key), "embedded:%016llx:%zu", static_cast<unsigned long long>(hash), data_size);
+    return key;
+}
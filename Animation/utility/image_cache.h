@@ -0,0 +1,63 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+using std::string;
+using std::unordered_map;
+
+#include "image_data.h"
+
+struct CacheStats
+{
+    long long hits = 0;
+    long long misses = 0;
+    // entries in the cache, and how many of them nothing refers to anymore
+    int resident = 0;
+    int unused = 0;
+};
+
+// process wide cache of decoded images, so a model loaded several times decodes each image once
+// images are shared by reference counting, an image nothing refers to stays cached until EvictUnused
+// thread safe, images are acquired from the decode worker threads
+class ImageCache
+{
+public:
+    static ImageCache& Get();
+
+    // returns the image cached for key, decode fills it if the key is new
+    // callers acquiring a key that is being decoded wait for that decode instead of decoding again
+    std::shared_ptr<const ImageData> Acquire(const string& key, const std::function<void(ImageData&)>& decode);
+
+    // drops images nothing refers to, returns how many were dropped
+    int EvictUnused();
+    CacheStats GetStats() const;
+
+private:
+    ImageCache() = default;
+
+    struct Entry
+    {
+        std::mutex decode_mutex;
+        bool decoded = false;
+        std::shared_ptr<ImageData> p_image = std::make_shared<ImageData>();
+    };
+
+    mutable std::mutex mutex_;
+    unordered_map<string, std::shared_ptr<Entry>> entries_;
+    std::atomic<long long> hits_{ 0 };
+    std::atomic<long long> misses_{ 0 };
+};
+
+// cache key of an image file: absolute path with '/' separators and without "." and ".." segments,
+// lower case on Windows where paths are case insensitive
+string NormalizeImagePath(const string& path);
+// cache key of an image embedded in a model file, from its content
+string EmbeddedImageKey(const unsigned char* data, size_t data_size);
+
+#endif
@@ -0,0 +1,114 @@
+#include "image_data.h"
+
+#include <algorithm>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+
+int ImageData::GetLevelCount() const {
+    if (mip_pixels.empty())
+    {
+        return 1;
+    }
+    int num_levels = 1;
+    while ((width >> num_levels) > 0 || (height >> num_levels) > 0)
+    {
+        num_levels++;
+    }
+    return num_levels;
+}
+
+int ImageData::GetLevelWidth(int level) const {
+    return std::max(width >> level, 1);
+}
+
+int ImageData::GetLevelHeight(int level) const {
+    return std::max(height >> level, 1);
+}
+
+const unsigned char* ImageData::GetLevelData(int level) const {
+    if (level == 0)
+    {
+        return pixels.data();
+    }
+    size_t offset = 0;
+    for (int i = 1; i < level; i++)
+    {
+        offset += static_cast<size_t>(GetLevelWidth(i)) * GetLevelHeight(i) * components;
+    }
+    return mip_pixels.data() + offset;
+}
+
+
+static bool TakeDecodedImage(unsigned char* data, int width, int height, int components, ImageData& image) {
+    image = ImageData();
+    if (data == nullptr)
+    {
+        return false;
+    }
+
+    image.width = width;
+    image.height = height;
+    image.components = components;
+    image.pixels.assign(data, data + static_cast<size_t>(width) * height * components);
+    stbi_image_free(data);
+    return true;
+}
+
+bool DecodeImageFile(const string& path, ImageData& image) {
+    int width, height, components;
+    unsigned char* data = stbi_load(path.c_str(), &width, &height, &components, 0);
+    return TakeDecodedImage(data, width, height, components, image);
+}
+
+bool DecodeImageMemory(const unsigned char* data, int data_size, ImageData& image) {
+    int width, height, components;
+    unsigned char* image_data = stbi_load_from_memory(data, data_size, &width, &height, &components, 0);
+    return TakeDecodedImage(image_data, width, height, components, image);
+}
+
+void BuildMipChain(ImageData& image) {
+    image.mip_pixels.clear();
+    if (image.IsValid() == false || (image.width <= 1 && image.height <= 1))
+    {
+        return;
+    }
+
+    size_t mip_size = 0;
+    for (int level = 1; (image.width >> level) > 0 || (image.height >> level) > 0; level++)
+    {
+        mip_size += static_cast<size_t>(image.GetLevelWidth(level)) * image.GetLevelHeight(level) * image.components;
+    }
+    image.mip_pixels.resize(mip_size);
+
+    const int components = image.components;
+    const unsigned char* src = image.pixels.data();
+    unsigned char* dst = image.mip_pixels.data();
+    int src_width = image.width;
+    int src_height = image.height;
+    while (src_width > 1 || src_height > 1)
+    {
+        int dst_width = std::max(src_width >> 1, 1);
+        int dst_height = std::max(src_height >> 1, 1);
+        for (int y = 0; y < dst_height; y++)
+        {
+            const unsigned char* row0 = src + static_cast<size_t>(std::min(y * 2, src_height - 1)) * src_width * components;
+            const unsigned char* row1 = src + static_cast<size_t>(std::min(y * 2 + 1, src_height - 1)) * src_width * components;
+            for (int x = 0; x < dst_width; x++)
+            {
+                int x0 = std::min(x * 2, src_width - 1) * components;
+                int x1 = std::min(x * 2 + 1, src_width - 1) * components;
+                for (int c = 0; c < components; c++)
+                {
+                    dst[(static_cast<size_t>(y) * dst_width + x) * components + c] =
+                        static_cast<unsigned char>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+                }
+            }
+        }
+        src = dst;
+        dst += static_cast<size_t>(dst_width) * dst_height * components;
+        src_width = dst_width;
+        src_height = dst_height;
+    }
+}
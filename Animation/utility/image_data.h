@@ -0,0 +1,36 @@
+#ifndef IMAGE_DATA_H
+#define IMAGE_DATA_H
+
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+// 8 bit image decoded on the CPU, ready to be uploaded to GL
+struct ImageData
+{
+    int width = 0;
+    int height = 0;
+    // channels per pixel, 1 to 4
+    int components = 0;
+    vector<unsigned char> pixels;
+    // levels 1 and up of a mip chain built on the CPU, back to back down to 1x1
+    // empty if GL is to generate the mips at upload
+    vector<unsigned char> mip_pixels;
+
+    bool IsValid() const { return pixels.empty() == false; }
+    // 1 without a CPU mip chain
+    int GetLevelCount() const;
+    int GetLevelWidth(int level) const;
+    int GetLevelHeight(int level) const;
+    const unsigned char* GetLevelData(int level) const;
+};
+
+// no GL call and no shared state, so images can be decoded on any thread
+// they return false and leave image empty if the file or data can't be decoded
+bool DecodeImageFile(const string& path, ImageData& image);
+bool DecodeImageMemory(const unsigned char* data, int data_size, ImageData& image);
+// fills image.mip_pixels, every texel of a level averages 2x2 texels of the level above (edge texels repeat)
+void BuildMipChain(ImageData& image);
+
+#endif
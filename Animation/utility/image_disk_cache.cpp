@@ -0,0 +1,359 @@
+#include "image_disk_cache.h"
+
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+using std::vector;
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+#endif
+
+
+namespace
+{
+    constexpr char kEntryMagic[8] = { 'A', 'N', 'I', 'M', 'I', 'M', 'G', '\0' };
+    // bump when EntryHeader or the level layout changes
+    constexpr uint32_t kEntryVersion = 1;
+    constexpr char kEntryExtension[] = ".img";
+    constexpr size_t kEntryAlignment = 16;
+
+    // entry = EntryHeader, the key, then from data_offset the level 0 pixels followed by the mip pixels
+    struct EntryHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t key_size;
+        // 0 for embedded images
+        int64_t source_mtime;
+        uint64_t source_size;
+        int32_t width;
+        int32_t height;
+        int32_t components;
+        int32_t padding;
+        uint64_t data_offset;
+        uint64_t pixels_size;
+        uint64_t mip_pixels_size;
+    };
+
+    struct EntryFile
+    {
+        string path;
+        uint64_t size;
+        int64_t mtime;
+    };
+
+#ifdef _WIN32
+    // 1970-01-01 in FILETIME ticks
+    constexpr int64_t kFileTimeUnixEpoch = 116444736000000000LL;
+#endif
+
+    // mtime in ns since 1970, whole seconds would make entries written in the same second tie for least recently used
+    bool GetFileStamp(const string& path, int64_t& mtime, uint64_t& size) {
+#ifdef _WIN32
+        WIN32_FILE_ATTRIBUTE_DATA info;
+        if (GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info) == 0) return false;
+        // 100 ns ticks since 1601, rebased to 1970 first so the scale to ns can't overflow
+        int64_t ticks = (static_cast<int64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+        mtime = (ticks - kFileTimeUnixEpoch) * 100;
+        size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+#else
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) return false;
+        mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+        size = static_cast<uint64_t>(info.st_size);
+#endif
+        return true;
+    }
+
+    // a hit makes the entry the most recently used one
+    void TouchFile(const string& path) {
+#ifdef _WIN32
+        _utime(path.c_str(), nullptr);
+#else
+        utime(path.c_str(), nullptr);
+#endif
+    }
+
+    void MakeDirectories(const string& directory) {
+        for (size_t end = directory.find_first_of("/\\", 1); ; end = directory.find_first_of("/\\", end + 1))
+        {
+            string parent = directory.substr(0, end);
+#ifdef _WIN32
+            _mkdir(parent.c_str());
+#else
+            mkdir(parent.c_str(), 0755);
+#endif
+            if (end == string::npos) break;
+        }
+    }
+
+    vector<EntryFile> ListEntries(const string& directory) {
+        vector<EntryFile> entries;
+        auto add_entry = [&](const string& name) {
+            size_t extension_length = strlen(kEntryExtension);
+            if (name.size() <= extension_length || name.compare(name.size() - extension_length, extension_length, kEntryExtension) != 0) return;
+
+            EntryFile entry;
+            entry.path = directory + '/' + name;
+            if (GetFileStamp(entry.path, entry.mtime, entry.size))
+            {
+                entries.push_back(entry);
+            }
+        };
+
+#ifdef _WIN32
+        WIN32_FIND_DATAA find_data;
+        HANDLE find_handle = FindFirstFileA((directory + "/*").c_str(), &find_data);
+        if (find_handle == INVALID_HANDLE_VALUE) return entries;
+        do
+        {
+            add_entry(find_data.cFileName);
+        } while (FindNextFileA(find_handle, &find_data));
+        FindClose(find_handle);
+#else
+        DIR* dir = opendir(directory.c_str());
+        if (dir == nullptr) return entries;
+        while (dirent* p_entry = readdir(dir))
+        {
+            add_entry(p_entry->d_name);
+        }
+        closedir(dir);
+#endif
+        return entries;
+    }
+}
+
+
+ImageDiskCache& ImageDiskCache::Get() {
+    static ImageDiskCache disk_cache;
+    return disk_cache;
+}
+
+void ImageDiskCache::SetDirectory(const string& directory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    directory_ = directory;
+    if (directory_.empty() == false)
+    {
+        MakeDirectories(directory_);
+    }
+    ScanDirectory();
+}
+
+const string& ImageDiskCache::GetDirectory() const {
+    return directory_;
+}
+
+bool ImageDiskCache::IsEnabled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return directory_.empty() == false;
+}
+
+void ImageDiskCache::SetMaxBytes(size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_bytes_ = max_bytes;
+}
+
+bool ImageDiskCache::Load(const string& key, const string& source_path, ImageData& image) {
+    if (IsEnabled() == false) return false;
+
+    int64_t source_mtime = 0;
+    uint64_t source_size = 0;
+    int64_t entry_mtime;
+    uint64_t entry_size;
+    string path = GetEntryPath(key);
+    if ((source_path.empty() == false && GetFileStamp(source_path, source_mtime, source_size) == false)
+        || GetFileStamp(path, entry_mtime, entry_size) == false || entry_size < sizeof(EntryHeader))
+    {
+        misses_++;
+        return false;
+    }
+
+    try
+    {
+        MappedFile file(path);
+        if (file.GetSize() < sizeof(EntryHeader))
+        {
+            misses_++;
+            return false;
+        }
+        const EntryHeader& header = *reinterpret_cast<const EntryHeader*>(file.GetData());
+        const char* entry_key = reinterpret_cast<const char*>(file.GetData() + sizeof(EntryHeader));
+        bool valid = memcmp(header.magic, kEntryMagic, sizeof(kEntryMagic)) == 0 && header.version == kEntryVersion
+            && header.source_mtime == source_mtime && header.source_size == source_size
+            && sizeof(EntryHeader) + header.key_size <= file.GetSize() && key.compare(0, string::npos, entry_key, header.key_size) == 0
+            && header.data_offset <= file.GetSize() && header.pixels_size + header.mip_pixels_size <= file.GetSize() - header.data_offset
+            && header.pixels_size == static_cast<uint64_t>(header.width) * header.height * header.components;
+        if (valid == false)
+        {
+            // an older version of the image or a hash collision, Store replaces it
+            misses_++;
+            return false;
+        }
+
+        const unsigned char* data = file.GetData() + header.data_offset;
+        image.width = header.width;
+        image.height = header.height;
+        image.components = header.components;
+        image.pixels.assign(data, data + header.pixels_size);
+        image.mip_pixels.assign(data + header.pixels_size, data + header.pixels_size + header.mip_pixels_size);
+    }
+    catch (string)
+    {
+        misses_++;
+        return false;
+    }
+
+    TouchFile(path);
+    hits_++;
+    return true;
+}
+
+void ImageDiskCache::Store(const string& key, const string& source_path, const ImageData& image) {
+    if (IsEnabled() == false || image.IsValid() == false) return;
+
+    EntryHeader header = {};
+    memcpy(header.magic, kEntryMagic, sizeof(kEntryMagic));
+    header.version = kEntryVersion;
+    header.key_size = static_cast<uint32_t>(key.size());
+    if (source_path.empty() == false && GetFileStamp(source_path, header.source_mtime, header.source_size) == false)
+    {
+        return;
+    }
+    header.width = image.width;
+    header.height = image.height;
+    header.components = image.components;
+    header.data_offset = (sizeof(EntryHeader) + key.size() + kEntryAlignment - 1) / kEntryAlignment * kEntryAlignment;
+    header.pixels_size = image.pixels.size();
+    header.mip_pixels_size = image.mip_pixels.size();
+
+    // written next to the entry and renamed over it, so a reader never maps a partial entry
+    string path = GetEntryPath(key);
+    string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        vector<char> padding(header.data_offset - sizeof(EntryHeader) - key.size(), 0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(key.data(), key.size());
+        out.write(padding.data(), padding.size());
+        out.write(reinterpret_cast<const char*>(image.pixels.data()), image.pixels.size());
+        out.write(reinterpret_cast<const char*>(image.mip_pixels.data()), image.mip_pixels.size());
+        if (!out)
+        {
+            out.close();
+            std::remove(temp_path.c_str());
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t old_mtime;
+    uint64_t old_size;
+    if (GetFileStamp(path, old_mtime, old_size))
+    {
+        std::remove(path.c_str());
+        size_bytes_ -= std::min<size_t>(old_size, size_bytes_);
+        num_files_--;
+    }
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temp_path.c_str());
+        return;
+    }
+    size_bytes_ += header.data_offset + header.pixels_size + header.mip_pixels_size;
+    num_files_++;
+    writes_++;
+
+    if (size_bytes_ > max_bytes_)
+    {
+        TrimLocked(max_bytes_, path);
+    }
+}
+
+int ImageDiskCache::Trim(size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return TrimLocked(max_bytes, string());
+}
+
+int ImageDiskCache::TrimLocked(size_t max_bytes, const string& keep_path) {
+    if (directory_.empty()) return 0;
+
+    // modification time is the last hit, see TouchFile
+    vector<EntryFile> entries = ListEntries(directory_);
+    std::sort(entries.begin(), entries.end(), [](const EntryFile& a, const EntryFile& b) { return a.mtime < b.mtime; });
+
+    size_t total_size = 0;
+    for (const EntryFile& entry : entries)
+    {
+        total_size += entry.size;
+    }
+
+    int num_deleted = 0;
+    for (const EntryFile& entry : entries)
+    {
+        if (total_size <= max_bytes) break;
+        if (entry.path == keep_path) continue;
+        // fails on Windows while another thread has the entry mapped, it is deleted next time
+        if (std::remove(entry.path.c_str()) == 0)
+        {
+            total_size -= entry.size;
+            num_deleted++;
+        }
+    }
+
+    evictions_ += num_deleted;
+    ScanDirectory();
+    return num_deleted;
+}
+
+DiskCacheStats ImageDiskCache::GetStats() const {
+    DiskCacheStats stats;
+    stats.hits = hits_.load();
+    stats.misses = misses_.load();
+    stats.writes = writes_.load();
+    stats.evictions = evictions_.load();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.files = num_files_;
+    stats.size_bytes = size_bytes_;
+    return stats;
+}
+
+string ImageDiskCache::GetEntryPath(const string& key) const {
+    // 64 bit FNV-1a, entries store their key to tell collisions apart
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    std::lock_guard<std::mutex> lock(mutex_);
+    return directory_ + '/' + name + kEntryExtension;
+}
+
+void ImageDiskCache::ScanDirectory() {
+    size_bytes_ = 0;
+    num_files_ = 0;
+    if (directory_.empty()) return;
+
+    for (const EntryFile& entry : ListEntries(directory_))
+    {
+        size_bytes_ += entry.size;
+        num_files_++;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef IMAGE_DISK_CACHE_H
+#define IMAGE_DISK_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+using std::string;
+
+#include "image_data.h"
+
+struct DiskCacheStats
+{
+    long long hits = 0;
+    long long misses = 0;
+    long long writes = 0;
+    long long evictions = 0;
+    int files = 0;
+    size_t size_bytes = 0;
+};
+
+// decoded images with their mip chains, kept on disk between runs so unchanged images skip
+// both decode and mip generation, an entry is a small header and the raw levels, read with one mapping
+// entries are keyed by ImageCache keys, file images are also stamped with their size and modification time,
+// an entry of an image changed since is replaced
+// disabled until SetDirectory, thread safe, decode workers read and write entries concurrently
+class ImageDiskCache
+{
+public:
+    static constexpr size_t kDefaultMaxBytes = 512 * 1024 * 1024;
+
+    static ImageDiskCache& Get();
+
+    // creates directory if needed, an empty directory disables the cache
+    void SetDirectory(const string& directory);
+    const string& GetDirectory() const;
+    bool IsEnabled() const;
+    // least recently used entries are deleted once the entries take more than this
+    void SetMaxBytes(size_t max_bytes);
+
+    // source_path is the image file, empty for images embedded in a model, whose keys come from their content
+    bool Load(const string& key, const string& source_path, ImageData& image);
+    void Store(const string& key, const string& source_path, const ImageData& image);
+
+    // deletes least recently used entries until the rest fit in max_bytes, returns how many were deleted
+    int Trim(size_t max_bytes);
+    DiskCacheStats GetStats() const;
+
+private:
+    ImageDiskCache() = default;
+
+    string GetEntryPath(const string& key) const;
+    // the ones below expect mutex_ to be held
+    int TrimLocked(size_t max_bytes, const string& keep_path);
+    // sums the sizes of the entries in the directory
+    void ScanDirectory();
+
+    string directory_;
+    size_t max_bytes_ = kDefaultMaxBytes;
+    // guards directory_, size_bytes_, num_files_ and deleting entries
+    mutable std::mutex mutex_;
+    size_t size_bytes_ = 0;
+    int num_files_ = 0;
+
+    std::atomic<long long> hits_{ 0 };
+    std::atomic<long long> misses_{ 0 };
+    std::atomic<long long> writes_{ 0 };
+    std::atomic<long long> evictions_{ 0 };
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <string>
+using std::string;
+
+namespace
+{
+    // index of the worker running on this thread, threads that don't belong to a pool act as worker 0
+    thread_local int t_worker_index = 0;
+}
+
+
+JobSystem::JobSystem(int num_threads) {
+    if (num_threads <= 0)
+    {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        queues_.push_back(std::make_unique<JobQueue>());
+    }
+    // worker 0 is the thread driving the pool
+    for (int i = 1; i < num_threads; i++)
+    {
+        threads_.emplace_back(&JobSystem::WorkerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        quit_ = true;
+    }
+    wake_condition_.notify_all();
+
+    for (auto& thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+int JobSystem::GetThreadCount() const {
+    return queues_.size();
+}
+
+int JobSystem::GetCurrentWorkerIndex() const {
+    return t_worker_index;
+}
+
+
+void JobSystem::Submit(JobCounter& counter, JobFunction func, void* data, int begin, int end) {
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+    JobQueue& queue = *queues_[GetCurrentWorkerIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back({ func, data, begin, end, &counter });
+    }
+
+    num_queued_jobs_.fetch_add(1, std::memory_order_release);
+    if (threads_.empty() == false)
+    {
+        // taking the lock orders this wake up after a sleeping worker's last check
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        wake_condition_.notify_one();
+    }
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+    int worker_index = GetCurrentWorkerIndex();
+    while (counter.pending.load(std::memory_order_acquire) > 0)
+    {
+        // help instead of blocking, the jobs waited for may sit in this thread's own queue
+        if (TryRunJob(worker_index) == false)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+
+void JobSystem::WorkerLoop(int worker_index) {
+    t_worker_index = worker_index;
+
+    while (true)
+    {
+        if (TryRunJob(worker_index)) continue;
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wake_condition_.wait(lock, [this] {
+            return quit_ || num_queued_jobs_.load(std::memory_order_acquire) > 0;
+            });
+        if (quit_) return;
+    }
+}
+
+bool JobSystem::TryRunJob(int worker_index) {
+    Job job;
+    if (PopJob(worker_index, job) == false && StealJob(worker_index, job) == false)
+    {
+        return false;
+    }
+
+    num_queued_jobs_.fetch_sub(1, std::memory_order_relaxed);
+    job.func(job.data, job.begin, job.end, worker_index);
+    job.counter->pending.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+bool JobSystem::PopJob(int worker_index, Job& job) {
+    JobQueue& queue = *queues_[worker_index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) return false;
+
+    // newest job, its data is most likely still in cache
+    job = queue.jobs.back();
+    queue.jobs.pop_back();
+    return true;
+}
+
+bool JobSystem::StealJob(int worker_index, Job& job) {
+    int num_queues = queues_.size();
+    for (int i = 1; i < num_queues; i++)
+    {
+        JobQueue& queue = *queues_[(worker_index + i) % num_queues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) continue;
+
+        // oldest job, for split ranges that is the biggest one
+        job = queue.jobs.front();
+        queue.jobs.pop_front();
+        return true;
+    }
+    return false;
+}
+
+
+int TaskGraph::AddTask(Task task, const vector<int>& dependencies) {
+    int task_id = nodes_.size();
+    nodes_.push_back(std::make_unique<TaskNode>());
+    nodes_.back()->task = std::move(task);
+    nodes_.back()->num_dependencies = dependencies.size();
+
+    for (int dependency : dependencies)
+    {
+        if (dependency < 0 || dependency >= task_id)
+        {
+            throw string("Task graph error, task depends on a task that is not added yet");
+        }
+        nodes_[dependency]->successors.push_back(task_id);
+    }
+    return task_id;
+}
+
+int TaskGraph::GetTaskCount() const {
+    return nodes_.size();
+}
+
+void TaskGraph::Run(JobSystem& job_system) {
+    for (auto& node : nodes_)
+    {
+        node->pending_dependencies.store(node->num_dependencies, std::memory_order_relaxed);
+    }
+
+    JobCounter counter;
+    RunContext context = { this, &job_system, &counter };
+    for (int i = 0; i < nodes_.size(); i++)
+    {
+        if (nodes_[i]->num_dependencies == 0)
+        {
+            job_system.Submit(counter, &TaskGraph::TaskJob, &context, i);
+        }
+    }
+    job_system.Wait(counter);
+}
+
+void TaskGraph::TaskJob(void* data, int task_id, int end, int worker_index) {
+    RunContext& context = *static_cast<RunContext*>(data);
+    TaskNode& node = *context.graph->nodes_[task_id];
+    node.task(worker_index);
+
+    // the last finished dependency starts the successor, before this job counts as done
+    for (int successor : node.successors)
+    {
+        if (context.graph->nodes_[successor]->pending_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            context.job_system->Submit(*context.counter, &TaskGraph::TaskJob, data, successor);
+        }
+    }
+}
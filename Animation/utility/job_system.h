@@ -0,0 +1,156 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using std::vector;
+
+// number of jobs still running in a group, Wait on it to join the group
+struct JobCounter
+{
+    std::atomic<int> pending{ 0 };
+};
+
+// work stealing thread pool
+// every thread has its own job queue, it takes the newest job from its own queue
+// and when that is empty steals the oldest job from another thread's queue
+// jobs are submitted and waited for from one thread (the one that created the pool), which works as worker 0
+class JobSystem
+{
+public:
+    using JobFunction = void (*)(void* data, int begin, int end, int worker_index);
+
+    // num_threads includes the calling thread, 0 means one per hardware thread
+    explicit JobSystem(int num_threads = 0);
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    int GetThreadCount() const;
+
+    // queues func(data, begin, end, worker_index) into the calling thread's queue
+    void Submit(JobCounter& counter, JobFunction func, void* data, int begin = 0, int end = 0);
+    // runs queued jobs on the calling thread until every job of the counter is done
+    void Wait(JobCounter& counter);
+
+    // calls func(begin, end, worker_index) on chunks of at most grain_size items covering [0, count)
+    // ranges are split in halves on demand, so idle threads steal big ranges first
+    // worker_index is below GetThreadCount(), use it to pick per thread scratch data
+    template<typename TFunc>
+    void ParallelFor(int count, int grain_size, const TFunc& func);
+
+private:
+    struct Job
+    {
+        JobFunction func;
+        void* data;
+        int begin;
+        int end;
+        JobCounter* counter;
+    };
+
+    struct JobQueue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    vector<std::unique_ptr<JobQueue>> queues_;
+    vector<std::thread> threads_;
+
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_condition_;
+    std::atomic<int> num_queued_jobs_{ 0 };
+    std::atomic<bool> quit_{ false };
+
+    void WorkerLoop(int worker_index);
+    bool TryRunJob(int worker_index);
+    bool PopJob(int worker_index, Job& job);
+    bool StealJob(int worker_index, Job& job);
+    int GetCurrentWorkerIndex() const;
+
+    template<typename TFunc>
+    struct ParallelForData
+    {
+        const TFunc* func;
+        int grain_size;
+        JobSystem* job_system;
+        JobCounter* counter;
+    };
+
+    template<typename TFunc>
+    static void ParallelForJob(void* data, int begin, int end, int worker_index);
+};
+
+
+template<typename TFunc>
+void JobSystem::ParallelFor(int count, int grain_size, const TFunc& func) {
+    if (count <= 0) return;
+    if (grain_size < 1) grain_size = 1;
+
+    if (GetThreadCount() == 1 || count <= grain_size)
+    {
+        func(0, count, GetCurrentWorkerIndex());
+        return;
+    }
+
+    JobCounter counter;
+    ParallelForData<TFunc> data = { &func, grain_size, this, &counter };
+    Submit(counter, &ParallelForJob<TFunc>, &data, 0, count);
+    Wait(counter);
+}
+
+template<typename TFunc>
+void JobSystem::ParallelForJob(void* data, int begin, int end, int worker_index) {
+    ParallelForData<TFunc>& parallel_for = *static_cast<ParallelForData<TFunc>*>(data);
+
+    // keep the lower half, leave the upper half for this or an idle thread
+    while (end - begin > parallel_for.grain_size)
+    {
+        int middle = begin + (end - begin) / 2;
+        parallel_for.job_system->Submit(*parallel_for.counter, &ParallelForJob<TFunc>, data, middle, end);
+        end = middle;
+    }
+    (*parallel_for.func)(begin, end, worker_index);
+}
+
+
+// tasks with dependencies, each task starts once all the tasks it depends on are done
+class TaskGraph
+{
+public:
+    using Task = std::function<void(int worker_index)>;
+
+    // dependencies are ids returned by earlier AddTask calls
+    int AddTask(Task task, const vector<int>& dependencies = {});
+    int GetTaskCount() const;
+
+    // runs the whole graph, returns when every task is done, can be run again
+    void Run(JobSystem& job_system);
+
+private:
+    struct TaskNode
+    {
+        Task task;
+        vector<int> successors;
+        int num_dependencies = 0;
+        std::atomic<int> pending_dependencies{ 0 };
+    };
+    vector<std::unique_ptr<TaskNode>> nodes_;
+
+    struct RunContext
+    {
+        TaskGraph* graph;
+        JobSystem* job_system;
+        JobCounter* counter;
+    };
+    static void TaskJob(void* data, int task_id, int end, int worker_index);
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+MappedFile::MappedFile(const string& path) {
+    file_handle_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle_ == INVALID_HANDLE_VALUE)
+    {
+        file_handle_ = nullptr;
+        throw string("Can't open file: ") + path;
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file_handle_, &file_size);
+    size_ = static_cast<size_t>(file_size.QuadPart);
+    if (size_ == 0)
+    {
+        // empty files can't be mapped, GetData returns null
+        return;
+    }
+
+    mapping_handle_ = CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle_ != nullptr)
+    {
+        p_data_ = static_cast<const unsigned char*>(MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (p_data_ == nullptr)
+    {
+        if (mapping_handle_ != nullptr) CloseHandle(mapping_handle_);
+        CloseHandle(file_handle_);
+        throw string("Can't map file: ") + path;
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (p_data_ != nullptr) UnmapViewOfFile(p_data_);
+    if (mapping_handle_ != nullptr) CloseHandle(mapping_handle_);
+    if (file_handle_ != nullptr) CloseHandle(file_handle_);
+}
+#else
+MappedFile::MappedFile(const string& path) {
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        throw string("Can't open file: ") + path;
+    }
+
+    struct stat file_stat;
+    fstat(file, &file_stat);
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0)
+    {
+        void* p_mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+        p_data_ = p_mapped == MAP_FAILED ? nullptr : static_cast<const unsigned char*>(p_mapped);
+    }
+    // the mapping stays valid after the file is closed
+    close(file);
+
+    if (size_ > 0 && p_data_ == nullptr)
+    {
+        throw string("Can't map file: ") + path;
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (p_data_ != nullptr) munmap(const_cast<unsigned char*>(p_data_), size_);
+}
+#endif
+
+const unsigned char* MappedFile::GetData() const {
+    return p_data_;
+}
+
+size_t MappedFile::GetSize() const {
+    return size_;
+}
@@ -0,0 +1,31 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+using std::string;
+
+// read only memory mapping of a whole file, pages are loaded by the OS on first access
+class MappedFile
+{
+public:
+    // throws string if the file can't be opened or mapped
+    explicit MappedFile(const string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // page aligned
+    const unsigned char* GetData() const;
+    size_t GetSize() const;
+
+private:
+    const unsigned char* p_data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#endif
+};
+
+#endif
@@ -0,0 +1,372 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+constexpr unsigned int kNoVertex = ~0u;
+// a cluster is split where its running ACMR falls to this much of the whole cluster's (lambda in the paper)
+constexpr float kClusterSplitThreshold = 1.05f;
+
+
+void VertexCacheStats::Add(const VertexCacheStats& other) {
+    triangles += other.triangles;
+    vertices += other.vertices;
+    transformed += other.transformed;
+}
+
+void MeshOptimizationReport::Add(const MeshOptimizationReport& other) {
+    vertices_before += other.vertices_before;
+    vertices_after += other.vertices_after;
+    cache_before.Add(other.cache_before);
+    cache_after.Add(other.cache_after);
+}
+
+
+// FIFO cache by time stamps: a vertex is cached while fewer than cache_size misses happened after its own
+class FifoCache
+{
+public:
+    FifoCache(size_t num_vertices, int cache_size) : stamp_(num_vertices, 0), cache_size_(cache_size), now_(cache_size + 1) {}
+
+    // returns true on a miss
+    bool Access(unsigned int vertex) {
+        if (now_ - stamp_[vertex] <= static_cast<unsigned int>(cache_size_))
+        {
+            return false;
+        }
+        stamp_[vertex] = now_++;
+        return true;
+    }
+
+    void Flush() {
+        now_ += cache_size_ + 1;
+    }
+
+private:
+    vector<unsigned int> stamp_;
+    int cache_size_;
+    unsigned int now_;
+};
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t num_indices, size_t num_vertices, int cache_size) {
+    VertexCacheStats stats;
+    stats.triangles = num_indices / 3;
+    FifoCache cache(num_vertices, cache_size);
+    vector<bool> used(num_vertices, false);
+    for (size_t i = 0; i < num_indices; i++)
+    {
+        stats.transformed += cache.Access(indices[i]) ? 1 : 0;
+        if (used[indices[i]] == false)
+        {
+            used[indices[i]] = true;
+            stats.vertices++;
+        }
+    }
+    return stats;
+}
+
+
+// FNV-1a over the whole vertex, Vertex has no padding
+static uint64_t HashVertex(const Vertex& vertex) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(Vertex); i++)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+void WeldVertices(vector<Vertex>& vertices, vector<unsigned int>& indices) {
+    // open addressing with linear probing, at most half full
+    size_t table_size = 1;
+    while (table_size < vertices.size() * 2)
+    {
+        table_size *= 2;
+    }
+    vector<unsigned int> table(table_size, kNoVertex);
+    vector<unsigned int> remap(vertices.size());
+
+    size_t num_unique = 0;
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        size_t slot = static_cast<size_t>(HashVertex(vertices[i])) & (table_size - 1);
+        while (table[slot] != kNoVertex && memcmp(&vertices[table[slot]], &vertices[i], sizeof(Vertex)) != 0)
+        {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (table[slot] == kNoVertex)
+        {
+            // unique vertices move to the front, in the order they came
+            vertices[num_unique] = vertices[i];
+            table[slot] = static_cast<unsigned int>(num_unique++);
+        }
+        remap[i] = table[slot];
+    }
+
+    vertices.resize(num_unique);
+    for (unsigned int& index : indices)
+    {
+        index = remap[index];
+    }
+}
+
+
+struct TriangleCluster
+{
+    size_t first_triangle;
+    size_t num_triangles;
+    float sort_key;
+};
+
+// Tipsify, emits the triangles around a fanning vertex, then fans around the vertex that is
+// most likely still in the cache when its remaining triangles are emitted
+static vector<unsigned int> TipsifyTriangles(const vector<unsigned int>& indices, size_t num_vertices, int cache_size) {
+    const size_t num_triangles = indices.size() / 3;
+
+    // triangles around each vertex
+    vector<unsigned int> adjacency_begin(num_vertices + 1, 0);
+    for (unsigned int index : indices)
+    {
+        adjacency_begin[index + 1]++;
+    }
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        adjacency_begin[i + 1] += adjacency_begin[i];
+    }
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> fill(adjacency_begin.begin(), adjacency_begin.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    // triangles not emitted yet around each vertex
+    vector<int> live(num_vertices);
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        live[i] = static_cast<int>(adjacency_begin[i + 1] - adjacency_begin[i]);
+    }
+    vector<int> cache_time(num_vertices, 0);
+    vector<bool> emitted(num_triangles, false);
+    // vertices of recently emitted triangles, where a dead end restarts
+    vector<unsigned int> dead_end;
+    vector<unsigned int> candidates;
+    vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    int time = cache_size + 1;
+    size_t cursor = 0;
+    long fanning = indices.empty() ? -1 : static_cast<long>(indices[0]);
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        for (unsigned int a = adjacency_begin[fanning]; a < adjacency_begin[fanning + 1]; a++)
+        {
+            unsigned int triangle = adjacency[a];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int vertex = indices[triangle * 3 + corner];
+                output.push_back(vertex);
+                dead_end.push_back(vertex);
+                candidates.push_back(vertex);
+                live[vertex]--;
+                if (time - cache_time[vertex] > cache_size)
+                {
+                    cache_time[vertex] = time++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // a candidate whose remaining triangles would push it out of the cache gets priority 0
+        long next = -1;
+        int best_priority = -1;
+        for (unsigned int vertex : candidates)
+        {
+            if (live[vertex] <= 0)
+            {
+                continue;
+            }
+            int priority = 0;
+            if (time - cache_time[vertex] + 2 * live[vertex] <= cache_size)
+            {
+                priority = time - cache_time[vertex];
+            }
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                next = vertex;
+            }
+        }
+        while (next < 0 && dead_end.empty() == false)
+        {
+            unsigned int vertex = dead_end.back();
+            dead_end.pop_back();
+            if (live[vertex] > 0)
+            {
+                next = vertex;
+            }
+        }
+        while (next < 0 && cursor < num_vertices)
+        {
+            if (live[cursor] > 0)
+            {
+                next = static_cast<long>(cursor);
+            }
+            cursor++;
+        }
+        fanning = next;
+    }
+    return output;
+}
+
+// clusters start at triangles missing all 3 vertices, where the cache holds nothing useful anyway,
+// and are split further where their running ACMR is close to the whole cluster's, so that
+// reordering them costs little cache locality
+static vector<TriangleCluster> SplitClusters(const vector<unsigned int>& indices, size_t num_vertices, int cache_size) {
+    const size_t num_triangles = indices.size() / 3;
+    FifoCache cache(num_vertices, cache_size);
+    vector<size_t> hard_begin;
+    for (size_t t = 0; t < num_triangles; t++)
+    {
+        int misses = 0;
+        for (int corner = 0; corner < 3; corner++)
+        {
+            misses += cache.Access(indices[t * 3 + corner]) ? 1 : 0;
+        }
+        // a degenerate first triangle misses only 2
+        if (misses == 3 || t == 0)
+        {
+            hard_begin.push_back(t);
+        }
+    }
+    hard_begin.push_back(num_triangles);
+
+    vector<TriangleCluster> clusters;
+    for (size_t h = 0; h + 1 < hard_begin.size(); h++)
+    {
+        size_t begin = hard_begin[h];
+        size_t end = hard_begin[h + 1];
+        cache.Flush();
+        size_t cluster_misses = 0;
+        for (size_t i = begin * 3; i < end * 3; i++)
+        {
+            cluster_misses += cache.Access(indices[i]) ? 1 : 0;
+        }
+        float threshold = kClusterSplitThreshold * cluster_misses / (end - begin);
+
+        // each split cluster is measured starting from an empty cache, as it may be drawn after any other
+        cache.Flush();
+        size_t split_begin = begin;
+        size_t split_misses = 0;
+        for (size_t t = begin; t < end; t++)
+        {
+            for (int corner = 0; corner < 3; corner++)
+            {
+                split_misses += cache.Access(indices[t * 3 + corner]) ? 1 : 0;
+            }
+            if (t + 1 < end && split_misses <= threshold * (t + 1 - split_begin))
+            {
+                clusters.push_back({ split_begin, t + 1 - split_begin, 0.0f });
+                split_begin = t + 1;
+                split_misses = 0;
+                cache.Flush();
+            }
+        }
+        clusters.push_back({ split_begin, end - split_begin, 0.0f });
+    }
+    return clusters;
+}
+
+// sorts clusters by how far their area weighted centroid lies out from the mesh's along their average normal
+static void SortClustersForOverdraw(const vector<Vertex>& vertices, const vector<unsigned int>& indices, vector<TriangleCluster>& clusters) {
+    vector<glm::vec3> cluster_centroid(clusters.size(), glm::vec3(0.0f));
+    vector<glm::vec3> cluster_normal(clusters.size(), glm::vec3(0.0f));
+    glm::vec3 mesh_centroid(0.0f);
+    float mesh_area = 0.0f;
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        float cluster_area = 0.0f;
+        for (size_t t = clusters[c].first_triangle; t < clusters[c].first_triangle + clusters[c].num_triangles; t++)
+        {
+            const glm::vec3& p0 = vertices[indices[t * 3]].position;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+            // twice the area, the factor cancels out
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+            cluster_centroid[c] += (p0 + p1 + p2) * (area / 3.0f);
+            cluster_normal[c] += normal;
+            cluster_area += area;
+        }
+        mesh_centroid += cluster_centroid[c];
+        mesh_area += cluster_area;
+        if (cluster_area > 0.0f)
+        {
+            cluster_centroid[c] = cluster_centroid[c] / cluster_area;
+        }
+    }
+    if (mesh_area > 0.0f)
+    {
+        mesh_centroid = mesh_centroid / mesh_area;
+    }
+
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        float normal_length = glm::length(cluster_normal[c]);
+        clusters[c].sort_key = normal_length > 0.0f ? glm::dot(cluster_centroid[c] - mesh_centroid, cluster_normal[c]) / normal_length : 0.0f;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const TriangleCluster& a, const TriangleCluster& b) {
+        return a.sort_key > b.sort_key;
+    });
+}
+
+void OptimizeTriangleOrder(const vector<Vertex>& vertices, vector<unsigned int>& indices, int cache_size) {
+    vector<unsigned int> tipsified = TipsifyTriangles(indices, vertices.size(), cache_size);
+    vector<TriangleCluster> clusters = SplitClusters(tipsified, vertices.size(), cache_size);
+    SortClustersForOverdraw(vertices, tipsified, clusters);
+
+    indices.clear();
+    for (const TriangleCluster& cluster : clusters)
+    {
+        indices.insert(indices.end(), tipsified.begin() + cluster.first_triangle * 3,
+            tipsified.begin() + (cluster.first_triangle + cluster.num_triangles) * 3);
+    }
+}
+
+void OptimizeVertexOrder(vector<Vertex>& vertices, vector<unsigned int>& indices) {
+    vector<unsigned int> remap(vertices.size(), kNoVertex);
+    vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int& index : indices)
+    {
+        if (remap[index] == kNoVertex)
+        {
+            remap[index] = static_cast<unsigned int>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+
+MeshOptimizationReport OptimizeMesh(vector<Vertex>& vertices, vector<unsigned int>& indices) {
+    MeshOptimizationReport report;
+    report.vertices_before = vertices.size();
+    report.cache_before = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+    WeldVertices(vertices, indices);
+    OptimizeTriangleOrder(vertices, indices);
+    OptimizeVertexOrder(vertices, indices);
+
+    report.vertices_after = vertices.size();
+    report.cache_after = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+    return report;
+}
@@ -0,0 +1,55 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+using std::vector;
+
+#include "../vertex.h"
+
+// FIFO post-transform cache of the size GPUs are usually modelled with
+constexpr int kVertexCacheSize = 16;
+// meshes with at most this many vertices are drawn with 16 bit indices
+constexpr size_t kMaxShortIndexVertices = 65536;
+
+// a triangle list run through a simulated FIFO post-transform vertex cache
+struct VertexCacheStats
+{
+    size_t triangles = 0;
+    // vertices the index buffer refers to
+    size_t vertices = 0;
+    // cache misses, each one runs the vertex shader
+    size_t transformed = 0;
+
+    // average cache miss ratio, transformed vertices per triangle, 0.5 at best for large meshes, 3 at worst
+    float GetACMR() const { return triangles == 0 ? 0.0f : static_cast<float>(transformed) / triangles; }
+    // average transform to vertex ratio, 1 at best
+    float GetATVR() const { return vertices == 0 ? 0.0f : static_cast<float>(transformed) / vertices; }
+    void Add(const VertexCacheStats& other);
+};
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t num_indices, size_t num_vertices, int cache_size = kVertexCacheSize);
+
+// merges bit for bit identical vertices, bone ids and weights included, and points the indices to the kept ones
+void WeldVertices(vector<Vertex>& vertices, vector<unsigned int>& indices);
+// Tipsify (Sander et al. 2007) for cache locality, then its clusters are sorted to draw
+// the ones facing away from the mesh center first, which tend to occlude the rest
+void OptimizeTriangleOrder(const vector<Vertex>& vertices, vector<unsigned int>& indices, int cache_size = kVertexCacheSize);
+// renumbers vertices in the order the indices first use them, unused vertices are dropped
+void OptimizeVertexOrder(vector<Vertex>& vertices, vector<unsigned int>& indices);
+
+struct MeshOptimizationReport
+{
+    size_t vertices_before = 0;
+    size_t vertices_after = 0;
+    VertexCacheStats cache_before;
+    VertexCacheStats cache_after;
+
+    // sums the reports of several meshes
+    void Add(const MeshOptimizationReport& other);
+};
+
+// all of the above in order, triangle lists only
+MeshOptimizationReport OptimizeMesh(vector<Vertex>& vertices, vector<unsigned int>& indices);
+
+#endif
@@ -0,0 +1,178 @@
+#include "skinning_palette.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using glm::mat3;
+using glm::vec4;
+
+
+// the 3x3 part of an affine transform, glm is column major
+static mat3 GetLinearPart(const Affine3x4& transform) {
+    mat3 linear;
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            linear[c][r] = transform.rows[r][c];
+        }
+    }
+    return linear;
+}
+
+// linear = rotation * scale, for the closest rotation when it isn't exactly that
+static void DecomposeRotationScale(const mat3& linear, quat& rotation, float& scale) {
+    scale = std::cbrt(std::abs(glm::determinant(linear)));
+    if (scale == 0.0f)
+    {
+        scale = 1.0f;
+    }
+    rotation = glm::normalize(glm::quat_cast(linear / scale));
+}
+
+static vec4 ToVec4(const quat& q) {
+    return vec4(q.x, q.y, q.z, q.w);
+}
+
+// same as QuatRotate in lighting.vs, q is (x, y, z, w)
+static vec3 QuatRotate(const vec4& q, const vec3& v) {
+    vec3 u(q.x, q.y, q.z);
+    return v + 2.0f * glm::cross(u, glm::cross(u, v) + q.w * v);
+}
+
+static void EncodeDualQuat(const Affine3x4& transform, float* out) {
+    quat rotation;
+    float scale;
+    DecomposeRotationScale(GetLinearPart(transform), rotation, scale);
+
+    // transform = scale * (rotation, translation / scale), the dual quaternion holds the rigid part
+    vec3 translation = vec3(transform.rows[0][3], transform.rows[1][3], transform.rows[2][3]) / scale;
+    quat dual = quat(0.0f, translation.x, translation.y, translation.z) * rotation * 0.5f;
+
+    vec4 real_part = ToVec4(rotation) * scale;
+    vec4 dual_part = ToVec4(dual) * scale;
+    memcpy(out, &real_part[0], sizeof(vec4));
+    memcpy(out + 4, &dual_part[0], sizeof(vec4));
+}
+
+
+int GetPaletteVec4sPerBone(EPaletteEncoding encoding) {
+    switch (encoding)
+    {
+    case EPaletteEncoding::eAffine3x4:
+        return 3;
+    case EPaletteEncoding::eDualQuat:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+void EncodePalette(const Affine3x4* transforms, int num_bones, EPaletteEncoding encoding, float* out) {
+    int stride = 4 * GetPaletteVec4sPerBone(encoding);
+    for (int i = 0; i < num_bones; i++)
+    {
+        float* bone = out + i * stride;
+        switch (encoding)
+        {
+        case EPaletteEncoding::eMat4:
+        {
+            mat4 mat = ToMat4(transforms[i]);
+            memcpy(bone, &mat[0][0], sizeof(mat4));
+            break;
+        }
+        case EPaletteEncoding::eAffine3x4:
+            memcpy(bone, transforms[i].rows, sizeof(transforms[i].rows));
+            break;
+        case EPaletteEncoding::eDualQuat:
+            EncodeDualQuat(transforms[i], bone);
+            break;
+        }
+    }
+}
+
+float MeasureNonRigidity(const Affine3x4& transform) {
+    mat3 linear = GetLinearPart(transform);
+    quat rotation;
+    float scale;
+    DecomposeRotationScale(linear, rotation, scale);
+    mat3 rigid = glm::mat3_cast(rotation);
+
+    float error = 0.0f;
+    for (int c = 0; c < 3; c++)
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            error = std::max(error, std::abs(linear[c][r] / scale - rigid[c][r]));
+        }
+    }
+    return error;
+}
+
+vec3 SkinPosition(const float* palette, EPaletteEncoding encoding, const Vertex& vertex) {
+    // vertex without bones
+    if (vertex.bone_id[0] < 0)
+    {
+        return vertex.position;
+    }
+
+    int stride = 4 * GetPaletteVec4sPerBone(encoding);
+    if (encoding != EPaletteEncoding::eDualQuat)
+    {
+        vec3 position(0.0f);
+        for (int i = 0; i < kMaxBonePerVertex; i++)
+        {
+            if (vertex.bone_id[i] < 0)
+            {
+                continue;
+            }
+            const float* bone = palette + vertex.bone_id[i] * stride;
+            vec4 p(vertex.position, 1.0f);
+            for (int r = 0; r < 3; r++)
+            {
+                // eMat4 is column major, eAffine3x4 row major
+                vec4 row = encoding == EPaletteEncoding::eMat4 ? vec4(bone[r], bone[4 + r], bone[8 + r], bone[12 + r])
+                    : vec4(bone[4 * r], bone[4 * r + 1], bone[4 * r + 2], bone[4 * r + 3]);
+                position[r] += glm::dot(row, p) * vertex.weights[i];
+            }
+        }
+        return position;
+    }
+
+    vec4 real_part(0.0f);
+    vec4 dual_part(0.0f);
+    vec4 first_real(0.0f);
+    float scale = 0.0f;
+    float weight_sum = 0.0f;
+    for (int i = 0; i < kMaxBonePerVertex; i++)
+    {
+        if (vertex.bone_id[i] < 0)
+        {
+            continue;
+        }
+        const float* bone = palette + vertex.bone_id[i] * stride;
+        vec4 bone_real(bone[0], bone[1], bone[2], bone[3]);
+        vec4 bone_dual(bone[4], bone[5], bone[6], bone[7]);
+        float bone_scale = glm::length(bone_real);
+        bone_real /= bone_scale;
+        bone_dual /= bone_scale;
+        if (i == 0)
+        {
+            first_real = bone_real;
+        }
+        // q and -q are the same rotation, blend along the shorter arc
+        float weight = glm::dot(bone_real, first_real) < 0.0f ? -vertex.weights[i] : vertex.weights[i];
+        real_part += bone_real * weight;
+        dual_part += bone_dual * weight;
+        scale += bone_scale * vertex.weights[i];
+        weight_sum += vertex.weights[i];
+    }
+    float length = glm::length(real_part);
+    real_part /= length;
+    dual_part /= length;
+    vec3 real_xyz(real_part.x, real_part.y, real_part.z);
+    vec3 dual_xyz(dual_part.x, dual_part.y, dual_part.z);
+    vec3 translation = 2.0f * (real_part.w * dual_xyz - dual_part.w * real_xyz + glm::cross(real_xyz, dual_xyz));
+    return (QuatRotate(real_part, vertex.position) + translation) * (scale / std::max(weight_sum, 1e-6f));
+}
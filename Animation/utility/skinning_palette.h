@@ -0,0 +1,38 @@
+#ifndef SKINNING_PALETTE_H
+#define SKINNING_PALETTE_H
+
+#include <glm/glm.hpp>
+
+#include "affine_math.h"
+#include "../vertex.h"
+
+// how the GPU palette stores each bone, lighting.vs reads the palette as vec4s
+enum class EPaletteEncoding
+{
+    // 4 columns, 64 bytes
+    eMat4,
+    // 3 rows, the constant last row dropped, 48 bytes
+    eAffine3x4,
+    // real and dual quaternion, 32 bytes, blended without the candy wrapper collapse of matrix blending
+    // the length of the real part carries the bone's uniform scale
+    eDualQuat,
+};
+
+// skinned positions of eAffine3x4, and eDualQuat on vertices of one bone, stay within this of eMat4's, relative to the model size
+constexpr float kMaxPaletteRelativeError = 1e-4f;
+// bones further than this from rigid, see MeasureNonRigidity, are distorted by eDualQuat
+constexpr float kMaxDualQuatNonRigidity = 1e-3f;
+
+int GetPaletteVec4sPerBone(EPaletteEncoding encoding);
+
+// writes num_bones bones, 4 * GetPaletteVec4sPerBone floats each
+void EncodePalette(const Affine3x4* transforms, int num_bones, EPaletteEncoding encoding, float* out);
+
+// how far a transform is from rotation * uniform scale + translation, the part eDualQuat keeps
+// max abs difference of its 3x3 from the closest scaled rotation, relative to that scale
+float MeasureNonRigidity(const Affine3x4& transform);
+
+// skins a position the way lighting.vs does, to compare encodings on the CPU
+vec3 SkinPosition(const float* palette, EPaletteEncoding encoding, const Vertex& vertex);
+
+#endif
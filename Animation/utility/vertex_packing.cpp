@@ -0,0 +1,296 @@
+#include "vertex_packing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+constexpr float kMaxSnorm16 = 32767.0f;
+constexpr float kMaxSnorm8 = 127.0f;
+constexpr float kMaxUnorm8 = 255.0f;
+constexpr float kRadToDeg = 57.2957795f;
+
+
+static float SignNotZero(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+// unit vector to the square [-1, 1]^2, the lower hemisphere is folded over the diagonals
+static glm::vec2 OctahedralEncode(const glm::vec3& n) {
+    float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 e(n.x / l1, n.y / l1);
+    if (n.z < 0.0f)
+    {
+        e = glm::vec2((1.0f - std::abs(e.y)) * SignNotZero(e.x), (1.0f - std::abs(e.x)) * SignNotZero(e.y));
+    }
+    return e;
+}
+
+// same steps as OctDecode in lighting.vs
+static glm::vec3 OctahedralDecode(float x, float y) {
+    glm::vec3 n(x, y, 1.0f - std::abs(x) - std::abs(y));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+// GL maps the most negative code to -1 as well
+static float DecodeSnorm(int code, float max_code) {
+    return std::max(code / max_code, -1.0f);
+}
+
+// the rounded code is not always the closest direction, so the 4 codes around the encoding are tried
+static void PackOctahedral(const glm::vec3& n, float max_code, int code[2]) {
+    glm::vec2 e = OctahedralEncode(n);
+    float best_cos = -2.0f;
+    for (int i = 0; i < 4; i++)
+    {
+        float cx = (i & 1) ? std::ceil(e.x * max_code) : std::floor(e.x * max_code);
+        float cy = (i & 2) ? std::ceil(e.y * max_code) : std::floor(e.y * max_code);
+        int candidate[2] = { static_cast<int>(std::min(std::max(cx, -max_code), max_code)),
+            static_cast<int>(std::min(std::max(cy, -max_code), max_code)) };
+        float cos = glm::dot(OctahedralDecode(DecodeSnorm(candidate[0], max_code), DecodeSnorm(candidate[1], max_code)), n);
+        if (cos > best_cos)
+        {
+            best_cos = cos;
+            code[0] = candidate[0];
+            code[1] = candidate[1];
+        }
+    }
+}
+
+static bool IsZero(const glm::vec3& v) {
+    return v.x == 0.0f && v.y == 0.0f && v.z == 0.0f;
+}
+
+static bool IsFinite(const glm::vec3& v) {
+    return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+}
+
+// zero length and NaN or infinite vectors have no direction to encode
+static bool HasDirection(const glm::vec3& v) {
+    return IsZero(v) == false && IsFinite(v);
+}
+
+// round to nearest even, magnitudes past the half range become infinity
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t magnitude = bits & 0x7fffffffu;
+    if (magnitude >= 0x7f800000u)
+    {
+        return static_cast<uint16_t>(sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u));
+    }
+    if (magnitude >= 0x477ff000u)
+    {
+        return static_cast<uint16_t>(sign | 0x7c00u);
+    }
+    if (magnitude < 0x38800000u)
+    {
+        // subnormal half, in units of 2^-24
+        float abs_value;
+        memcpy(&abs_value, &magnitude, sizeof(abs_value));
+        return static_cast<uint16_t>(sign | static_cast<uint32_t>(std::nearbyint(abs_value * 16777216.0f)));
+    }
+    // rebias the exponent from 127 to 15, then round the 13 dropped mantissa bits
+    magnitude += 0xc8000fffu + ((magnitude >> 13) & 1u);
+    return static_cast<uint16_t>(sign | (magnitude >> 13));
+}
+
+float HalfToFloat(uint16_t half) {
+    uint32_t sign = (half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+    if (exponent == 0)
+    {
+        float value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -value : value;
+    }
+    uint32_t bits = sign | (exponent == 31 ? 0x7f800000u : (exponent + 112) << 23) | (mantissa << 13);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// quantizes to 8 bits with the largest remainder method, so the bytes add up to the rounded sum of the weights
+static void PackWeights(const Vertex& vertex, PackedVertex& packed) {
+    float weights[kMaxBonePerVertex];
+    float sum = 0.0f;
+    for (int i = 0; i < kMaxBonePerVertex; i++)
+    {
+        // also drops NaN and infinite weights, the comparison is false for NaN
+        weights[i] = vertex.bone_id[i] >= 0 && vertex.weights[i] > 0.0f && std::isfinite(vertex.weights[i]) ? vertex.weights[i] : 0.0f;
+        sum += weights[i];
+    }
+    float scale = sum > 1.0f ? kMaxUnorm8 / sum : kMaxUnorm8;
+    int total = static_cast<int>(std::lround(std::min(sum, 1.0f) * kMaxUnorm8));
+
+    float remainder[kMaxBonePerVertex];
+    int assigned = 0;
+    for (int i = 0; i < kMaxBonePerVertex; i++)
+    {
+        float scaled = weights[i] * scale;
+        packed.weights[i] = static_cast<uint8_t>(std::floor(scaled));
+        remainder[i] = scaled - packed.weights[i];
+        assigned += packed.weights[i];
+    }
+    for (; assigned < total; assigned++)
+    {
+        int largest = static_cast<int>(std::max_element(remainder, remainder + kMaxBonePerVertex) - remainder);
+        packed.weights[largest]++;
+        remainder[largest] = -1.0f;
+    }
+}
+
+
+bool CanPackVertices(const Vertex* vertices, size_t num_vertices) {
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        for (int j = 0; j < kMaxBonePerVertex; j++)
+        {
+            if (vertices[i].bone_id[j] >= kPackedNoBone)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+PackedVertex PackVertex(const Vertex& vertex) {
+    PackedVertex packed;
+    memset(&packed, 0, sizeof(packed));
+    packed.position[0] = vertex.position.x;
+    packed.position[1] = vertex.position.y;
+    packed.position[2] = vertex.position.z;
+
+    if (HasDirection(vertex.normal))
+    {
+        int code[2];
+        PackOctahedral(glm::normalize(vertex.normal), kMaxSnorm16, code);
+        packed.normal[0] = static_cast<int16_t>(code[0]);
+        packed.normal[1] = static_cast<int16_t>(code[1]);
+    }
+
+    packed.tex_coords[0] = FloatToHalf(vertex.tex_coords.x);
+    packed.tex_coords[1] = FloatToHalf(vertex.tex_coords.y);
+
+    // w stays 0 for vertices without tangents
+    if (HasDirection(vertex.tangent))
+    {
+        int code[2];
+        PackOctahedral(glm::normalize(vertex.tangent), kMaxSnorm8, code);
+        packed.tangent[0] = static_cast<int8_t>(code[0]);
+        packed.tangent[1] = static_cast<int8_t>(code[1]);
+        bool flipped = glm::dot(glm::cross(vertex.normal, vertex.tangent), vertex.bitangent) < 0.0f;
+        packed.tangent[3] = static_cast<int8_t>(flipped ? -kMaxSnorm8 : kMaxSnorm8);
+    }
+
+    for (int i = 0; i < kMaxBonePerVertex; i++)
+    {
+        packed.bone_id[i] = vertex.bone_id[i] >= 0 ? static_cast<uint8_t>(vertex.bone_id[i]) : kPackedNoBone;
+    }
+    PackWeights(vertex, packed);
+    return packed;
+}
+
+Vertex UnpackVertex(const PackedVertex& packed) {
+    Vertex vertex;
+    vertex.position = glm::vec3(packed.position[0], packed.position[1], packed.position[2]);
+    vertex.normal = OctahedralDecode(DecodeSnorm(packed.normal[0], kMaxSnorm16), DecodeSnorm(packed.normal[1], kMaxSnorm16));
+    vertex.tex_coords = glm::vec2(HalfToFloat(packed.tex_coords[0]), HalfToFloat(packed.tex_coords[1]));
+    if (packed.tangent[3] != 0)
+    {
+        vertex.tangent = OctahedralDecode(DecodeSnorm(packed.tangent[0], kMaxSnorm8), DecodeSnorm(packed.tangent[1], kMaxSnorm8));
+        vertex.bitangent = glm::cross(vertex.normal, vertex.tangent) * DecodeSnorm(packed.tangent[3], kMaxSnorm8);
+    }
+    for (int i = 0; i < kMaxBonePerVertex; i++)
+    {
+        bool used = packed.bone_id[i] != kPackedNoBone;
+        vertex.bone_id[i] = used ? packed.bone_id[i] : -1;
+        vertex.weights[i] = used ? packed.weights[i] / kMaxUnorm8 : 0.0f;
+    }
+    return vertex;
+}
+
+vector<PackedVertex> PackVertices(const Vertex* vertices, size_t num_vertices) {
+    vector<PackedVertex> packed(num_vertices);
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        packed[i] = PackVertex(vertices[i]);
+    }
+    return packed;
+}
+
+
+// atan2 stays accurate for tiny angles, where acos of a dot product rounds to 0
+static float AngleDeg(const glm::vec3& a, const glm::vec3& b) {
+    glm::vec3 unit_a = glm::normalize(a);
+    glm::vec3 unit_b = glm::normalize(b);
+    return std::atan2(glm::length(glm::cross(unit_a, unit_b)), glm::dot(unit_a, unit_b)) * kRadToDeg;
+}
+
+VertexPackingError MeasurePackingError(const Vertex* vertices, size_t num_vertices) {
+    VertexPackingError error;
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        const Vertex& source = vertices[i];
+        Vertex unpacked = UnpackVertex(PackVertex(source));
+
+        // a NaN or infinite source is dropped by the packing, and max would drop its NaN angle
+        if (IsFinite(source.normal) == false || IsFinite(source.tangent) == false)
+        {
+            error.mismatches++;
+        }
+        if (HasDirection(source.normal))
+        {
+            error.normal_deg = std::max(error.normal_deg, AngleDeg(source.normal, unpacked.normal));
+        }
+        if (HasDirection(source.tangent))
+        {
+            error.tangent_deg = std::max(error.tangent_deg, AngleDeg(source.tangent, unpacked.tangent));
+            if (HasDirection(source.bitangent))
+            {
+                error.bitangent_deg = std::max(error.bitangent_deg, AngleDeg(source.bitangent, unpacked.bitangent));
+            }
+        }
+        for (int c = 0; c < 2; c++)
+        {
+            float relative = std::abs(unpacked.tex_coords[c] - source.tex_coords[c]) / std::max(std::abs(source.tex_coords[c]), 1.0f);
+            // max would drop a NaN
+            if (std::isnan(relative))
+            {
+                error.mismatches++;
+            }
+            error.tex_coord = std::max(error.tex_coord, relative);
+        }
+
+        if (memcmp(&source.position, &unpacked.position, sizeof(source.position)) != 0)
+        {
+            error.mismatches++;
+        }
+        for (int j = 0; j < kMaxBonePerVertex; j++)
+        {
+            bool used = source.bone_id[j] >= 0;
+            if (unpacked.bone_id[j] != (used ? source.bone_id[j] : -1))
+            {
+                error.mismatches++;
+            }
+            else if (used && std::isfinite(source.weights[j]) == false)
+            {
+                error.mismatches++;
+            }
+            else if (used)
+            {
+                error.weight = std::max(error.weight, std::abs(unpacked.weights[j] - source.weights[j]));
+            }
+        }
+    }
+    return error;
+}
+
+bool IsWithinPackingBounds(const VertexPackingError& error) {
+    return error.mismatches == 0 && error.normal_deg <= kMaxPackedNormalErrorDeg && error.tangent_deg <= kMaxPackedTangentErrorDeg
+        && error.tex_coord <= kMaxPackedTexCoordError && error.weight <= kMaxPackedWeightError;
+}
@@ -0,0 +1,47 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+using std::vector;
+
+#include "../vertex.h"
+
+// max round trip error of Vertex -> PackedVertex -> Vertex over a set of vertices
+struct VertexPackingError
+{
+    float normal_deg = 0.0f;
+    float tangent_deg = 0.0f;
+    // against the source bitangent, includes how far the source frame is from orthogonal
+    float bitangent_deg = 0.0f;
+    // relative to max(1, |uv|), half floats keep 11 significant bits at any magnitude
+    float tex_coord = 0.0f;
+    float weight = 0.0f;
+    // positions, bone ids and the order of influences must survive exactly
+    int mismatches = 0;
+};
+
+// bounds the packing stays within for any input, from the precision of each encoding
+constexpr float kMaxPackedNormalErrorDeg = 0.01f;
+constexpr float kMaxPackedTangentErrorDeg = 0.7f;
+constexpr float kMaxPackedTexCoordError = 1.0f / 2048.0f;
+constexpr float kMaxPackedWeightError = 1.0f / 255.0f;
+
+// false if a bone id doesn't fit in 8 bits, such vertices stay in EVertexFormat::eFull
+bool CanPackVertices(const Vertex* vertices, size_t num_vertices);
+PackedVertex PackVertex(const Vertex& vertex);
+// unused influence slots come back as bone id -1 with weight 0, tangent frames as unit vectors
+Vertex UnpackVertex(const PackedVertex& packed);
+vector<PackedVertex> PackVertices(const Vertex* vertices, size_t num_vertices);
+
+// IEEE half floats as PackedVertex stores them, also used for half float textures
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t half);
+
+// packs and unpacks every vertex, zero length normals and tangents are not measured
+// NaN or infinite normals, tangents and weights pack as missing, they and NaN texture coordinates count as mismatches
+VertexPackingError MeasurePackingError(const Vertex* vertices, size_t num_vertices);
+bool IsWithinPackingBounds(const VertexPackingError& error);
+
+#endif
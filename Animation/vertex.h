@@ -0,0 +1,58 @@
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+constexpr int kMaxBonePerVertex = 4;
+
+struct Vertex 
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 tex_coords;
+    glm::vec3 tangent;
+    glm::vec3 bitangent;
+
+    //bone indexes which will influence this vertex
+    int bone_id[kMaxBonePerVertex];
+    //weights from each bone
+    float weights[kMaxBonePerVertex];
+
+    Vertex() : position(0.0f), normal(0.0f), tex_coords(0.0f), tangent(0.0f), bitangent(0.0f) {
+        std::fill_n(bone_id, kMaxBonePerVertex, -1);
+        std::fill_n(weights, kMaxBonePerVertex, -1.0f);
+    }
+};
+
+enum class EVertexFormat
+{
+    // Vertex as it is, 88 bytes
+    eFull,
+    // PackedVertex, 32 bytes, for meshes whose bone ids fit in 8 bits
+    ePacked
+};
+
+// bone_id of an unused influence slot in PackedVertex
+constexpr uint8_t kPackedNoBone = 255;
+
+// Vertex with the same attribute locations in a third of the size, see utility/vertex_packing.h
+struct PackedVertex
+{
+    // full precision, skinned positions are where quantization shows first
+    float position[3];
+    // octahedral unit vector, snorm16 per component
+    int16_t normal[2];
+    // half floats
+    uint16_t tex_coords[2];
+    // octahedral unit vector in x and y, snorm8, w is the bitangent sign (127 or -127) or 0 without tangents, z is unused
+    int8_t tangent[4];
+    uint8_t bone_id[kMaxBonePerVertex];
+    // unorm8, they add up to the quantized sum of the source weights
+    uint8_t weights[kMaxBonePerVertex];
+};
+static_assert(sizeof(PackedVertex) == 32, "PackedVertex layout has padding");
+
+#endif
@@ -0,0 +1,118 @@
+#include "vertex_animation_texture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "utility/skinning_palette.h"
+#include "utility/vertex_packing.h"
+
+
+static int GetTexelsPerItem(EVatContent content) {
+    return content == EVatContent::eBonePalette ? GetPaletteVec4sPerBone(EPaletteEncoding::eAffine3x4) : 2;
+}
+
+// normal skinned like lighting.vs does, by the blended 3x3 of the bone matrices
+static vec3 SkinNormal(const vector<mat4>& palette, const Vertex& vertex) {
+    if (vertex.bone_id[0] < 0)
+    {
+        return vertex.normal;
+    }
+    vec3 normal(0.0f);
+    for (int i = 0; i < kMaxBonePerVertex; i++)
+    {
+        if (vertex.bone_id[i] >= 0)
+        {
+            normal += glm::mat3(palette[vertex.bone_id[i]]) * vertex.normal * vertex.weights[i];
+        }
+    }
+    float length = glm::length(normal);
+    return length > 0.0f ? normal / length : normal;
+}
+
+static void WriteTexel(float* texel, const vec3& value, float w) {
+    texel[0] = value.x;
+    texel[1] = value.y;
+    texel[2] = value.z;
+    texel[3] = w;
+}
+
+
+VertexAnimationTexture BakeVertexAnimationTexture(const Skeleton& skeleton, const Animation& animation, const mat4& root_transform,
+    const Vertex* vertices, size_t num_vertices, EVatContent content, EVatPrecision precision, float frame_rate) {
+    if (animation.IsStreamed())
+    {
+        throw std::string("Vertex animation textures are baked from clips that aren't streamed");
+    }
+
+    VertexAnimationTexture vat;
+    vat.content = content;
+    vat.precision = precision;
+    int num_items = content == EVatContent::eBonePalette ? skeleton.GetBoneCount() : static_cast<int>(num_vertices);
+    vat.texels_per_frame = std::max(1, num_items * GetTexelsPerItem(content));
+    vat.width = std::min(vat.texels_per_frame, kMaxVatWidth);
+    vat.rows_per_frame = (vat.texels_per_frame + vat.width - 1) / vat.width;
+
+    // checked as a float, so a long clip at a high rate can't overflow the frame count
+    float num_frames = std::max(1.0f, std::ceil(animation.total_sec_ * frame_rate - 1e-3f));
+    if (num_frames * vat.rows_per_frame > kMaxVatHeight)
+    {
+        throw std::string("Vertex animation texture of ") + animation.anim_name_ + " needs more than " + std::to_string(kMaxVatHeight)
+            + " rows, bake it at a lower frame rate";
+    }
+    vat.num_frames = static_cast<int>(num_frames);
+    vat.frame_rate = animation.total_sec_ > 0.0f ? vat.num_frames / animation.total_sec_ : frame_rate;
+    vat.texels.assign(static_cast<size_t>(vat.width) * vat.GetHeight() * 4, 0.0f);
+
+    PoseState state = skeleton.CreatePoseState();
+    PoseScratch scratch;
+    for (int frame = 0; frame < vat.num_frames; frame++)
+    {
+        float* out = vat.texels.data() + static_cast<size_t>(frame) * vat.rows_per_frame * vat.width * 4;
+        skeleton.CalcBoneAnimTransform(animation, static_cast<float>(frame) / vat.num_frames, state, scratch, root_transform);
+        if (content == EVatContent::eBonePalette)
+        {
+            EncodePalette(state.final_affine_transform.data(), skeleton.GetBoneCount(), EPaletteEncoding::eAffine3x4, out);
+            continue;
+        }
+        for (size_t v = 0; v < num_vertices; v++)
+        {
+            vec3 position = SkinPosition(&state.final_bone_transform[0][0][0], EPaletteEncoding::eMat4, vertices[v]);
+            WriteTexel(out + v * 8, position, 1.0f);
+            WriteTexel(out + v * 8 + 4, SkinNormal(state.final_bone_transform, vertices[v]), 0.0f);
+        }
+    }
+
+    // rounded here rather than by the driver, so the CPU copy is what the shader reads
+    if (precision == EVatPrecision::eHalf)
+    {
+        for (float& texel : vat.texels)
+        {
+            texel = HalfToFloat(FloatToHalf(texel));
+        }
+    }
+    return vat;
+}
+
+float MeasureVatError(const VertexAnimationTexture& vat, const Skeleton& skeleton, const Animation& animation,
+    const mat4& root_transform, const Vertex* vertices, size_t num_vertices) {
+    PoseState state = skeleton.CreatePoseState();
+    PoseScratch scratch;
+    float model_size = 1e-6f;
+    float max_error = 0.0f;
+    for (int frame = 0; frame < vat.num_frames; frame++)
+    {
+        skeleton.CalcBoneAnimTransform(animation, static_cast<float>(frame) / vat.num_frames, state, scratch, root_transform);
+        const float* baked = vat.GetFrame(frame);
+        for (size_t v = 0; v < num_vertices; v++)
+        {
+            vec3 reference = SkinPosition(&state.final_bone_transform[0][0][0], EPaletteEncoding::eMat4, vertices[v]);
+            vec3 position = vat.content == EVatContent::eBonePalette
+                ? SkinPosition(baked, EPaletteEncoding::eAffine3x4, vertices[v])
+                : vec3(baked[v * 8], baked[v * 8 + 1], baked[v * 8 + 2]);
+            model_size = std::max(model_size, glm::length(reference));
+            max_error = std::max(max_error, glm::distance(reference, position));
+        }
+    }
+    return max_error / model_size;
+}
@@ -0,0 +1,78 @@
+#ifndef VERTEX_ANIMATION_TEXTURE_H
+#define VERTEX_ANIMATION_TEXTURE_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+using std::vector;
+
+#include "skeleton.h"
+#include "vertex.h"
+
+// what each frame of a vertex animation texture holds, lighting.vs plays either back
+enum class EVatContent
+{
+    // 3 texels per bone, the rows of its eAffine3x4 transform, vertices are still skinned in the shader
+    eBonePalette,
+    // 2 texels per vertex, skinned position and normal, one fetch each per frame
+    // indexed by gl_VertexID, so only for models drawn from merged meshes in ModelData's vertex order
+    eSkinnedVertices,
+};
+
+enum class EVatPrecision
+{
+    // GL_RGBA32F
+    eFloat,
+    // GL_RGBA16F, half the memory, 11 significant bits
+    eHalf,
+};
+
+// texture rows wrap past this many texels, below the GL_MAX_TEXTURE_SIZE every GL 4.3 driver has
+constexpr int kMaxVatWidth = 4096;
+// the GL_MAX_TEXTURE_SIZE GL 4.3 guarantees, clips needing more rows don't bake
+constexpr int kMaxVatHeight = 16384;
+// skinned positions from baked frames stay within this of live poses, relative to the model size
+constexpr float kMaxVatFloatRelativeError = 1e-4f;
+constexpr float kMaxVatHalfRelativeError = 1e-3f;
+
+// one clip sampled at a fixed rate into an RGBA texture, for crowd members far enough away
+// that playing one looping clip is enough, they cost no CPU time per frame
+// texel k of frame f is at (k % width, f * rows_per_frame + k / width)
+struct VertexAnimationTexture
+{
+    EVatContent content = EVatContent::eBonePalette;
+    EVatPrecision precision = EVatPrecision::eFloat;
+    // frames per second of clip time, adjusted from the requested rate so the clip is a whole number of frames
+    // the frame after the last is the first again
+    float frame_rate = 0.0f;
+    int num_frames = 0;
+    int texels_per_frame = 0;
+    int width = 0;
+    int rows_per_frame = 0;
+    // RGBA of width * GetHeight texels, rounded to half precision for eHalf
+    vector<float> texels;
+
+    int GetHeight() const {
+        return num_frames * rows_per_frame;
+    }
+    // texels_per_frame texels of one frame
+    const float* GetFrame(int frame) const {
+        return texels.data() + static_cast<size_t>(frame) * rows_per_frame * width * 4;
+    }
+    size_t GetMemorySize() const {
+        return texels.size() * (precision == EVatPrecision::eHalf ? 2 : 4);
+    }
+};
+
+// poses the skeleton at each frame with CalcBoneAnimTransform, vertices are only read for eSkinnedVertices
+// throws if the frames need more than kMaxVatHeight rows, a lower frame rate fits more of the clip
+VertexAnimationTexture BakeVertexAnimationTexture(const Skeleton& skeleton, const Animation& animation, const mat4& root_transform,
+    const Vertex* vertices, size_t num_vertices, EVatContent content, EVatPrecision precision, float frame_rate);
+
+// max distance of vertices skinned from each baked frame to vertices skinned from a live CalcBoneAnimTransform
+// at the frame's time, relative to the model size, compare to kMaxVatFloatRelativeError or kMaxVatHalfRelativeError
+float MeasureVatError(const VertexAnimationTexture& vat, const Skeleton& skeleton, const Animation& animation,
+    const mat4& root_transform, const Vertex* vertices, size_t num_vertices);
+
+#endif
@@ -0,0 +1,499 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "animation.h"
+#include "animated_instance.h"
+#include "utility/affine_math.h"
+#include "utility/anim_math.h"
+#include "synthetic_clip.h"
+#include "synthetic_rig.h"
+
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr int kBenchChannels = 64;
+constexpr int kBenchFrames = 2000;
+constexpr float kFrameDeltaSec = 1.0f / 60.0f;
+constexpr int kBenchRandomSamples = 200000;
+
+const char* kBobAnimPath = "../Animation/resource/bob/boblampclean.md5anim";
+
+// keeps the optimizer from removing the sampling loops
+static volatile float g_sink = 0.0f;
+
+// samples every channel of a clip for kBenchFrames frames of 60 fps playback,
+// returns average nanoseconds per frame
+double BenchSampleFrames(const Animation& anim, bool use_cursor) {
+    const int num_channels = anim.GetChannelCount();
+    vector<string> channel_names;
+    vector<int> channel_indices;
+    for (int i = 0; i < num_channels; i++)
+    {
+        channel_names.push_back(anim.GetChannelName(i));
+        channel_indices.push_back(anim.GetChannelIndex(channel_names.back()));
+    }
+
+    AnimationCursor cursor = anim.CreateCursor();
+    float sum = 0.0f;
+
+    auto begin = Clock::now();
+    for (int frame = 0; frame < kBenchFrames; frame++)
+    {
+        float time_in_sec = frame * kFrameDeltaSec;
+        for (int i = 0; i < num_channels; i++)
+        {
+            if (use_cursor)
+            {
+                sum += anim.GetPosition(channel_indices[i], time_in_sec, cursor, false).x;
+                sum += anim.GetRotation(channel_indices[i], time_in_sec, cursor, false).w;
+                sum += anim.GetScale(channel_indices[i], time_in_sec, cursor, false);
+            }
+            else
+            {
+                sum += anim.GetPosition(channel_names[i], time_in_sec, false).x;
+                sum += anim.GetRotation(channel_names[i], time_in_sec, false).w;
+                sum += anim.GetScale(channel_names[i], time_in_sec, false);
+            }
+        }
+    }
+    auto end = Clock::now();
+
+    g_sink = sum;
+    return std::chrono::duration<double, std::nano>(end - begin).count() / kBenchFrames;
+}
+
+// per frame sampling cost should stay flat while the clip gets longer,
+// "cursor" samples by bound channel index, "seek" by channel name without a cursor,
+// "uniform" by channel index on a clip resampled at load time
+void BenchmarkKeyLookup() {
+    printf("== key lookup: %d channels, %d frames ==\n", kBenchChannels, kBenchFrames);
+    printf("%10s %16s %16s %16s\n", "keys", "cursor ns/frame", "seek ns/frame", "uniform ns/frame");
+
+    AnimationImportOption uniform_option;
+    uniform_option.key_sample_mode = EKeySampleMode::eUniform;
+
+    for (int num_keys : { 30, 300, 3000, 30000 })
+    {
+        aiAnimation* ai_anim = CreateSyntheticClip(kBenchChannels, num_keys);
+        Animation anim(ai_anim);
+        Animation uniform_anim(ai_anim, uniform_option);
+        delete ai_anim;
+
+        double cursor_ns = BenchSampleFrames(anim, true);
+        double seek_ns = BenchSampleFrames(anim, false);
+        double uniform_ns = BenchSampleFrames(uniform_anim, true);
+        printf("%10d %16.1f %16.1f %16.1f\n", num_keys, cursor_ns, seek_ns, uniform_ns);
+    }
+}
+
+// keyframe layout Animation used before structure-of-arrays storage,
+// time and value interleaved per key, kept here as the reference for BenchmarkKeyLayout
+struct AosPositionKey { float time; glm::vec3 position; };
+struct AosRotationKey { float time; glm::quat quaternion; };
+struct AosScaleKey { float time; float scale; };
+
+struct AosChannel
+{
+    vector<AosPositionKey> position_keys;
+    vector<AosRotationKey> rotation_keys;
+    vector<AosScaleKey> scale_keys;
+};
+
+vector<AosChannel> BuildAosChannels(const aiAnimation* anim) {
+    vector<AosChannel> channels(anim->mNumChannels);
+    for (unsigned int i = 0; i < anim->mNumChannels; i++)
+    {
+        const aiNodeAnim* ai_channel = anim->mChannels[i];
+        for (unsigned int j = 0; j < ai_channel->mNumPositionKeys; j++)
+            channels[i].position_keys.push_back({ float(ai_channel->mPositionKeys[j].mTime), Convert<vec3>(ai_channel->mPositionKeys[j].mValue) });
+        for (unsigned int j = 0; j < ai_channel->mNumRotationKeys; j++)
+            channels[i].rotation_keys.push_back({ float(ai_channel->mRotationKeys[j].mTime), Convert<quat>(ai_channel->mRotationKeys[j].mValue) });
+        for (unsigned int j = 0; j < ai_channel->mNumScalingKeys; j++)
+            channels[i].scale_keys.push_back({ float(ai_channel->mScalingKeys[j].mTime), Convert<float>(ai_channel->mScalingKeys[j].mValue) });
+    }
+    return channels;
+}
+
+// same search as Animation::FindKey, but striding over interleaved keys
+template<typename TKey>
+int AosFindKey(const vector<TKey>& keys, float time, float& factor) {
+    int offset = 0;
+    int length = static_cast<int>(keys.size()) - 2;
+    while (length > 16)
+    {
+        int half = length / 2;
+        bool in_upper_half = keys[1 + offset + half - 1].time <= time;
+        offset = in_upper_half ? offset + half : offset;
+        length = in_upper_half ? length - half : half;
+    }
+    int key = offset;
+    for (int i = offset; i < offset + length; i++)
+    {
+        key += keys[1 + i].time <= time;
+    }
+    factor = std::min(std::max((time - keys[key].time) / (keys[key + 1].time - keys[key].time), 0.0f), 1.0f);
+    return key;
+}
+
+// samples every channel at random times, which defeats the playback cursor so every
+// sample runs a key search, returns average nanoseconds per channel sample
+double BenchRandomSampling(const aiAnimation* ai_anim, bool structure_of_arrays) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(0.0f, static_cast<float>(ai_anim->mDuration));
+    vector<float> sample_ticks(kBenchRandomSamples);
+    for (float& tick : sample_ticks)
+    {
+        tick = dist(rng);
+    }
+
+    const int num_channels = ai_anim->mNumChannels;
+    const float ticks_per_sec = static_cast<float>(ai_anim->mTicksPerSecond);
+    float sum = 0.0f;
+    Clock::time_point begin, end;
+
+    if (structure_of_arrays)
+    {
+        Animation anim(ai_anim);
+        AnimationCursor cursor = anim.CreateCursor();
+        begin = Clock::now();
+        for (int s = 0; s < kBenchRandomSamples; s++)
+        {
+            int channel = s % num_channels;
+            float time_in_sec = sample_ticks[s] / ticks_per_sec;
+            sum += anim.GetPosition(channel, time_in_sec, cursor, false).x;
+            sum += anim.GetRotation(channel, time_in_sec, cursor, false).w;
+            sum += anim.GetScale(channel, time_in_sec, cursor, false);
+        }
+        end = Clock::now();
+    }
+    else
+    {
+        vector<AosChannel> channels = BuildAosChannels(ai_anim);
+        begin = Clock::now();
+        for (int s = 0; s < kBenchRandomSamples; s++)
+        {
+            const AosChannel& channel = channels[s % num_channels];
+            float tick = sample_ticks[s];
+            float factor;
+            if (channel.position_keys.size() > 1)
+            {
+                int key = AosFindKey(channel.position_keys, tick, factor);
+                sum += Interpolate(channel.position_keys[key].position, channel.position_keys[key + 1].position, factor).x;
+            }
+            if (channel.rotation_keys.size() > 1)
+            {
+                int key = AosFindKey(channel.rotation_keys, tick, factor);
+                sum += Interpolate(channel.rotation_keys[key].quaternion, channel.rotation_keys[key + 1].quaternion, factor).w;
+            }
+            if (channel.scale_keys.size() > 1)
+            {
+                int key = AosFindKey(channel.scale_keys, tick, factor);
+                sum += Interpolate(channel.scale_keys[key].scale, channel.scale_keys[key + 1].scale, factor);
+            }
+        }
+        end = Clock::now();
+    }
+
+    g_sink = sum;
+    return std::chrono::duration<double, std::nano>(end - begin).count() / kBenchRandomSamples;
+}
+
+void BenchmarkKeyLayout() {
+    printf("== key layout: random time sampling, %d samples ==\n", kBenchRandomSamples);
+    printf("%24s %10s %14s %14s\n", "clip", "keys", "AoS ns/sample", "SoA ns/sample");
+
+    auto run = [](const char* clip_name, const aiAnimation* ai_anim) {
+        double aos_ns = BenchRandomSampling(ai_anim, false);
+        double soa_ns = BenchRandomSampling(ai_anim, true);
+        printf("%24s %10u %14.1f %14.1f\n", clip_name, ai_anim->mChannels[0]->mNumPositionKeys, aos_ns, soa_ns);
+    };
+
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(kBobAnimPath, 0);
+    if (scene != nullptr && scene->HasAnimations())
+    {
+        run("bob md5anim", scene->mAnimations[0]);
+    }
+    else
+    {
+        printf("%24s skipped, failed to load %s\n", "bob md5anim", kBobAnimPath);
+    }
+
+    aiAnimation* synthetic = CreateSyntheticClip(kBenchChannels, 10000);
+    run("synthetic", synthetic);
+    delete synthetic;
+}
+
+// memory and sampling cost of quantized keys, and their error against float keys
+void BenchmarkKeyFormat() {
+    printf("== key format: float vs quantized ==\n");
+    printf("%24s %12s %12s %14s %14s %14s %14s\n", "clip", "float KB", "packed KB", "float ns/frame", "packed ns/frame", "max pos error", "max rot error");
+
+    auto run = [](const char* clip_name, const aiAnimation* ai_anim) {
+        Animation float_anim(ai_anim);
+        Animation packed_anim(ai_anim);
+        packed_anim.QuantizeKeys();
+
+        double float_ns = BenchSampleFrames(float_anim, true);
+        double packed_ns = BenchSampleFrames(packed_anim, true);
+
+        float max_pos_error = 0.0f;
+        float max_rot_error = 0.0f;
+        AnimationCursor float_cursor = float_anim.CreateCursor();
+        AnimationCursor packed_cursor = packed_anim.CreateCursor();
+        for (int frame = 0; frame <= float_anim.total_frames_ * 4; frame++)
+        {
+            float normalized_time = frame / (float_anim.total_frames_ * 4.0f + 1.0f);
+            for (int i = 0; i < float_anim.GetChannelCount(); i++)
+            {
+                vec3 p1 = float_anim.GetPosition(i, normalized_time, float_cursor);
+                vec3 p2 = packed_anim.GetPosition(i, normalized_time, packed_cursor);
+                quat q1 = float_anim.GetRotation(i, normalized_time, float_cursor);
+                quat q2 = packed_anim.GetRotation(i, normalized_time, packed_cursor);
+                max_pos_error = std::max(max_pos_error, glm::distance(p1, p2));
+                max_rot_error = std::max(max_rot_error, 2.0f * std::acos(std::min(std::abs(glm::dot(q1, q2)), 1.0f)));
+            }
+        }
+
+        printf("%24s %12.1f %12.1f %14.1f %14.1f %14g %14g\n", clip_name,
+            float_anim.GetKeyMemorySize() / 1024.0, packed_anim.GetKeyMemorySize() / 1024.0,
+            float_ns, packed_ns, max_pos_error, max_rot_error);
+    };
+
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(kBobAnimPath, 0);
+    if (scene != nullptr && scene->HasAnimations())
+    {
+        run("bob md5anim", scene->mAnimations[0]);
+    }
+
+    aiAnimation* synthetic = CreateSyntheticClip(kBenchChannels, 10000);
+    run("synthetic", synthetic);
+    delete synthetic;
+}
+
+// pose hierarchy composition, glm mat4 path as the skeleton used to do it vs the batched affine path
+void BenchmarkPoseCompose() {
+    printf("== pose compose: glm mat4 vs affine 3x4 ==\n");
+#if defined(AFFINE_MATH_AVX2)
+    printf("affine path: avx2 + fma\n");
+#elif defined(AFFINE_MATH_SSE)
+    printf("affine path: sse\n");
+#else
+    printf("affine path: scalar\n");
+#endif
+    printf("%8s %14s %14s %14s %14s %14s\n", "bones", "glm ns/pose", "affine ns/pose", "glm ns/bone", "affine ns/bone", "max error");
+
+    for (int num_bones : { 33, 100, 1000 })
+    {
+        // random tree, parent before child as in a loaded skeleton
+        std::mt19937 rng(num_bones);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        vector<int> parent_indices(num_bones);
+        vector<vec3> translations(num_bones);
+        vector<quat> rotations(num_bones);
+        vector<float> scales(num_bones);
+        vector<mat4> offsets(num_bones);
+        vector<Affine3x4> affine_offsets(num_bones);
+        for (int i = 0; i < num_bones; i++)
+        {
+            parent_indices[i] = i == 0 ? -1 : std::uniform_int_distribution<int>(std::max(0, i - 4), i - 1)(rng);
+            translations[i] = vec3(dist(rng), dist(rng), dist(rng));
+            rotations[i] = glm::normalize(quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+            scales[i] = 1.0f + 0.1f * dist(rng);
+            offsets[i] = glm::translate(mat4(1.0f), vec3(dist(rng), dist(rng), dist(rng)));
+            affine_offsets[i] = ToAffine(offsets[i]);
+        }
+        mat4 root = glm::translate(mat4(1.0f), vec3(1.0f, 2.0f, 3.0f));
+        Affine3x4 affine_root = ToAffine(root);
+
+        vector<mat4> globals(num_bones);
+        vector<mat4> finals(num_bones);
+        vector<Affine3x4> affine_globals(num_bones);
+        vector<Affine3x4> affine_finals(num_bones);
+        const int num_poses = std::max(100, 200000 / num_bones);
+
+        auto begin = Clock::now();
+        for (int p = 0; p < num_poses; p++)
+        {
+            for (int i = 0; i < num_bones; i++)
+            {
+                mat4 local = glm::translate(mat4(1.0f), translations[i]) * glm::mat4_cast(rotations[i]) * glm::scale(mat4(1.0f), vec3(scales[i]));
+                globals[i] = (parent_indices[i] >= 0 ? globals[parent_indices[i]] : root) * local;
+                finals[i] = globals[i] * offsets[i];
+            }
+            g_sink = g_sink + finals[num_bones - 1][3][0];
+        }
+        double glm_ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / num_poses;
+
+        begin = Clock::now();
+        for (int p = 0; p < num_poses; p++)
+        {
+            ComposePoseHierarchy(num_bones, translations.data(), rotations.data(), scales.data(),
+                parent_indices.data(), affine_root, affine_offsets.data(), affine_globals.data(), affine_finals.data());
+            g_sink = g_sink + affine_finals[num_bones - 1].rows[0][3];
+        }
+        double affine_ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / num_poses;
+
+        float max_error = 0.0f;
+        for (int i = 0; i < num_bones; i++)
+        {
+            mat4 affine_final = ToMat4(affine_finals[i]);
+            for (int c = 0; c < 4; c++)
+            {
+                for (int r = 0; r < 4; r++)
+                {
+                    max_error = std::max(max_error, std::abs(affine_final[c][r] - finals[i][c][r]));
+                }
+            }
+        }
+
+        printf("%8d %14.1f %14.1f %14.2f %14.2f %14g\n", num_bones,
+            glm_ns, affine_ns, glm_ns / num_bones, affine_ns / num_bones, max_error);
+    }
+}
+
+// a mix of single clips and blends of the asset's first two clips,
+// desynchronized so cursors don't all hit the same keys
+void AddBenchInstances(AnimatedInstanceGroup& group, int num_instances) {
+    std::mt19937 rng(num_instances);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for (int i = 0; i < num_instances; i++)
+    {
+        AnimatedInstance& instance = group.AddInstance();
+        if (i % 4 == 3)
+        {
+            instance.PlayBlend(0, 1, dist(rng));
+        }
+        else
+        {
+            instance.PlaySingle(i % 2);
+        }
+        instance.SetTime(dist(rng));
+        instance.SetPlaybackSpeed(0.8f + 0.4f * dist(rng));
+    }
+}
+
+// many characters sharing one skeleton and its clips, each with its own playback and pose
+void BenchmarkInstances() {
+    printf("== animated instances: shared skeleton and clips ==\n");
+    printf("%10s %8s %14s %16s %14s\n", "instances", "bones", "ms/update", "instances/ms", "KB/instance");
+
+    const int num_bones = kBenchChannels;
+    Skeleton* skeleton = CreateSyntheticSkeleton(num_bones);
+    aiAnimation* ai_walk = CreateSyntheticClip(num_bones, 300);
+    aiAnimation* ai_run = CreateSyntheticClip(num_bones, 120, 60.0);
+    Animation walk(ai_walk);
+    Animation run(ai_run);
+    skeleton->BindAnimation(walk);
+    skeleton->BindAnimation(run);
+
+    CharacterAsset asset;
+    asset.p_skeleton = skeleton;
+    asset.animations = { &walk, &run };
+
+    for (int num_instances : { 1, 100, 1000, 4000 })
+    {
+        AnimatedInstanceGroup group(asset);
+        AddBenchInstances(group, num_instances);
+
+        const int num_updates = std::max(10, 20000 / num_instances);
+        auto begin = Clock::now();
+        for (int u = 0; u < num_updates; u++)
+        {
+            group.UpdateAll(kFrameDeltaSec);
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count() / num_updates;
+        g_sink = g_sink + group.GetInstance(num_instances - 1).GetFinalBoneTransform()[num_bones - 1][3][0];
+
+        // pose state that each instance owns, the skeleton and clips are counted once for all
+        double instance_bytes = sizeof(AnimatedInstance)
+            + num_bones * (2 * (sizeof(vec3) + sizeof(quat) + sizeof(float)) + 2 * sizeof(Affine3x4) + sizeof(mat4))
+            + 2 * num_bones * sizeof(ChannelCursor);
+
+        printf("%10d %8d %14.3f %16.1f %14.1f\n", num_instances, num_bones, ms, num_instances / ms, instance_bytes / 1024.0);
+    }
+
+    delete skeleton;
+    delete ai_walk;
+    delete ai_run;
+}
+
+// instance update on 1 to N threads, poses must match the single thread ones bit for bit
+void BenchmarkThreadScaling() {
+    printf("== thread scaling: AnimatedInstanceGroup::UpdateAll ==\n");
+    printf("%24s %8s %14s %10s %14s\n", "case", "threads", "ms/update", "speedup", "deterministic");
+
+    const int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    const int num_updates = 50;
+
+    // many small rigs scale over instances, one huge rig over bones
+    struct ScalingCase { const char* name; int num_bones; int num_instances; };
+    for (ScalingCase scaling_case : { ScalingCase{ "2000 x 64 bones", 64, 2000 }, ScalingCase{ "1 x 4096 bones", 4096, 1 } })
+    {
+        Skeleton* skeleton = CreateSyntheticSkeleton(scaling_case.num_bones);
+        aiAnimation* ai_walk = CreateSyntheticClip(scaling_case.num_bones, 300);
+        aiAnimation* ai_run = CreateSyntheticClip(scaling_case.num_bones, 120, 60.0);
+        Animation walk(ai_walk);
+        Animation run(ai_run);
+        skeleton->BindAnimation(walk);
+        skeleton->BindAnimation(run);
+
+        CharacterAsset asset;
+        asset.p_skeleton = skeleton;
+        asset.animations = { &walk, &run };
+
+        AnimatedInstanceGroup reference(asset);
+        AddBenchInstances(reference, scaling_case.num_instances);
+        for (int u = 0; u < num_updates; u++)
+        {
+            reference.UpdateAll(kFrameDeltaSec);
+        }
+
+        double single_thread_ms = 0.0;
+        for (int num_threads = 1; num_threads <= max_threads; num_threads++)
+        {
+            JobSystem job_system(num_threads);
+            AnimatedInstanceGroup group(asset);
+            AddBenchInstances(group, scaling_case.num_instances);
+
+            auto begin = Clock::now();
+            for (int u = 0; u < num_updates; u++)
+            {
+                group.UpdateAll(kFrameDeltaSec, &job_system);
+            }
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count() / num_updates;
+            if (num_threads == 1) single_thread_ms = ms;
+
+            bool deterministic = true;
+            for (int i = 0; i < scaling_case.num_instances; i++)
+            {
+                const vector<mat4>& palette = group.GetInstance(i).GetFinalBoneTransform();
+                const vector<mat4>& reference_palette = reference.GetInstance(i).GetFinalBoneTransform();
+                deterministic = deterministic && std::memcmp(palette.data(), reference_palette.data(), palette.size() * sizeof(mat4)) == 0;
+            }
+
+            printf("%24s %8d %14.3f %10.2f %14s\n", scaling_case.name, num_threads, ms, single_thread_ms / ms, deterministic ? "yes" : "NO");
+        }
+
+        delete skeleton;
+        delete ai_walk;
+        delete ai_run;
+    }
+}
+
+int main() {
+    BenchmarkKeyLookup();
+    BenchmarkKeyLayout();
+    BenchmarkKeyFormat();
+    BenchmarkPoseCompose();
+    BenchmarkInstances();
+    BenchmarkThreadScaling();
+    return 0;
+}
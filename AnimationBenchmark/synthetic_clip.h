@@ -0,0 +1,46 @@
+#ifndef SYNTHETIC_CLIP_H
+#define SYNTHETIC_CLIP_H
+
+#include <assimp/scene.h>
+
+#include <cmath>
+#include <string>
+
+// builds an assimp clip with num_channels channels named "bone_<i>",
+// each track has num_keys evenly spaced keys with smoothly varying values
+inline aiAnimation* CreateSyntheticClip(int num_channels, int num_keys, double ticks_per_sec = 30.0) {
+    aiAnimation* anim = new aiAnimation();
+    anim->mName = aiString("synthetic_" + std::to_string(num_keys));
+    anim->mDuration = num_keys - 1;
+    anim->mTicksPerSecond = ticks_per_sec;
+    anim->mNumChannels = num_channels;
+    anim->mChannels = new aiNodeAnim*[num_channels];
+
+    for (int i = 0; i < num_channels; i++)
+    {
+        aiNodeAnim* channel = new aiNodeAnim();
+        channel->mNodeName = aiString("bone_" + std::to_string(i));
+        channel->mNumPositionKeys = num_keys;
+        channel->mNumRotationKeys = num_keys;
+        channel->mNumScalingKeys = num_keys;
+        channel->mPositionKeys = new aiVectorKey[num_keys];
+        channel->mRotationKeys = new aiQuatKey[num_keys];
+        channel->mScalingKeys = new aiVectorKey[num_keys];
+
+        for (int j = 0; j < num_keys; j++)
+        {
+            float phase = 0.05f * j + 0.3f * i;
+            channel->mPositionKeys[j].mTime = j;
+            channel->mPositionKeys[j].mValue = aiVector3D(std::sin(phase), 1.0f, std::cos(phase));
+            channel->mRotationKeys[j].mTime = j;
+            channel->mRotationKeys[j].mValue = aiQuaternion(std::cos(phase * 0.5f), 0.0f, std::sin(phase * 0.5f), 0.0f);
+            channel->mScalingKeys[j].mTime = j;
+            channel->mScalingKeys[j].mValue = aiVector3D(1.0f, 1.0f, 1.0f);
+        }
+        anim->mChannels[i] = channel;
+    }
+
+    return anim;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef SYNTHETIC_RIG_H
+#define SYNTHETIC_RIG_H
+
+#include <assimp/scene.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "skeleton.h"
+
+// builds a skeleton of num_bones bones named "bone_<i>", matching the channels of CreateSyntheticClip,
+// bone i hangs under bone (i - 1) / 2 so parents come before children as in a loaded skeleton
+inline Skeleton* CreateSyntheticSkeleton(int num_bones) {
+    aiMesh mesh;
+    mesh.mNumBones = num_bones;
+    mesh.mBones = new aiBone*[num_bones];
+
+    std::unordered_map<std::string, std::string> node_parent;
+    std::unordered_map<std::string, mat4> node_transform;
+    for (int i = 0; i < num_bones; i++)
+    {
+        std::string name = "bone_" + std::to_string(i);
+        aiBone* bone = new aiBone();
+        bone->mName = aiString(name);
+        // offset is the inverse bind pose, bones sit one unit apart along y
+        aiMatrix4x4::Translation(aiVector3D(0.0f, -static_cast<float>(i), 0.0f), bone->mOffsetMatrix);
+        mesh.mBones[i] = bone;
+
+        node_transform[name] = glm::translate(mat4(1.0f), vec3(0.0f, 1.0f, 0.0f));
+        if (i > 0)
+        {
+            node_parent[name] = "bone_" + std::to_string((i - 1) / 2);
+        }
+    }
+
+    Skeleton* skeleton = new Skeleton();
+    vector<Vertex> vertices;
+    skeleton->LoadSkeletonAndRetrieveVertexInfo(&mesh, vertices);
+    skeleton->SetBoneChildToParent(node_parent);
+    skeleton->SetBoneBindTransform(node_transform);
+    return skeleton;
+}
+
+#endif
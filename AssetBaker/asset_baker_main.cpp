@@ -0,0 +1,241 @@
+// offline model baker, imports a model through assimp once and writes it as a baked model
+// that ModelData memory maps instead of importing
+// usage: AssetBaker <model path> [-o <baked path>] [--stream-blocks <seconds>]
+// the baked file goes next to the model by default, texture files are referenced relative to it
+// --stream-blocks splits clips into blocks of that many seconds, streamed from the file as they play
+//        AssetBaker --clean-image-cache <cache directory> [<max MB>]
+// deletes least recently used ImageDiskCache entries until the rest fit in max MB, all of them by default
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "baked_model_format.h"
+#include "baked_model_writer.h"
+#include "model_data.h"
+
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr int kVerifySamples = 16;
+
+
+string GetBakedPath(const string& model_path) {
+    size_t name_begin = model_path.find_last_of("/\\") + 1;
+    size_t extension_begin = model_path.find_last_of('.');
+    if (extension_begin == string::npos || extension_begin < name_begin)
+    {
+        return model_path + kBakedModelExtension;
+    }
+    return model_path.substr(0, extension_begin) + kBakedModelExtension;
+}
+
+string GetDirectoryOf(const string& path) {
+    size_t separator = path.find_last_of("/\\");
+    return separator == string::npos ? string(".") : path.substr(0, separator);
+}
+
+float ElapsedMs(Clock::time_point begin) {
+    return std::chrono::duration<float, std::milli>(Clock::now() - begin).count();
+}
+
+// throws a description of the first difference
+void Check(bool same, const string& what) {
+    if (same == false)
+    {
+        throw string("Baked model differs from the source in ") + what;
+    }
+}
+
+bool SameMatrix(const mat4& a, const mat4& b) {
+    return memcmp(&a, &b, sizeof(mat4)) == 0;
+}
+
+bool SameTrack(const Track& a, const Track& b) {
+    return a.num_keys == b.num_keys && a.time_offset == b.time_offset && a.value_offset == b.value_offset;
+}
+
+// the baked model has to be the imported one bit for bit, so are the poses sampled from it
+void VerifyBakedModel(const ModelData& source, const ModelData& baked) {
+    Check(source.GetVertexCount() == baked.GetVertexCount()
+        && memcmp(source.GetVertexData(), baked.GetVertexData(), sizeof(Vertex) * source.GetVertexCount()) == 0, "vertices");
+    Check(source.GetIndexCount() == baked.GetIndexCount()
+        && memcmp(source.GetIndexData(), baked.GetIndexData(), sizeof(unsigned int) * source.GetIndexCount()) == 0, "indices");
+
+    Check(source.GetMeshes().size() == baked.GetMeshes().size(), "mesh count");
+    for (size_t i = 0; i < source.GetMeshes().size(); i++)
+    {
+        const MeshData& a = source.GetMeshes()[i];
+        const MeshData& b = baked.GetMeshes()[i];
+        Check(a.first_vertex == b.first_vertex && a.num_vertices == b.num_vertices && a.first_index == b.first_index
+            && a.num_indices == b.num_indices && a.texture_indices == b.texture_indices, "mesh " + std::to_string(i));
+    }
+
+    Check(source.GetTextures().size() == baked.GetTextures().size(), "texture count");
+    for (size_t i = 0; i < source.GetTextures().size(); i++)
+    {
+        const TextureSource& a = source.GetTextures()[i];
+        const TextureSource& b = baked.GetTextures()[i];
+        Check(a.type == b.type && a.path == b.path && a.embedded == b.embedded, "texture " + a.path);
+        Check(a.p_image == b.p_image || (a.p_image != nullptr && b.p_image != nullptr && a.p_image->width == b.p_image->width
+            && a.p_image->height == b.p_image->height && a.p_image->pixels == b.p_image->pixels), "pixels of texture " + a.path);
+    }
+
+    Check(SameMatrix(source.GetCharacterAsset().root_transform, baked.GetCharacterAsset().root_transform), "root transform");
+    Check((source.GetSkeleton() == nullptr) == (baked.GetSkeleton() == nullptr), "skeleton");
+    if (source.GetSkeleton() != nullptr)
+    {
+        vector<BoneData> a = source.GetSkeleton()->GetBoneData();
+        vector<BoneData> b = baked.GetSkeleton()->GetBoneData();
+        Check(a.size() == b.size(), "bone count");
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            Check(a[i].name == b[i].name && a[i].parent_index == b[i].parent_index && SameMatrix(a[i].offset, b[i].offset)
+                && SameMatrix(a[i].bind_local_transform, b[i].bind_local_transform), "bone " + a[i].name);
+        }
+    }
+
+    Check(source.GetAnimations().size() == baked.GetAnimations().size(), "clip count");
+    for (size_t i = 0; i < source.GetAnimations().size(); i++)
+    {
+        AnimationClipData a = source.GetAnimations()[i]->GetClipData();
+        AnimationClipData b = baked.GetAnimations()[i]->GetClipData();
+        Check(a.name == b.name && a.total_frames == b.total_frames && a.frame_per_sec == b.frame_per_sec && a.total_sec == b.total_sec
+            && a.key_format == b.key_format && a.key_time_step == b.key_time_step && a.key_sample_mode == b.key_sample_mode
+            && a.keys_per_tick == b.keys_per_tick && a.num_uniform_keys == b.num_uniform_keys, "clip " + a.name);
+        // streamed clips hold no keys themselves, their blocks are checked by the poses below
+        if (baked.GetAnimations()[i]->IsStreamed())
+        {
+            Check(a.channels.size() == b.channels.size(), "channels of clip " + a.name);
+            continue;
+        }
+        Check(a.channels.size() == b.channels.size() && a.key_buffer.size() == b.key_buffer.size()
+            && memcmp(a.key_buffer.data(), b.key_buffer.data(), sizeof(KeyBlock) * a.key_buffer.size()) == 0, "keys of clip " + a.name);
+        for (size_t j = 0; j < a.channels.size(); j++)
+        {
+            Check(a.channels[j].name_ == b.channels[j].name_ && SameTrack(a.channels[j].position_track_, b.channels[j].position_track_)
+                && SameTrack(a.channels[j].rotation_track_, b.channels[j].rotation_track_)
+                && SameTrack(a.channels[j].scale_track_, b.channels[j].scale_track_), "channel " + a.channels[j].name_ + " of clip " + a.name);
+        }
+    }
+
+    // end to end, the palettes of both models, with every block of streamed clips resident
+    if (source.GetSkeleton() == nullptr)
+    {
+        return;
+    }
+    if (baked.GetClipStreamer() != nullptr)
+    {
+        baked.GetClipStreamer()->LoadAll();
+    }
+    const CharacterAsset& source_asset = source.GetCharacterAsset();
+    const CharacterAsset& baked_asset = baked.GetCharacterAsset();
+    PoseState source_state = source.GetSkeleton()->CreatePoseState();
+    PoseState baked_state = baked.GetSkeleton()->CreatePoseState();
+    PoseScratch scratch;
+    for (size_t i = 0; i < source.GetAnimations().size(); i++)
+    {
+        const Animation& source_anim = *source.GetAnimations()[i];
+        const Animation& baked_anim = *baked.GetAnimations()[i];
+        for (int sample = 0; sample <= kVerifySamples; sample++)
+        {
+            float time = source_anim.total_sec_ * sample / kVerifySamples;
+            source.GetSkeleton()->CalcBoneAnimTransform(source_anim, time, source_state, scratch, source_asset.root_transform);
+            baked.GetSkeleton()->CalcBoneAnimTransform(baked_anim, time, baked_state, scratch, baked_asset.root_transform);
+            Check(memcmp(source_state.final_bone_transform.data(), baked_state.final_bone_transform.data(),
+                sizeof(mat4) * source_state.final_bone_transform.size()) == 0, "poses of clip " + source_anim.anim_name_);
+        }
+    }
+}
+
+int CleanImageCache(const string& directory, size_t max_bytes) {
+    ImageDiskCache& disk_cache = ImageDiskCache::Get();
+    disk_cache.SetDirectory(directory);
+    DiskCacheStats before = disk_cache.GetStats();
+    int num_deleted = disk_cache.Trim(max_bytes);
+    DiskCacheStats after = disk_cache.GetStats();
+    printf("%s: deleted %d of %d entries, %.2f MB -> %.2f MB\n", directory.c_str(), num_deleted, before.files,
+        before.size_bytes / (1024.0 * 1024.0), after.size_bytes / (1024.0 * 1024.0));
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || (strcmp(argv[1], "--clean-image-cache") == 0 && argc < 3))
+    {
+        fprintf(stderr, "usage: AssetBaker <model path> [-o <baked path>] [--stream-blocks <seconds>]\n"
+            "       AssetBaker --clean-image-cache <cache directory> [<max MB>]\n");
+        return 1;
+    }
+    if (strcmp(argv[1], "--clean-image-cache") == 0)
+    {
+        size_t max_mb = argc > 3 ? static_cast<size_t>(std::max(std::atoi(argv[3]), 0)) : 0;
+        return CleanImageCache(argv[2], max_mb * 1024 * 1024);
+    }
+
+    string model_path = argv[1];
+    string baked_path = GetBakedPath(model_path);
+    float stream_block_sec = 0.0f;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-o") == 0)
+        {
+            baked_path = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--stream-blocks") == 0)
+        {
+            stream_block_sec = static_cast<float>(std::atof(argv[i + 1]));
+        }
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+        }
+    }
+    if (GetDirectoryOf(baked_path) != GetDirectoryOf(model_path))
+    {
+        std::cout << "Warning: texture files are looked up next to " << baked_path << ", copy them from " << GetDirectoryOf(model_path) << std::endl;
+    }
+
+    try
+    {
+        float import_ms = 0.0f;
+        {
+            // timed while ImageCache is empty, as a first load of the model would be
+            auto import_begin = Clock::now();
+            ModelData source(model_path);
+            import_ms = ElapsedMs(import_begin);
+
+            WriteBakedModel(source, baked_path, stream_block_sec);
+            std::cout << "Baked " << model_path << " to " << baked_path << std::endl;
+
+            ModelData baked(baked_path);
+            VerifyBakedModel(source, baked);
+            std::cout << "Verified " << source.GetMeshes().size() << " meshes, " << source.GetTextures().size() << " textures, "
+                << source.GetAnimations().size() << " clips" << std::endl;
+            if (baked.GetClipStreamer() != nullptr)
+            {
+                ClipStreamStats stats = baked.GetClipStreamer()->GetStats();
+                std::cout << "Streamed clips: " << stats.resident_blocks << " blocks of " << stream_block_sec << " s, "
+                    << stats.resident_bytes / 1024.0f << " KB" << std::endl;
+            }
+        }
+        ImageCache::Get().EvictUnused();
+
+        auto load_begin = Clock::now();
+        ModelData baked(baked_path);
+        float load_ms = ElapsedMs(load_begin);
+
+        printf("import %.2f ms, baked load %.2f ms, %.1fx faster\n", import_ms, load_ms, load_ms > 0.0f ? import_ms / load_ms : 0.0f);
+    }
+    catch (string error_message)
+    {
+        fprintf(stderr, "%s: %s\n", model_path.c_str(), error_message.c_str());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,226 @@
+#include "baked_model_writer.h"
+
+#include "baked_model_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+using std::unordered_map;
+using std::vector;
+
+
+namespace
+{
+    using Section = vector<unsigned char>;
+
+    template<typename T>
+    void AppendArray(Section& section, const T* data, size_t count) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+        section.insert(section.end(), bytes, bytes + sizeof(T) * count);
+    }
+
+    template<typename T>
+    void Append(Section& section, const T& value) {
+        AppendArray(section, &value, 1);
+    }
+
+    void PadToAlignment(Section& section) {
+        section.resize((section.size() + kBakedSectionAlignment - 1) / kBakedSectionAlignment * kBakedSectionAlignment, 0);
+    }
+
+    // null terminated strings, each stored once
+    class StringTable
+    {
+    public:
+        uint32_t Add(const string& str) {
+            auto iter = offsets_.find(str);
+            if (iter != offsets_.end())
+            {
+                return iter->second;
+            }
+
+            uint32_t offset = static_cast<uint32_t>(data_.size());
+            data_.insert(data_.end(), str.begin(), str.end());
+            data_.push_back(0);
+            offsets_.emplace(str, offset);
+            return offset;
+        }
+
+        const Section& GetData() const { return data_; }
+
+    private:
+        Section data_;
+        unordered_map<string, uint32_t> offsets_;
+    };
+}
+
+
+void WriteBakedModel(const ModelData& model_data, const string& path, float stream_block_sec) {
+    vector<Section> sections(static_cast<size_t>(EBakedSection::eCount));
+    auto section = [&](EBakedSection type) -> Section& { return sections[static_cast<size_t>(type)]; };
+    StringTable strings;
+
+    // meshes and their buffers, already merged in ModelData
+    for (const MeshData& mesh_data : model_data.GetMeshes())
+    {
+        BakedMesh mesh;
+        mesh.first_vertex = mesh_data.first_vertex;
+        mesh.num_vertices = mesh_data.num_vertices;
+        mesh.first_index = mesh_data.first_index;
+        mesh.num_indices = mesh_data.num_indices;
+        mesh.first_texture_ref = static_cast<uint32_t>(section(EBakedSection::eTextureRefs).size() / sizeof(int32_t));
+        mesh.num_texture_refs = static_cast<uint32_t>(mesh_data.texture_indices.size());
+        Append(section(EBakedSection::eMeshes), mesh);
+
+        for (int texture_index : mesh_data.texture_indices)
+        {
+            Append(section(EBakedSection::eTextureRefs), static_cast<int32_t>(texture_index));
+        }
+    }
+    AppendArray(section(EBakedSection::eVertices), model_data.GetVertexData(), model_data.GetVertexCount());
+    AppendArray(section(EBakedSection::eIndices), model_data.GetIndexData(), model_data.GetIndexCount());
+
+    // texture files stay references, embedded images are stored decoded
+    for (const TextureSource& source : model_data.GetTextures())
+    {
+        BakedTexture texture = {};
+        texture.type = strings.Add(source.type);
+        texture.path = strings.Add(source.path);
+        if (source.embedded && source.p_image != nullptr && source.p_image->IsValid())
+        {
+            Section& pixels = section(EBakedSection::ePixels);
+            PadToAlignment(pixels);
+            texture.cache_key = strings.Add(source.cache_key);
+            texture.width = source.p_image->width;
+            texture.height = source.p_image->height;
+            texture.components = source.p_image->components;
+            texture.pixel_offset = pixels.size();
+            texture.pixel_size = source.p_image->pixels.size();
+            AppendArray(pixels, source.p_image->pixels.data(), source.p_image->pixels.size());
+        }
+        else
+        {
+            texture.cache_key = strings.Add(string());
+        }
+        Append(section(EBakedSection::eTextures), texture);
+    }
+
+    const Skeleton* p_skeleton = model_data.GetSkeleton();
+    if (p_skeleton != nullptr)
+    {
+        for (const BoneData& bone_data : p_skeleton->GetBoneData())
+        {
+            BakedBone bone;
+            memcpy(bone.offset, &bone_data.offset, sizeof(bone.offset));
+            memcpy(bone.bind_local_transform, &bone_data.bind_local_transform, sizeof(bone.bind_local_transform));
+            bone.parent_index = bone_data.parent_index;
+            bone.name = strings.Add(bone_data.name);
+            Append(section(EBakedSection::eBones), bone);
+        }
+    }
+
+    for (const Animation* p_anim : model_data.GetAnimations())
+    {
+        AnimationClipData clip_data = p_anim->GetClipData();
+
+        BakedClip clip = {};
+        clip.name = strings.Add(clip_data.name);
+        clip.total_frames = clip_data.total_frames;
+        clip.frame_per_sec = clip_data.frame_per_sec;
+        clip.total_sec = clip_data.total_sec;
+        clip.key_format = static_cast<uint32_t>(clip_data.key_format);
+        clip.key_time_step = clip_data.key_time_step;
+        clip.key_sample_mode = static_cast<uint32_t>(clip_data.key_sample_mode);
+        clip.keys_per_tick = clip_data.keys_per_tick;
+        clip.num_uniform_keys = clip_data.num_uniform_keys;
+        clip.first_channel = static_cast<uint32_t>(section(EBakedSection::eChannels).size() / sizeof(BakedChannel));
+        clip.num_channels = static_cast<uint32_t>(clip_data.channels.size());
+        clip.first_key_block = section(EBakedSection::eKeyBlocks).size() / sizeof(KeyBlock);
+        clip.first_stream_block = section(EBakedSection::eStreamBlocks).size() / sizeof(BakedStreamBlock);
+
+        const bool streamed = stream_block_sec > 0.0f && clip_data.frame_per_sec > 0.0f;
+        if (streamed)
+        {
+            // blocks hold the keys, the clip keeps channel names only
+            clip.stream_block_ticks = stream_block_sec * clip_data.frame_per_sec;
+            int num_blocks = std::max(static_cast<int>(std::ceil(clip_data.total_frames / clip.stream_block_ticks)), 1);
+            for (int i = 0; i < num_blocks; i++)
+            {
+                float begin_tick = i * clip.stream_block_ticks;
+                float end_tick = std::min((i + 1) * clip.stream_block_ticks, static_cast<float>(clip_data.total_frames));
+                AnimationClipData block_data = p_anim->ExtractBlock(begin_tick, end_tick);
+
+                Section& stream_data = section(EBakedSection::eStreamData);
+                PadToAlignment(stream_data);
+                BakedStreamBlock block = {};
+                block.begin_tick = begin_tick;
+                block.end_tick = end_tick;
+                block.first_uniform_key = block_data.first_uniform_key;
+                block.offset = stream_data.size();
+                for (const Channel& channel : block_data.channels)
+                {
+                    Append(stream_data, channel.position_track_);
+                    Append(stream_data, channel.rotation_track_);
+                    Append(stream_data, channel.scale_track_);
+                }
+                stream_data.resize(block.offset + GetStreamBlockKeyOffset(block_data.channels.size()), 0);
+                AppendArray(stream_data, block_data.key_buffer.data(), block_data.key_buffer.size());
+                block.size = stream_data.size() - block.offset;
+                Append(section(EBakedSection::eStreamBlocks), block);
+            }
+            clip.num_stream_blocks = num_blocks;
+        }
+        else
+        {
+            clip.num_key_blocks = clip_data.key_buffer.size();
+            AppendArray(section(EBakedSection::eKeyBlocks), clip_data.key_buffer.data(), clip_data.key_buffer.size());
+        }
+        Append(section(EBakedSection::eClips), clip);
+
+        for (const Channel& channel : clip_data.channels)
+        {
+            BakedChannel baked_channel = {};
+            baked_channel.name = strings.Add(channel.name_);
+            if (streamed == false)
+            {
+                baked_channel.position_track = channel.position_track_;
+                baked_channel.rotation_track = channel.rotation_track_;
+                baked_channel.scale_track = channel.scale_track_;
+            }
+            Append(section(EBakedSection::eChannels), baked_channel);
+        }
+    }
+    section(EBakedSection::eStrings) = strings.GetData();
+
+    // header, section table, then every payload at an aligned offset
+    BakedFileHeader header = {};
+    memcpy(header.magic, kBakedModelMagic, sizeof(kBakedModelMagic));
+    header.version = kBakedModelVersion;
+    header.endian_tag = kBakedEndianTag;
+    header.vertex_size = sizeof(Vertex);
+    header.section_count = static_cast<uint32_t>(EBakedSection::eCount);
+    header.has_skeleton = p_skeleton != nullptr ? 1 : 0;
+    memcpy(header.root_transform, &model_data.GetCharacterAsset().root_transform, sizeof(header.root_transform));
+
+    Section file;
+    Append(file, header);
+    size_t table_offset = file.size();
+    file.resize(file.size() + sizeof(BakedSection) * sections.size());
+    for (size_t i = 0; i < sections.size(); i++)
+    {
+        PadToAlignment(file);
+        BakedSection baked_section = { file.size(), sections[i].size() };
+        memcpy(file.data() + table_offset + sizeof(BakedSection) * i, &baked_section, sizeof(baked_section));
+        file.insert(file.end(), sections[i].begin(), sections[i].end());
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(file.data()), file.size());
+    if (!out)
+    {
+        throw string("Can't write baked model: ") + path;
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef BAKED_MODEL_WRITER_H
+#define BAKED_MODEL_WRITER_H
+
+#include <string>
+using std::string;
+
+#include "model_data.h"
+
+// writes model_data as a baked model file (baked_model_format.h), throws string on failure
+// texture files are referenced by their path relative to the model directory, so the baked file
+// has to be placed in the directory of the source model
+// stream_block_sec > 0 splits clips into blocks of that duration which are streamed from the file at run time
+void WriteBakedModel(const ModelData& model_data, const string& path, float stream_block_sec = 0.0f);
+
+#endif
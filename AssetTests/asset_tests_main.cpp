@@ -0,0 +1,332 @@
+// checks of the CPU side of the asset formats, they need no GL context and AssetBaker doesn't run them
+// usage: AssetTests [<model path> ...]
+// runs every model test on each model, bob by default, prints one line per test and returns the number of failures
+// vertex packing edge cases: zero length normals, overweight influences, bone id 254 beside the unused slot id,
+// large and NaN texture coordinates pack as utility/vertex_packing.h says, runs once without a model
+// vertex packing: the model's vertices survive EVertexFormat::ePacked within the packing bounds
+// palette encodings: the vertices skinned with every EPaletteEncoding over each clip stay within its bound of eMat4
+// vertex animation textures: every clip baked into each kind of texture stays within its bound of the live poses,
+// and a clip needing more than kMaxVatHeight rows doesn't bake
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "model_data.h"
+#include "vertex_animation_texture.h"
+#include "utility/skinning_palette.h"
+#include "utility/vertex_packing.h"
+
+constexpr int kVerifySamples = 16;
+// the rate crowds bake their vertex animation textures at
+constexpr float kVatFrameRate = 30.0f;
+const char* kDefaultModelPath = "../Animation/resource/bob/boblampclean.md5mesh";
+
+struct TestRun
+{
+    int num_passed = 0;
+    int num_failed = 0;
+};
+
+// a test throws a description of the first thing that failed
+template<typename TTest>
+void RunTest(const string& name, TestRun& run, TTest test) {
+    try
+    {
+        test();
+        run.num_passed++;
+        std::cout << "pass " << name << std::endl;
+    }
+    catch (string error_message)
+    {
+        run.num_failed++;
+        std::cout << "FAIL " << name << ": " << error_message << std::endl;
+    }
+}
+
+// throws what when passed is false
+void Expect(bool passed, const string& what) {
+    if (passed == false)
+    {
+        throw what;
+    }
+}
+
+
+// a unit tangent frame and one bone at full weight, each case changes what it tests
+Vertex MakeVertex() {
+    Vertex vertex;
+    vertex.position = vec3(0.25f, -1.5f, 3.0f);
+    vertex.normal = vec3(0.0f, 0.0f, 1.0f);
+    vertex.tex_coords = glm::vec2(0.5f, 0.25f);
+    vertex.tangent = vec3(1.0f, 0.0f, 0.0f);
+    vertex.bitangent = vec3(0.0f, 1.0f, 0.0f);
+    vertex.bone_id[0] = 0;
+    vertex.weights[0] = 1.0f;
+    return vertex;
+}
+
+void TestVertexPackingEdgeCases() {
+    {
+        Vertex vertex = MakeVertex();
+        vertex.normal = vec3(0.0f);
+        vertex.tangent = vec3(0.0f);
+        Vertex unpacked = UnpackVertex(PackVertex(vertex));
+        Expect(std::abs(glm::length(unpacked.normal) - 1.0f) < 1e-4f, "a zero length normal doesn't unpack to a unit vector");
+        Expect(unpacked.tangent == vec3(0.0f), "a zero length tangent unpacks as a tangent frame");
+        Expect(IsWithinPackingBounds(MeasurePackingError(&vertex, 1)), "a zero length normal is measured");
+    }
+    {
+        Vertex vertex = MakeVertex();
+        vertex.bone_id[1] = 1;
+        vertex.weights[0] = 0.7f;
+        vertex.weights[1] = 0.6f;
+        PackedVertex packed = PackVertex(vertex);
+        Expect(packed.weights[0] + packed.weights[1] + packed.weights[2] + packed.weights[3] == 255, "weights summing to 1.3 don't pack to a sum of 255");
+        Vertex unpacked = UnpackVertex(packed);
+        for (int i = 0; i < 2; i++)
+        {
+            Expect(std::abs(unpacked.weights[i] - vertex.weights[i] / 1.3f) <= kMaxPackedWeightError, "weights summing to 1.3 lose their ratio");
+        }
+    }
+    {
+        Vertex vertex = MakeVertex();
+        vertex.bone_id[1] = static_cast<int>(kPackedNoBone) - 1;
+        vertex.weights[0] = 0.5f;
+        vertex.weights[1] = 0.5f;
+        Expect(CanPackVertices(&vertex, 1), "bone id 254 can't be packed");
+        PackedVertex packed = PackVertex(vertex);
+        Expect(packed.bone_id[1] == kPackedNoBone - 1 && packed.bone_id[2] == kPackedNoBone && packed.bone_id[3] == kPackedNoBone,
+            "bone id 254 isn't told apart from the unused slots");
+        Vertex unpacked = UnpackVertex(packed);
+        Expect(unpacked.bone_id[1] == static_cast<int>(kPackedNoBone) - 1 && unpacked.bone_id[2] == -1 && unpacked.bone_id[3] == -1,
+            "bone id 254 doesn't round trip");
+        VertexPackingError error = MeasurePackingError(&vertex, 1);
+        Expect(IsWithinPackingBounds(error), "bone id 254 packs past the bounds");
+
+        vertex.bone_id[1] = kPackedNoBone;
+        Expect(CanPackVertices(&vertex, 1) == false, "bone id 255 is packed as an unused slot");
+    }
+    {
+        Vertex vertex = MakeVertex();
+        vertex.tex_coords = glm::vec2(1000.37f, -4095.9f);
+        VertexPackingError error = MeasurePackingError(&vertex, 1);
+        Expect(error.tex_coord <= kMaxPackedTexCoordError && error.mismatches == 0, "texture coordinates in the thousands pack past the bound");
+        // past the largest half float, 65504
+        vertex.tex_coords = glm::vec2(70000.0f, 0.0f);
+        Expect(IsWithinPackingBounds(MeasurePackingError(&vertex, 1)) == false, "a texture coordinate past the half float range isn't reported");
+    }
+    {
+        const float nan = std::nanf("");
+        Vertex vertex = MakeVertex();
+        vertex.position.x = nan;
+        Expect(IsWithinPackingBounds(MeasurePackingError(&vertex, 1)), "a NaN position doesn't round trip");
+
+        vertex = MakeVertex();
+        vertex.tex_coords.x = nan;
+        Expect(MeasurePackingError(&vertex, 1).mismatches == 1, "a NaN texture coordinate isn't reported");
+
+        vertex = MakeVertex();
+        vertex.normal.y = nan;
+        vertex.tangent.z = nan;
+        Vertex unpacked = UnpackVertex(PackVertex(vertex));
+        Expect(std::abs(glm::length(unpacked.normal) - 1.0f) < 1e-4f && unpacked.tangent == vec3(0.0f), "a NaN normal or tangent isn't packed as missing");
+        Expect(MeasurePackingError(&vertex, 1).mismatches == 1, "a NaN normal or tangent isn't reported");
+
+        vertex = MakeVertex();
+        vertex.bone_id[1] = 1;
+        vertex.weights[1] = nan;
+        PackedVertex packed = PackVertex(vertex);
+        Expect(packed.weights[0] == 255 && packed.weights[1] == 0, "a NaN weight isn't packed as 0");
+        Expect(MeasurePackingError(&vertex, 1).mismatches == 1, "a NaN weight isn't reported");
+    }
+}
+
+// packs the vertices as EVertexFormat::ePacked uploads them and bounds what the round trip loses
+void TestVertexPacking(const ModelData& model) {
+    if (CanPackVertices(model.GetVertexData(), model.GetVertexCount()) == false)
+    {
+        std::cout << "Vertices can't be packed, bone ids past " << static_cast<int>(kPackedNoBone) - 1 << ", they upload in full" << std::endl;
+        return;
+    }
+    VertexPackingError error = MeasurePackingError(model.GetVertexData(), model.GetVertexCount());
+    printf("Packed vertices %zu -> %zu bytes, max error: normal %.4f deg, tangent %.3f deg, bitangent %.3f deg, uv %.6f, weight %.4f\n",
+        sizeof(Vertex), sizeof(PackedVertex), error.normal_deg, error.tangent_deg, error.bitangent_deg, error.tex_coord, error.weight);
+    if (IsWithinPackingBounds(error) == false)
+    {
+        throw string("Packed vertices exceed the precision bounds, ") + std::to_string(error.mismatches) + " values changed";
+    }
+}
+
+// influenced by one bone at full weight, where dual quaternion and linear blending agree
+bool HasSingleBone(const Vertex& vertex) {
+    int num_bones = 0;
+    float weight = 0.0f;
+    for (int i = 0; i < kMaxBonePerVertex; i++)
+    {
+        if (vertex.bone_id[i] >= 0 && vertex.weights[i] > 0.0f)
+        {
+            num_bones++;
+            weight = vertex.weights[i];
+        }
+    }
+    return num_bones == 1 && std::abs(weight - 1.0f) < 1e-3f;
+}
+
+// skins the vertices with every palette encoding over each clip, as lighting.vs does, and compares them to eMat4
+void TestPaletteEncodings(const ModelData& model) {
+    const Skeleton* p_skeleton = model.GetSkeleton();
+    if (p_skeleton == nullptr || model.GetAnimations().empty())
+    {
+        return;
+    }
+    const Vertex* vertices = model.GetVertexData();
+    size_t num_vertices = model.GetVertexCount();
+    int num_bones = p_skeleton->GetBoneCount();
+    const EPaletteEncoding encodings[] = { EPaletteEncoding::eMat4, EPaletteEncoding::eAffine3x4, EPaletteEncoding::eDualQuat };
+    vector<float> palettes[3];
+    for (int e = 0; e < 3; e++)
+    {
+        palettes[e].resize(num_bones * 4 * GetPaletteVec4sPerBone(encodings[e]));
+    }
+
+    PoseState state = p_skeleton->CreatePoseState();
+    PoseScratch scratch;
+    float model_size = 1e-6f;
+    float affine_error = 0.0f;
+    float dual_quat_error = 0.0f;
+    float dual_quat_blend_difference = 0.0f;
+    float non_rigidity = 0.0f;
+    for (const Animation* p_anim : model.GetAnimations())
+    {
+        for (int sample = 0; sample <= kVerifySamples; sample++)
+        {
+            p_skeleton->CalcBoneAnimTransform(*p_anim, static_cast<float>(sample) / kVerifySamples, state, scratch, model.GetCharacterAsset().root_transform);
+            for (int e = 0; e < 3; e++)
+            {
+                EncodePalette(state.final_affine_transform.data(), num_bones, encodings[e], palettes[e].data());
+            }
+            for (int b = 0; b < num_bones; b++)
+            {
+                non_rigidity = std::max(non_rigidity, MeasureNonRigidity(state.final_affine_transform[b]));
+            }
+            for (size_t v = 0; v < num_vertices; v++)
+            {
+                vec3 reference = SkinPosition(palettes[0].data(), encodings[0], vertices[v]);
+                model_size = std::max(model_size, glm::length(reference));
+                affine_error = std::max(affine_error, glm::distance(reference, SkinPosition(palettes[1].data(), encodings[1], vertices[v])));
+                float dual_quat_distance = glm::distance(reference, SkinPosition(palettes[2].data(), encodings[2], vertices[v]));
+                if (HasSingleBone(vertices[v]))
+                {
+                    dual_quat_error = std::max(dual_quat_error, dual_quat_distance);
+                }
+                else
+                {
+                    dual_quat_blend_difference = std::max(dual_quat_blend_difference, dual_quat_distance);
+                }
+            }
+        }
+    }
+
+    printf("Palette bytes per bone %zu / %zu / %zu, max distance from eMat4 relative to model size: eAffine3x4 %.2e, "
+        "eDualQuat %.2e on single bone vertices, %.2e on blended ones (a different blend by design)\n",
+        4 * sizeof(float) * GetPaletteVec4sPerBone(encodings[0]), 4 * sizeof(float) * GetPaletteVec4sPerBone(encodings[1]),
+        4 * sizeof(float) * GetPaletteVec4sPerBone(encodings[2]), affine_error / model_size, dual_quat_error / model_size, dual_quat_blend_difference / model_size);
+    if (affine_error / model_size > kMaxPaletteRelativeError)
+    {
+        throw string("eAffine3x4 palettes move vertices past the bound");
+    }
+    if (non_rigidity > kMaxDualQuatNonRigidity)
+    {
+        std::cout << "Warning: bones have shear or non uniform scale, " << non_rigidity << " from rigid, eDualQuat palettes drop it" << std::endl;
+    }
+    else if (dual_quat_error / model_size > kMaxPaletteRelativeError)
+    {
+        throw string("eDualQuat palettes move vertices past the bound");
+    }
+}
+
+// bakes each clip into every content and precision of vertex animation texture and compares their frames to live poses
+void TestVertexAnimationTextures(const ModelData& model) {
+    const Skeleton* p_skeleton = model.GetSkeleton();
+    if (p_skeleton == nullptr || model.GetAnimations().empty())
+    {
+        return;
+    }
+    const EVatContent contents[] = { EVatContent::eBonePalette, EVatContent::eSkinnedVertices };
+    const EVatPrecision precisions[] = { EVatPrecision::eFloat, EVatPrecision::eHalf };
+    const char* names[2][2] = { { "palette", "palette-half" }, { "vertices", "vertices-half" } };
+    for (const Animation* p_anim : model.GetAnimations())
+    {
+        std::cout << "Vertex animation textures of " << p_anim->anim_name_ << " at " << kVatFrameRate << " fps:";
+        for (int c = 0; c < 2; c++)
+        {
+            for (int p = 0; p < 2; p++)
+            {
+                VertexAnimationTexture vat = BakeVertexAnimationTexture(*p_skeleton, *p_anim, model.GetCharacterAsset().root_transform,
+                    model.GetVertexData(), model.GetVertexCount(), contents[c], precisions[p], kVatFrameRate);
+                float error = MeasureVatError(vat, *p_skeleton, *p_anim, model.GetCharacterAsset().root_transform,
+                    model.GetVertexData(), model.GetVertexCount());
+                printf(" %s %dx%d %.1f KB %.2e,", names[c][p], vat.width, vat.GetHeight(), vat.GetMemorySize() / 1024.0f, error);
+                float bound = precisions[p] == EVatPrecision::eHalf ? kMaxVatHalfRelativeError : kMaxVatFloatRelativeError;
+                if (error > bound)
+                {
+                    std::cout << std::endl;
+                    throw string(names[c][p]) + " vertex animation texture of " + p_anim->anim_name_ + " strays from the live poses past the bound";
+                }
+            }
+        }
+        std::cout << " max distance from live poses relative to model size" << std::endl;
+    }
+
+    // at least one row per frame, so a frame more than kMaxVatHeight, baking throws before posing any
+    const Animation& anim = *model.GetAnimations()[0];
+    if (anim.total_sec_ > 0.0f)
+    {
+        bool thrown = false;
+        try
+        {
+            BakeVertexAnimationTexture(*p_skeleton, anim, model.GetCharacterAsset().root_transform, model.GetVertexData(), model.GetVertexCount(),
+                EVatContent::eBonePalette, EVatPrecision::eFloat, (kMaxVatHeight + 1) / anim.total_sec_);
+        }
+        catch (string)
+        {
+            thrown = true;
+        }
+        if (thrown == false)
+        {
+            throw string("a vertex animation texture taller than kMaxVatHeight was baked");
+        }
+    }
+}
+
+
+int main(int argc, char** argv) {
+    vector<string> model_paths(argv + 1, argv + argc);
+    if (model_paths.empty())
+    {
+        model_paths.push_back(kDefaultModelPath);
+    }
+
+    TestRun run;
+    RunTest("vertex packing edge cases", run, TestVertexPackingEdgeCases);
+    for (const string& model_path : model_paths)
+    {
+        std::unique_ptr<ModelData> p_model;
+        RunTest("load " + model_path, run, [&]() { p_model = std::make_unique<ModelData>(model_path); });
+        if (p_model == nullptr)
+        {
+            continue;
+        }
+        RunTest("vertex packing " + model_path, run, [&]() { TestVertexPacking(*p_model); });
+        RunTest("palette encodings " + model_path, run, [&]() { TestPaletteEncodings(*p_model); });
+        RunTest("vertex animation textures " + model_path, run, [&]() { TestVertexAnimationTextures(*p_model); });
+    }
+
+    printf("%d passed, %d failed\n", run.num_passed, run.num_failed);
+    return run.num_failed;
+}
@@ -0,0 +1,263 @@
+// headless pose evaluation benchmark, imports models through ModelData so it needs no GL context
+// usage: PoseBenchmark [--instances N] [--frames N] [--bones N,N,...] [--model path] [--clip-budget-kb N] [--out path]
+// prints one JSON object per line and rig/operation, --out also appends them to a file
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "model_data.h"
+#include "synthetic_scene.h"
+
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr float kFrameDeltaSec = 1.0f / 60.0f;
+
+// every heap allocation of the process goes through here, so the pose loop can be checked for allocations
+static std::atomic<long long> g_num_allocations{ 0 };
+
+void* operator new(size_t size) {
+    g_num_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size > 0 ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// keeps the optimizer from removing the pose loops
+static volatile float g_sink = 0.0f;
+
+
+struct BenchOption
+{
+    int num_instances = 100;
+    int num_frames = 300;
+    vector<int> synthetic_bones = { 64, 256, 1024 };
+    string model_path = "../Animation/resource/bob/boblampclean.md5mesh";
+    // baked models with streamed clips only, 0 keeps ClipStreamer's default
+    int clip_budget_kb = 0;
+    string out_path;
+};
+
+BenchOption ParseOption(int argc, char** argv) {
+    BenchOption option;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string key = argv[i];
+        string value = argv[i + 1];
+        if (key == "--instances")
+        {
+            option.num_instances = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (key == "--frames")
+        {
+            option.num_frames = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (key == "--bones")
+        {
+            option.synthetic_bones.clear();
+            std::stringstream stream(value);
+            string item;
+            while (std::getline(stream, item, ','))
+            {
+                if (std::atoi(item.c_str()) > 0) option.synthetic_bones.push_back(std::atoi(item.c_str()));
+            }
+        }
+        else if (key == "--model")
+        {
+            option.model_path = value;
+        }
+        else if (key == "--clip-budget-kb")
+        {
+            option.clip_budget_kb = std::max(0, std::atoi(value.c_str()));
+        }
+        else if (key == "--out")
+        {
+            option.out_path = value;
+        }
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", key.c_str());
+        }
+    }
+    return option;
+}
+
+
+enum class EPoseOperation
+{
+    eCalcBoneAnimTransform,
+    eBlendBoneAnimTransform,
+    eTransitionAnim
+};
+
+const char* GetOperationName(EPoseOperation operation) {
+    switch (operation)
+    {
+    case EPoseOperation::eCalcBoneAnimTransform: return "CalcBoneAnimTransform";
+    case EPoseOperation::eBlendBoneAnimTransform: return "BlendBoneAnimTransform";
+    case EPoseOperation::eTransitionAnim: return "TransitionAnim";
+    }
+    return "";
+}
+
+struct BenchResult
+{
+    double total_ns = 0.0;
+    long long num_allocations = 0;
+};
+
+// poses num_instances characters for num_frames frames, instances are offset in time so they don't share keys
+// streamed clips are paged in between frames, as the viewer does, blocks are read on the streamer's own thread
+BenchResult RunPoseOperation(const CharacterAsset& asset, EPoseOperation operation, int num_instances, int num_frames, ClipStreamer* p_streamer) {
+    const Skeleton& skeleton = *asset.p_skeleton;
+    const Animation& anim1 = *asset.animations[0];
+    const Animation& anim2 = *asset.animations[std::min<size_t>(1, asset.animations.size() - 1)];
+    const float trans_begin_sec = anim1.total_sec_ * 0.5f;
+
+    vector<PoseState> states;
+    for (int i = 0; i < num_instances; i++)
+    {
+        states.push_back(skeleton.CreatePoseState());
+    }
+    PoseScratch scratch;
+
+    auto pose_frame = [&](int frame) {
+        if (p_streamer != nullptr)
+        {
+            p_streamer->Update();
+        }
+        for (int i = 0; i < num_instances; i++)
+        {
+            float time_in_sec = frame * kFrameDeltaSec + i * 0.37f;
+            switch (operation)
+            {
+            case EPoseOperation::eCalcBoneAnimTransform:
+                skeleton.CalcBoneAnimTransform(anim1, anim1.GetNormalizedTime(time_in_sec), states[i], scratch, asset.root_transform);
+                break;
+            case EPoseOperation::eBlendBoneAnimTransform:
+                skeleton.BlendBoneAnimTransform(anim1, anim2, anim1.GetNormalizedTime(time_in_sec), 0.5f, states[i], scratch, asset.root_transform);
+                break;
+            case EPoseOperation::eTransitionAnim:
+                skeleton.TransitionAnim(anim1, anim2, time_in_sec, trans_begin_sec, states[i], scratch, asset.root_transform);
+                break;
+            }
+        }
+    };
+
+    // first frame sizes the scratch poses
+    pose_frame(0);
+
+    BenchResult result;
+    long long allocations_before = g_num_allocations.load();
+    auto begin = Clock::now();
+    for (int frame = 1; frame <= num_frames; frame++)
+    {
+        pose_frame(frame);
+    }
+    result.total_ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+    result.num_allocations = g_num_allocations.load() - allocations_before;
+
+    g_sink = g_sink + states[num_instances - 1].final_bone_transform.back()[3][0];
+    return result;
+}
+
+void BenchmarkRig(const string& rig_name, const ModelData& model_data, const BenchOption& option, std::ostream* p_out_file) {
+    const CharacterAsset& asset = model_data.GetCharacterAsset();
+    if (asset.p_skeleton == nullptr || asset.animations.empty())
+    {
+        fprintf(stderr, "%s: no skeleton or animation, skipped\n", rig_name.c_str());
+        return;
+    }
+
+    ClipStreamer* p_streamer = model_data.GetClipStreamer();
+    if (p_streamer != nullptr && option.clip_budget_kb > 0)
+    {
+        p_streamer->SetBudget(static_cast<size_t>(option.clip_budget_kb) * 1024);
+    }
+
+    int num_bones = asset.p_skeleton->GetBoneCount();
+    for (EPoseOperation operation : { EPoseOperation::eCalcBoneAnimTransform, EPoseOperation::eBlendBoneAnimTransform, EPoseOperation::eTransitionAnim })
+    {
+        ClipStreamStats stats_before = p_streamer != nullptr ? p_streamer->GetStats() : ClipStreamStats();
+        BenchResult result = RunPoseOperation(asset, operation, option.num_instances, option.num_frames, p_streamer);
+        double ns_per_instance = result.total_ns / (static_cast<double>(option.num_frames) * option.num_instances);
+
+        char line[768];
+        snprintf(line, sizeof(line),
+            "{\"benchmark\":\"pose\",\"rig\":\"%s\",\"operation\":\"%s\",\"bones\":%d,\"clips\":%d,\"instances\":%d,\"frames\":%d,"
+            "\"ns_per_bone\":%.3f,\"ns_per_instance\":%.1f,\"ms_per_frame\":%.4f,\"allocations_per_frame\":%.3f}",
+            rig_name.c_str(), GetOperationName(operation), num_bones, static_cast<int>(asset.animations.size()),
+            option.num_instances, option.num_frames,
+            ns_per_instance / num_bones, ns_per_instance, result.total_ns / option.num_frames * 1e-6,
+            static_cast<double>(result.num_allocations) / option.num_frames);
+
+        // misses are samples served from a fallback block, loads and evictions show how hard the budget is hit
+        if (p_streamer != nullptr)
+        {
+            ClipStreamStats stats = p_streamer->GetStats();
+            size_t length = strlen(line) - 1;
+            snprintf(line + length, sizeof(line) - length,
+                ",\"stream_hits\":%lld,\"stream_misses\":%lld,\"stream_loads\":%lld,\"stream_evictions\":%lld,\"stream_failed_loads\":%lld,\"stream_resident_kb\":%.1f}",
+                stats.hits - stats_before.hits, stats.misses - stats_before.misses, stats.loads - stats_before.loads,
+                stats.evictions - stats_before.evictions, stats.failed_loads - stats_before.failed_loads, stats.resident_bytes / 1024.0f);
+        }
+
+        printf("%s\n", line);
+        if (p_out_file != nullptr)
+        {
+            *p_out_file << line << "\n";
+        }
+    }
+}
+
+
+int main(int argc, char** argv) {
+    BenchOption option = ParseOption(argc, argv);
+
+    std::unique_ptr<std::ofstream> p_out_file;
+    if (option.out_path.empty() == false)
+    {
+        p_out_file = std::make_unique<std::ofstream>(option.out_path, std::ios::app);
+    }
+
+    try
+    {
+        ModelData model_data(option.model_path);
+        string rig_name = option.model_path.substr(option.model_path.find_last_of("/\\") + 1);
+        BenchmarkRig(rig_name, model_data, option, p_out_file.get());
+    }
+    catch (string error_message)
+    {
+        fprintf(stderr, "%s: %s\n", option.model_path.c_str(), error_message.c_str());
+    }
+
+    for (int num_bones : option.synthetic_bones)
+    {
+        aiScene* scene = CreateSyntheticScene(num_bones, 300);
+        ModelData model_data(scene, "");
+        delete scene;
+        BenchmarkRig("synthetic_" + std::to_string(num_bones), model_data, option, p_out_file.get());
+    }
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+#ifndef SYNTHETIC_SCENE_H
+#define SYNTHETIC_SCENE_H
+
+#include <assimp/scene.h>
+
+#include <string>
+#include <vector>
+
+#include "synthetic_clip.h"
+
+// assimp scene of a skinned model with num_bones bones, shaped like an imported file:
+// root node with an armature node tree and a mesh node, one mesh with a quad per bone
+// and two clips animating every bone, so ModelData imports it through the same path as a real file
+// bone i hangs under bone (i - 1) / 2, one unit above it
+inline aiScene* CreateSyntheticScene(int num_bones, int num_keys) {
+    aiScene* scene = new aiScene();
+
+    // node tree
+    std::vector<std::vector<int>> children(num_bones);
+    std::vector<int> depth(num_bones, 0);
+    for (int i = 1; i < num_bones; i++)
+    {
+        children[(i - 1) / 2].push_back(i);
+        depth[i] = depth[(i - 1) / 2] + 1;
+    }
+
+    std::vector<aiNode*> bone_nodes(num_bones);
+    for (int i = 0; i < num_bones; i++)
+    {
+        bone_nodes[i] = new aiNode("bone_" + std::to_string(i));
+        aiMatrix4x4::Translation(aiVector3D(0.0f, i == 0 ? 0.0f : 1.0f, 0.0f), bone_nodes[i]->mTransformation);
+    }
+    for (int i = 0; i < num_bones; i++)
+    {
+        bone_nodes[i]->mNumChildren = children[i].size();
+        bone_nodes[i]->mChildren = children[i].empty() ? nullptr : new aiNode*[children[i].size()];
+        for (int c = 0; c < children[i].size(); c++)
+        {
+            bone_nodes[i]->mChildren[c] = bone_nodes[children[i][c]];
+            bone_nodes[children[i][c]]->mParent = bone_nodes[i];
+        }
+    }
+
+    aiNode* armature_node = new aiNode("armature");
+    armature_node->mNumChildren = 1;
+    armature_node->mChildren = new aiNode*[1]{ bone_nodes[0] };
+    bone_nodes[0]->mParent = armature_node;
+
+    aiNode* mesh_node = new aiNode("mesh");
+    mesh_node->mNumMeshes = 1;
+    mesh_node->mMeshes = new unsigned int[1]{ 0 };
+
+    scene->mRootNode = new aiNode("root");
+    scene->mRootNode->mNumChildren = 2;
+    scene->mRootNode->mChildren = new aiNode*[2]{ armature_node, mesh_node };
+    armature_node->mParent = scene->mRootNode;
+    mesh_node->mParent = scene->mRootNode;
+
+    // a quad around every bone, skinned to that bone only
+    aiMesh* mesh = new aiMesh();
+    mesh->mNumVertices = num_bones * 4;
+    mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+    mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+    mesh->mNumFaces = num_bones * 2;
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+    mesh->mNumBones = num_bones;
+    mesh->mBones = new aiBone*[num_bones];
+    for (int i = 0; i < num_bones; i++)
+    {
+        float y = static_cast<float>(depth[i]);
+        for (int v = 0; v < 4; v++)
+        {
+            mesh->mVertices[i * 4 + v] = aiVector3D((v & 1) ? 0.1f : -0.1f, y + ((v & 2) ? 0.5f : 0.0f), 0.0f);
+            mesh->mNormals[i * 4 + v] = aiVector3D(0.0f, 0.0f, 1.0f);
+        }
+        for (int f = 0; f < 2; f++)
+        {
+            aiFace& face = mesh->mFaces[i * 2 + f];
+            face.mNumIndices = 3;
+            face.mIndices = f == 0 ? new unsigned int[3]{ 0u, 1u, 2u } : new unsigned int[3]{ 1u, 3u, 2u };
+            for (int k = 0; k < 3; k++) face.mIndices[k] += i * 4;
+        }
+
+        aiBone* bone = new aiBone();
+        bone->mName = aiString("bone_" + std::to_string(i));
+        aiMatrix4x4::Translation(aiVector3D(0.0f, -y, 0.0f), bone->mOffsetMatrix);
+        bone->mNumWeights = 4;
+        bone->mWeights = new aiVertexWeight[4];
+        for (int v = 0; v < 4; v++)
+        {
+            bone->mWeights[v].mVertexId = i * 4 + v;
+            bone->mWeights[v].mWeight = 1.0f;
+        }
+        mesh->mBones[i] = bone;
+    }
+    mesh->mMaterialIndex = 0;
+
+    scene->mNumMeshes = 1;
+    scene->mMeshes = new aiMesh*[1]{ mesh };
+    scene->mNumMaterials = 1;
+    scene->mMaterials = new aiMaterial*[1]{ new aiMaterial() };
+
+    scene->mNumAnimations = 2;
+    scene->mAnimations = new aiAnimation*[2]{ CreateSyntheticClip(num_bones, num_keys), CreateSyntheticClip(num_bones, num_keys / 2 + 1, 60.0) };
+
+    return scene;
+}
+
+#endif
@@ -0,0 +1,526 @@
+#!/usr/bin/env python3
+# regenerates the glad 0.1 style loader in this directory (include/glad/glad.h, include/KHR/khrplatform.h, src/glad.c)
+# from the Khronos headers in registry/, so the output only depends on files in the tree
+# the loader in the tree was generated with
+#   python external/glad/gen_glad.py 4.4 GL_ARB_buffer_storage
+# usage: gen_glad.py <major.minor> [extension ...]
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+REGISTRY = os.path.join(HERE, 'registry')
+# extensions promoted to core without a suffix have empty sections in glcorearb.h, their functions come from gl.xml
+EXTENSION_COMMANDS = {
+    'GL_ARB_buffer_storage': ['glBufferStorage'],
+}
+
+target = tuple(int(x) for x in sys.argv[1].split('.'))
+extensions = sys.argv[2:]
+
+
+def read(path):
+    with open(path, newline='') as f:
+        return f.read()
+
+
+def write(path, text):
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, 'w', newline='\n') as f:
+        f.write(text)
+
+
+text = read(os.path.join(REGISTRY, 'glcorearb.h'))
+sections = re.findall(r'#ifndef (GL_\w+)\n#define \1 1\n(.*?)#endif /\* \1 \*/', text, re.S)
+section_map = dict(sections)
+
+versions = []
+for name, body in sections:
+    m = re.match(r'GL_VERSION_(\d)_(\d)$', name)
+    if m and (int(m.group(1)), int(m.group(2))) <= target:
+        versions.append(name)
+
+
+def parse(body):
+    decl_lines = []
+    commands = []
+    in_proto = False
+    for line in body.splitlines():
+        if line.startswith('#ifdef GL_GLEXT_PROTOTYPES'):
+            in_proto = True
+            continue
+        if in_proto:
+            if line.startswith('#endif'):
+                in_proto = False
+                continue
+            m = re.match(r'GLAPI .*?APIENTRY (\w+) \(', line)
+            if m:
+                commands.append(m.group(1))
+            continue
+        decl_lines.append(line)
+    return decl_lines, commands
+
+
+def pfn(command):
+    return 'PFN' + command.upper() + 'PROC'
+
+
+features = []
+for name in versions:
+    decls, commands = parse(section_map[name])
+    features.append((name, decls, commands))
+for name in extensions:
+    decls, commands = parse(section_map[name])
+    commands = commands or EXTENSION_COMMANDS.get(name, [])
+    features.append((name, decls, commands))
+
+# every command once, the first feature that declares it owns the pointer
+owned = set()
+version_str = '%d.%d' % target
+ext_str = ','.join(extensions)
+
+banner = '''/*
+
+    OpenGL loader in the layout of glad 0.1, https://github.com/Dav1dde/glad
+    Generated from the Khronos glcorearb.h in external/glad/registry by
+    python external/glad/gen_glad.py %s
+
+    Language/Generator: C/C++
+    Specification: gl
+    APIs: gl=%s
+    Profile: core
+    Extensions:
+        %s
+    Loader: True
+    Local files: False
+    Omit khrplatform: False
+    Reproducible: True
+*/
+''' % (' '.join(sys.argv[1:]), version_str, ext_str.replace(',', ',\n        '))
+
+h = []
+h.append(banner)
+h.append('''
+
+#ifndef __glad_h_
+#define __glad_h_
+
+#ifdef __gl_h_
+#error OpenGL header already included, remove this include, glad already provides it
+#endif
+#define __gl_h_
+
+#if defined(_WIN32) && !defined(APIENTRY) && !defined(__CYGWIN__) && !defined(__SCITECH_SNAP__)
+#define APIENTRY __stdcall
+#endif
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+#ifndef APIENTRYP
+#define APIENTRYP APIENTRY *
+#endif
+
+#ifndef GLAPIENTRY
+#define GLAPIENTRY APIENTRY
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gladGLversionStruct {
+    int major;
+    int minor;
+};
+
+typedef void* (* GLADloadproc)(const char *name);
+
+#ifndef GLAPI
+# if defined(GLAD_GLAPI_EXPORT)
+#  if defined(_WIN32) || defined(__CYGWIN__)
+#   if defined(GLAD_GLAPI_EXPORT_BUILD)
+#    if defined(__GNUC__)
+#     define GLAPI __attribute__ ((dllexport)) extern
+#    else
+#     define GLAPI __declspec(dllexport) extern
+#    endif
+#   else
+#    if defined(__GNUC__)
+#     define GLAPI __attribute__ ((dllimport)) extern
+#    else
+#     define GLAPI __declspec(dllimport) extern
+#    endif
+#   endif
+#  elif defined(__GNUC__) && defined(GLAD_GLAPI_EXPORT_BUILD)
+#   define GLAPI __attribute__ ((visibility ("default"))) extern
+#  else
+#   define GLAPI extern
+#  endif
+# else
+#  define GLAPI extern
+# endif
+#endif
+
+GLAPI struct gladGLversionStruct GLVersion;
+
+GLAPI int gladLoadGL(void);
+
+GLAPI int gladLoadGLLoader(GLADloadproc);
+''')
+
+for name, decls, commands in features:
+    h.append('#ifndef %s' % name)
+    h.append('#define %s 1' % name)
+    h.append('GLAPI int GLAD_%s;' % name)
+    for line in decls:
+        if line.strip():
+            h.append(line)
+    for command in commands:
+        if command in owned:
+            continue
+        owned.add(command)
+        h.append('GLAPI %s glad_%s;' % (pfn(command), command))
+        h.append('#define %s glad_%s' % (command, command))
+    h.append('#endif')
+    h.append('')
+
+h.append('''
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+''')
+
+c = []
+c.append(banner)
+c.append(r'''
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+
+static void* get_proc(const char *namez);
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+#ifndef _WINDOWS_
+#undef APIENTRY
+#endif
+#include <windows.h>
+static HMODULE libGL;
+
+typedef void* (APIENTRYP PFNWGLGETPROCADDRESSPROC_PRIVATE)(const char*);
+static PFNWGLGETPROCADDRESSPROC_PRIVATE gladGetProcAddressPtr;
+
+#ifdef _MSC_VER
+#ifdef __has_include
+  #if __has_include(<winapifamily.h>)
+    #define HAVE_WINAPIFAMILY 1
+  #endif
+#elif _MSC_VER >= 1700 && !_USING_V110_SDK71_
+  #define HAVE_WINAPIFAMILY 1
+#endif
+#endif
+
+#ifdef HAVE_WINAPIFAMILY
+  #include <winapifamily.h>
+  #if !WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP) && WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_APP)
+    #define IS_UWP 1
+  #endif
+#endif
+
+static
+int open_gl(void) {
+#ifndef IS_UWP
+    libGL = LoadLibraryW(L"opengl32.dll");
+    if(libGL != NULL) {
+        void (* tmp)(void);
+        tmp = (void(*)(void)) GetProcAddress(libGL, "wglGetProcAddress");
+        gladGetProcAddressPtr = (PFNWGLGETPROCADDRESSPROC_PRIVATE) tmp;
+        return gladGetProcAddressPtr != NULL;
+    }
+#endif
+
+    return 0;
+}
+
+static
+void close_gl(void) {
+    if(libGL != NULL) {
+        FreeLibrary((HMODULE) libGL);
+        libGL = NULL;
+    }
+}
+#else
+#include <dlfcn.h>
+static void* libGL;
+
+#if !defined(__APPLE__) && !defined(__HAIKU__)
+typedef void* (APIENTRYP PFNGLXGETPROCADDRESSPROC_PRIVATE)(const char*);
+static PFNGLXGETPROCADDRESSPROC_PRIVATE gladGetProcAddressPtr;
+#endif
+
+static
+int open_gl(void) {
+#ifdef __APPLE__
+    static const char *NAMES[] = {
+        "../Frameworks/OpenGL.framework/OpenGL",
+        "/Library/Frameworks/OpenGL.framework/OpenGL",
+        "/System/Library/Frameworks/OpenGL.framework/OpenGL",
+        "/System/Library/Frameworks/OpenGL.framework/Versions/Current/OpenGL"
+    };
+#else
+    static const char *NAMES[] = {"libGL.so.1", "libGL.so"};
+#endif
+
+    unsigned int index = 0;
+    for(index = 0; index < (sizeof(NAMES) / sizeof(NAMES[0])); index++) {
+        libGL = dlopen(NAMES[index], RTLD_NOW | RTLD_GLOBAL);
+
+        if(libGL != NULL) {
+#if defined(__APPLE__) || defined(__HAIKU__)
+            return 1;
+#else
+            gladGetProcAddressPtr = (PFNGLXGETPROCADDRESSPROC_PRIVATE)dlsym(libGL,
+                "glXGetProcAddressARB");
+            return gladGetProcAddressPtr != NULL;
+#endif
+        }
+    }
+
+    return 0;
+}
+
+static
+void close_gl(void) {
+    if(libGL != NULL) {
+        dlclose(libGL);
+        libGL = NULL;
+    }
+}
+#endif
+
+static
+void* get_proc(const char *namez) {
+    void* result = NULL;
+    if(libGL == NULL) return NULL;
+
+#if !defined(__APPLE__) && !defined(__HAIKU__)
+    if(gladGetProcAddressPtr != NULL) {
+        result = gladGetProcAddressPtr(namez);
+    }
+#endif
+    if(result == NULL) {
+#if defined(_WIN32) || defined(__CYGWIN__)
+        result = (void*)GetProcAddress((HMODULE) libGL, namez);
+#else
+        result = dlsym(libGL, namez);
+#endif
+    }
+
+    return result;
+}
+
+int gladLoadGL(void) {
+    int status = 0;
+
+    if(open_gl()) {
+        status = gladLoadGLLoader(&get_proc);
+        close_gl();
+    }
+
+    return status;
+}
+
+struct gladGLversionStruct GLVersion = { 0, 0 };
+
+#if defined(GL_ES_VERSION_3_0) || defined(GL_VERSION_3_0)
+#define _GLAD_IS_SOME_NEW_VERSION 1
+#endif
+
+static int max_loaded_major;
+static int max_loaded_minor;
+
+static const char *exts = NULL;
+static int num_exts_i = 0;
+static char **exts_i = NULL;
+
+static int get_exts(void) {
+#ifdef _GLAD_IS_SOME_NEW_VERSION
+    if(max_loaded_major < 3) {
+#endif
+        exts = (const char *)glGetString(GL_EXTENSIONS);
+#ifdef _GLAD_IS_SOME_NEW_VERSION
+    } else {
+        unsigned int index;
+
+        num_exts_i = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &num_exts_i);
+        if (num_exts_i > 0) {
+            exts_i = (char **)malloc((size_t)num_exts_i * (sizeof *exts_i));
+        }
+
+        if (exts_i == NULL) {
+            return 0;
+        }
+
+        for(index = 0; index < (unsigned)num_exts_i; index++) {
+            const char *gl_str_tmp = (const char*)glGetStringi(GL_EXTENSIONS, index);
+            size_t len = strlen(gl_str_tmp);
+
+            char *local_str = (char*)malloc((len+1) * sizeof(char));
+            if(local_str != NULL) {
+                memcpy(local_str, gl_str_tmp, (len+1) * sizeof(char));
+            }
+            exts_i[index] = local_str;
+        }
+    }
+#endif
+    return 1;
+}
+
+static void free_exts(void) {
+    if (exts_i != NULL) {
+        int index;
+        for(index = 0; index < num_exts_i; index++) {
+            free((char *)exts_i[index]);
+        }
+        free((void *)exts_i);
+        exts_i = NULL;
+    }
+}
+
+static int has_ext(const char *ext) {
+#ifdef _GLAD_IS_SOME_NEW_VERSION
+    if(max_loaded_major < 3) {
+#endif
+        const char *extensions;
+        const char *loc;
+        const char *terminator;
+        extensions = exts;
+        if(extensions == NULL || ext == NULL) {
+            return 0;
+        }
+
+        while(1) {
+            loc = strstr(extensions, ext);
+            if(loc == NULL) {
+                return 0;
+            }
+
+            terminator = loc + strlen(ext);
+            if((loc == extensions || *(loc - 1) == ' ') &&
+                (*terminator == ' ' || *terminator == '\0')) {
+                return 1;
+            }
+            extensions = terminator;
+        }
+#ifdef _GLAD_IS_SOME_NEW_VERSION
+    } else {
+        int index;
+        if(exts_i == NULL) return 0;
+        for(index = 0; index < num_exts_i; index++) {
+            const char *e = exts_i[index];
+
+            if(exts_i[index] != NULL && strcmp(e, ext) == 0) {
+                return 1;
+            }
+        }
+    }
+#endif
+
+    return 0;
+}
+''')
+
+for name, decls, commands in features:
+    c.append('int GLAD_%s = 0;' % name)
+defined = set()
+for name, decls, commands in features:
+    for command in commands:
+        if command in defined:
+            continue
+        defined.add(command)
+        c.append('%s glad_%s = NULL;' % (pfn(command), command))
+
+for name, decls, commands in features:
+    c.append('static void load_%s(GLADloadproc load) {' % name)
+    c.append('\tif(!GLAD_%s) return;' % name)
+    for command in commands:
+        c.append('\tglad_%s = (%s)load("%s");' % (command, pfn(command), command))
+    c.append('}')
+
+c.append('static int find_extensionsGL(void) {')
+c.append('\tif (!get_exts()) return 0;')
+for name in extensions:
+    c.append('\tGLAD_%s = has_ext("%s");' % (name, name))
+c.append('\tfree_exts();')
+c.append('\treturn 1;')
+c.append('}')
+c.append('')
+c.append(r'''static void find_coreGL(void) {
+
+    /* Thank you @elmindreda
+     * https://github.com/elmindreda/greg/blob/master/templates/greg.c.in#L176
+     * https://github.com/glfw/glfw/blob/master/src/context.c#L36
+     */
+    int i, major, minor;
+
+    const char* version;
+    const char* prefixes[] = {
+        "OpenGL ES-CM ",
+        "OpenGL ES-CL ",
+        "OpenGL ES ",
+        NULL
+    };
+
+    version = (const char*) glGetString(GL_VERSION);
+    if (!version) return;
+
+    for (i = 0;  prefixes[i];  i++) {
+        const size_t length = strlen(prefixes[i]);
+        if (strncmp(version, prefixes[i], length) == 0) {
+            version += length;
+            break;
+        }
+    }
+
+/* PR #18 */
+#ifdef _MSC_VER
+    sscanf_s(version, "%d.%d", &major, &minor);
+#else
+    sscanf(version, "%d.%d", &major, &minor);
+#endif
+
+    GLVersion.major = major; GLVersion.minor = minor;
+    max_loaded_major = major; max_loaded_minor = minor;''')
+for name in versions:
+    m = re.match(r'GL_VERSION_(\d)_(\d)$', name)
+    major, minor = m.group(1), m.group(2)
+    c.append('\tGLAD_%s = (major == %s && minor >= %s) || major > %s;' % (name, major, minor, major))
+c.append('\tif (GLVersion.major > %d || (GLVersion.major >= %d && GLVersion.minor >= %d)) {' % (target[0], target[0], target[1]))
+c.append('\t\tmax_loaded_major = %d;' % target[0])
+c.append('\t\tmax_loaded_minor = %d;' % target[1])
+c.append('\t}')
+c.append('}')
+c.append('')
+c.append('int gladLoadGLLoader(GLADloadproc load) {')
+c.append('\tGLVersion.major = 0; GLVersion.minor = 0;')
+c.append('\tglGetString = (PFNGLGETSTRINGPROC)load("glGetString");')
+c.append('\tif(glGetString == NULL) return 0;')
+c.append('\tif(glGetString(GL_VERSION) == NULL) return 0;')
+c.append('\tfind_coreGL();')
+for name in versions:
+    c.append('\tload_%s(load);' % name)
+c.append('')
+c.append('\tif (!find_extensionsGL()) return 0;')
+for name in extensions:
+    c.append('\tload_%s(load);' % name)
+c.append('\treturn GLVersion.major != 0 || GLVersion.minor != 0;')
+c.append('}')
+c.append('')
+
+write(os.path.join(HERE, 'include', 'glad', 'glad.h'), '\n'.join(h))
+write(os.path.join(HERE, 'src', 'glad.c'), '\n'.join(c))
+write(os.path.join(HERE, 'include', 'KHR', 'khrplatform.h'), read(os.path.join(REGISTRY, 'khrplatform.h')))